@@ -0,0 +1,115 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "cfg/cfg.h"
+#include "cfg/dataflow/access.h"
+#include "cfg/dataflow/liveness.h"
+#include "cfg/dataflow/reachingDefs.h"
+
+#define REGION_COUNT 2000
+#define VARIABLE_COUNT 2000
+#define INSTRUCTIONS_PER_BLOCK 4
+#define LOOP_EVERY 4
+
+static OperationTreeNode *newRead(uint32_t variable) {
+    char name[16];
+    snprintf(name, sizeof(name), "v%u", variable);
+    OperationTreeNode *read = newOperationTreeNode(READ, 1, 0, 0, true);
+    read->children[0] = newOperationTreeNode(name, 0, 0, 0, false);
+    return read;
+}
+
+static void fillBlock(BasicBlock *block) {
+    for (int i = 0; i < INSTRUCTIONS_PER_BLOCK; i++) {
+        char name[16];
+        snprintf(name, sizeof(name), "v%u", (uint32_t)(rand() % VARIABLE_COUNT));
+        OperationTreeNode *sum = newOperationTreeNode(PLUS, 2, 0, 0, false);
+        sum->children[0] = newRead(rand() % VARIABLE_COUNT);
+        sum->children[1] = newRead(rand() % VARIABLE_COUNT);
+        OperationTreeNode *write = newOperationTreeNode(WRITE, 2, 0, 0, false);
+        write->children[0] = newOperationTreeNode(name, 0, 0, 0, false);
+        write->children[1] = sum;
+        addInstruction(block, ASSIGN, write);
+    }
+}
+
+// chain of if/else diamonds, every LOOP_EVERY-th diamond is wrapped in a while loop
+static CFG *buildSyntheticFunction() {
+    CFG *cfg = createCFG();
+    int uid = 0;
+    BasicBlock *current = createBasicBlock(uid++, UNCONDITIONAL, "START");
+    cfg->entryBlock = current;
+    addBasicBlock(cfg, current);
+
+    for (int r = 0; r < REGION_COUNT; r++) {
+        BasicBlock *condition = createBasicBlock(uid++, CONDITIONAL, "If Condition");
+        addInstruction(condition, IDENTIFIER, newRead(rand() % VARIABLE_COUNT));
+        BasicBlock *thenBlock = createBasicBlock(uid++, UNCONDITIONAL, "Then Block");
+        BasicBlock *elseBlock = createBasicBlock(uid++, UNCONDITIONAL, "Else Block");
+        BasicBlock *join = createBasicBlock(uid++, UNCONDITIONAL, "Base block");
+        fillBlock(thenBlock);
+        fillBlock(elseBlock);
+        fillBlock(join);
+        addBasicBlock(cfg, condition);
+        addBasicBlock(cfg, thenBlock);
+        addBasicBlock(cfg, elseBlock);
+        addBasicBlock(cfg, join);
+        addEdge(current, condition, UNCONDITIONAL_JUMP, NULL);
+        addEdge(condition, thenBlock, TRUE_CONDITION, NULL);
+        addEdge(condition, elseBlock, FALSE_CONDITION, NULL);
+        addEdge(thenBlock, join, UNCONDITIONAL_JUMP, NULL);
+        addEdge(elseBlock, join, UNCONDITIONAL_JUMP, NULL);
+        current = join;
+
+        if (r % LOOP_EVERY == LOOP_EVERY - 1) {
+            BasicBlock *loopCondition = createBasicBlock(uid++, CONDITIONAL, "While Condition");
+            addInstruction(loopCondition, IDENTIFIER, newRead(rand() % VARIABLE_COUNT));
+            BasicBlock *exit = createBasicBlock(uid++, UNCONDITIONAL, "Empty block");
+            addBasicBlock(cfg, loopCondition);
+            addBasicBlock(cfg, exit);
+            addEdge(join, loopCondition, UNCONDITIONAL_JUMP, NULL);
+            addEdge(loopCondition, condition, TRUE_CONDITION, NULL);
+            addEdge(loopCondition, exit, FALSE_CONDITION, NULL);
+            current = exit;
+        }
+    }
+
+    BasicBlock *end = createBasicBlock(uid++, TERMINAL, "END");
+    addBasicBlock(cfg, end);
+    addEdge(current, end, UNCONDITIONAL_JUMP, NULL);
+    return cfg;
+}
+
+static double secondsSince(clock_t start) {
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main() {
+    srand(152);
+    CFG *cfg = buildSyntheticFunction();
+
+    clock_t start = clock();
+    FunctionAccesses *accesses = collectFunctionAccesses(cfg);
+    double collectTime = secondsSince(start);
+
+    start = clock();
+    DataflowResult *liveness = computeLiveness(accesses);
+    double livenessTime = secondsSince(start);
+
+    start = clock();
+    ReachingDefinitions *definitions = computeReachingDefinitions(accesses);
+    double reachingTime = secondsSince(start);
+
+    printf("Blocks: %u, variables: %u, definitions: %u\n", accesses->order->blockCount,
+           accesses->variables->count, definitions->definitionCount);
+    printf("Gen/kill extraction: %.3f s\n", collectTime);
+    printf("Liveness: %.3f s, %u transfer evaluations\n", livenessTime, liveness->visits);
+    printf("Reaching definitions: %.3f s, %u transfer evaluations\n", reachingTime, definitions->result->visits);
+
+    freeReachingDefinitions(definitions);
+    freeDataflowResult(liveness);
+    freeFunctionAccesses(accesses);
+    freeCFG(cfg);
+    return 0;
+}
@@ -1,6 +1,12 @@
 #include "cfg.h"
 #include "grammar/ast/myAst.h"
 #include "ot/ot.h"
+#include "dom/dom.h"
+#include "ssa/ssa.h"
+#include "loops/loops.h"
+#include "summary/summary.h"
+#include "symbols/symbols.h"
+#include "hash.h"
 #include <assert.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -41,8 +47,10 @@ void addInstruction(BasicBlock *block, const char *text, OperationTreeNode *otRo
     block->instructions = (Instruction *)realloc(
         block->instructions, sizeof(Instruction) * block->instructionCapacity);
   }
-  block->instructions[block->instructionCount].text = strdup(text);
+  block->instructions[block->instructionCount].text = text;
   block->instructions[block->instructionCount].otRoot = otRoot;
+  block->instructions[block->instructionCount].movedFrom = -1;
+  block->instructions[block->instructionCount].scope = -1;
   block->instructionCount++;
 
   if (block->isEmpty) {
@@ -77,48 +85,36 @@ void addBasicBlock(CFG *cfg, BasicBlock *block) {
   cfg->blocks = block;
 }
 
-TypeInfo* parseTyperef(MyAstNode* typeRef) {
-  assert(typeRef->childCount == 1 || typeRef->childCount == 2 || typeRef->childCount >= 3);
-
-  if (typeRef->childCount == 1) {
-    MyAstNode* type = typeRef->children[0];
-    return createTypeInfo(type->children[0]->label, strcmp(type->label, CUSTOM_TYPE) == 0, false, 0, type->children[0]->line, type->children[0]->pos);
-  } else if (typeRef->childCount == 2) {
-    MyAstNode* type = typeRef->children[0];
-    assert(strcmp(typeRef->children[1]->label, ARRAY) == 0);
-    uint32_t dim = typeRef->children[1]->childCount == 1 ? typeRef->children[1]->children[0]->childCount : 1;
-    return createTypeInfo(type->children[0]->label, strcmp(type->label, CUSTOM_TYPE) == 0, true, dim, type->children[0]->line, type->children[0]->pos);
-  } else if (typeRef->childCount >= 3) {
-    MyAstNode* type = typeRef->children[0];
-    assert(strcmp(typeRef->children[1]->label, ARRAY) == 0);
-    if (strcmp(typeRef->children[typeRef->childCount - 1]->label, TYPEREF) == 0) {
-      uint32_t dim = 0;
-      for (uint32_t i = 1; i < typeRef->childCount - 1; i++) {
-        dim = dim + (typeRef->children[i]->childCount == 1 ? typeRef->children[i]->children[0]->childCount : 1);
-      }
-      TypeInfo *next = parseTyperef(typeRef->children[typeRef->childCount - 1]);
-      TypeInfo *finalType = createTypeInfo(type->children[0]->label, strcmp(type->label, CUSTOM_TYPE) == 0, true, dim, type->children[0]->line, type->children[0]->pos);
-      finalType->next = next;
-      return finalType;
-    } else {
-      uint32_t dim = 0;
-      for (uint32_t i = 1; i < typeRef->childCount; i++) {
-        dim = dim + (typeRef->children[i]->childCount == 1 ? typeRef->children[i]->children[0]->childCount : 1);
-      }
-      TypeInfo *finalType = createTypeInfo(type->children[0]->label, strcmp(type->label, CUSTOM_TYPE) == 0, true, dim, type->children[0]->line, type->children[0]->pos);
-      return finalType;      
-    }
+static uint32_t getArrayDim(MyAstNode* array) {
+  return array->childCount == 1 ? array->children[0]->childCount : 1;
+}
+
+uint32_t parseTyperef(TypeTable *types, MyAstNode* typeRef) {
+  assert(typeRef->childCount >= 1);
+
+  MyAstNode* type = typeRef->children[0];
+  bool custom = strcmp(type->label, CUSTOM_TYPE) == 0;
+  uint32_t arrayCount = typeRef->childCount - 1;
+  uint32_t element = TYPE_NONE;
+  if (arrayCount > 0 && strcmp(typeRef->children[typeRef->childCount - 1]->label, TYPEREF) == 0) {
+    element = parseTyperef(types, typeRef->children[typeRef->childCount - 1]);
+    arrayCount--;
   }
+  uint32_t dim = 0;
+  for (uint32_t i = 1; i <= arrayCount; i++) {
+    dim = dim + getArrayDim(typeRef->children[i]);
+  }
+  return internType(types, type->children[0]->label, custom, arrayCount > 0, dim, element);
 }
 
-void parseArgdefList(MyAstNode* argdefList, FunctionInfo* info) {
+void parseArgdefList(MyAstNode* argdefList, FunctionInfo* info, TypeTable *types) {
   if (argdefList->childCount == 0) {
     return;
   } else {
     for (uint32_t i = 0; i < argdefList->childCount; i++) {
       assert(strcmp(argdefList->children[i]->children[0]->label, TYPEREF) == 0);
       assert(strcmp(argdefList->children[i]->children[1]->label, IDENTIFIER) == 0);
-      TypeInfo* argType = parseTyperef(argdefList->children[i]->children[0]);
+      uint32_t argType = parseTyperef(types, argdefList->children[i]->children[0]);
       ArgumentInfo* arg = createArgumentInfo(argType, argdefList->children[i]->children[1]->children[0]->label, 
       argdefList->children[i]->children[1]->children[0]->line, argdefList->children[i]->children[1]->children[0]->pos);
       addArgument(info, arg);
@@ -126,13 +122,31 @@ void parseArgdefList(MyAstNode* argdefList, FunctionInfo* info) {
   }
 }
 
-void parseVar(MyAstNode* var, BasicBlock *currentBlock, Program *program, const char* filename) {
+// calls of the instruction just added are the ones not placed yet, at the end of the list
+static void placeCallSites(CallSiteList *calls, BasicBlock *block) {
+  for (uint32_t i = calls->count; i > 0 && calls->sites[i - 1].block == -1; i--) {
+    calls->sites[i - 1].block = block->id;
+    calls->sites[i - 1].instruction = block->instructionCount - 1;
+  }
+}
+
+// symbols of the instruction just added, it belongs to the innermost scope open now
+static void resolveLastInstruction(CFG *cfg, BasicBlock *block) {
+  Instruction *instruction = &block->instructions[block->instructionCount - 1];
+  instruction->scope = cfg->symbols->scope;
+  resolveInstructionSymbols(cfg->symbols, instruction->otRoot, block->id, block->instructionCount - 1);
+}
+
+void parseVar(MyAstNode* var, BasicBlock *currentBlock, Program *program, const char* filename, CFG *cfg) {
   OperationTreeErrorContainer *errorContainer = (OperationTreeErrorContainer*)malloc(sizeof(OperationTreeErrorContainer));
   errorContainer->error = NULL;
-  TypeInfo *typeInfo = parseTyperef(var->children[0]);
-  OperationTreeNode *otNode = buildVarOperationTreeFromAstNode(var, errorContainer, typeInfo, filename);
+  errorContainer->strings = program->strings;
+  errorContainer->calls = cfg->callSites;
+  uint32_t type = parseTyperef(program->types, var->children[0]);
+  OperationTreeNode *otNode = buildVarOperationTreeFromAstNode(var, errorContainer, type, filename);
   addInstruction(currentBlock, var->label, otNode);
-  freeTypeInfo(typeInfo);
+  placeCallSites(cfg->callSites, currentBlock);
+  resolveLastInstruction(cfg, currentBlock);
 
   OperationTreeErrorInfo *errorInfo = errorContainer->error;
   while (errorInfo != NULL) {
@@ -144,12 +158,16 @@ void parseVar(MyAstNode* var, BasicBlock *currentBlock, Program *program, const
   free(errorContainer);
 }
 
-void parseExpr(MyAstNode* expr, BasicBlock *currentBlock, Program *program, const char* filename) {
+void parseExpr(MyAstNode* expr, BasicBlock *currentBlock, Program *program, const char* filename, CFG *cfg) {
   assert(strcmp(expr->label, EXPR) == 0);
   OperationTreeErrorContainer *errorContainer = (OperationTreeErrorContainer*)malloc(sizeof(OperationTreeErrorContainer));
   errorContainer->error = NULL;
+  errorContainer->strings = program->strings;
+  errorContainer->calls = cfg->callSites;
   OperationTreeNode *otNode = buildExprOperationTreeFromAstNode(expr->children[0], false, false, errorContainer, filename);
   addInstruction(currentBlock, expr->children[0]->label, otNode);
+  placeCallSites(cfg->callSites, currentBlock);
+  resolveLastInstruction(cfg, currentBlock);
 
   OperationTreeErrorInfo *errorInfo = errorContainer->error;
   while (errorInfo != NULL) {
@@ -176,15 +194,35 @@ void mergeBasicBlocks(CFG *cfg, BasicBlock *block1, BasicBlock *block2) {
     }
     memcpy(block1->instructions + originalCount, block2->instructions, sizeof(Instruction) * block2->instructionCount);
 
+    for (uint32_t i = 0; i < cfg->callSites->count; i++) {
+        CallSite *site = &cfg->callSites->sites[i];
+        if (site->block == block2->id) {
+            site->block = block1->id;
+            site->instruction += originalCount;
+        }
+    }
+    moveSymbolOccurrences(cfg->symbols, block2->id, block1->id, originalCount);
+
+    // move edge lists of block2 to block1, so that edges stay reachable from both ends
     Edge *inEdge = block2->inEdges;
     while (inEdge != NULL) {
         inEdge->targetBlock = block1;
+        if (inEdge->nextIn == NULL) {
+            inEdge->nextIn = block1->inEdges;
+            block1->inEdges = block2->inEdges;
+            break;
+        }
         inEdge = inEdge->nextIn;
     }
 
     Edge *outEdge = block2->outEdges;
     while (outEdge != NULL) {
         outEdge->fromBlock = block1;
+        if (outEdge->nextOut == NULL) {
+            outEdge->nextOut = block1->outEdges;
+            block1->outEdges = block2->outEdges;
+            break;
+        }
         outEdge = outEdge->nextOut;
     }
     BasicBlock *prev = NULL;
@@ -205,9 +243,6 @@ void mergeBasicBlocks(CFG *cfg, BasicBlock *block1, BasicBlock *block2) {
         prev->next = block2->next;
     }
 
-    for (int i = 0; i < block2->instructionCount; i++) {
-        free(block2->instructions[i].text);
-    }
     free(block2->instructions);
     free(block2->name);
     free(block2);
@@ -234,8 +269,12 @@ BasicBlock* parseDoWhile(MyAstNode* doWhileBlock, Program *program, const char*
 
   OperationTreeErrorContainer *errorContainer = (OperationTreeErrorContainer*)malloc(sizeof(OperationTreeErrorContainer));
   errorContainer->error = NULL;
+  errorContainer->strings = program->strings;
+  errorContainer->calls = cfg->callSites;
   OperationTreeNode *otNode = buildExprOperationTreeFromAstNode(doWhileBlock->children[1]->children[0], false, false, errorContainer, filename);
   addInstruction(conditionBlock, doWhileBlock->children[1]->label, otNode);
+  placeCallSites(cfg->callSites, conditionBlock);
+  resolveLastInstruction(cfg, conditionBlock);
 
   OperationTreeErrorInfo *errorInfo = errorContainer->error;
   while (errorInfo != NULL) {
@@ -279,8 +318,12 @@ BasicBlock* parseWhile(MyAstNode* whileBlock, Program *program, const char* file
 
     OperationTreeErrorContainer *errorContainer = (OperationTreeErrorContainer*)malloc(sizeof(OperationTreeErrorContainer));
     errorContainer->error = NULL;
+    errorContainer->strings = program->strings;
+    errorContainer->calls = cfg->callSites;
     OperationTreeNode *otNode = buildExprOperationTreeFromAstNode(whileBlock->children[0]->children[0], false, false, errorContainer, filename);
     addInstruction(conditionBlock, whileBlock->children[0]->label, otNode);
+    placeCallSites(cfg->callSites, conditionBlock);
+    resolveLastInstruction(cfg, conditionBlock);
 
     OperationTreeErrorInfo *errorInfo = errorContainer->error;
     while (errorInfo != NULL) {
@@ -326,8 +369,12 @@ BasicBlock *parseIf(MyAstNode* ifBlock, Program *program, const char* filename,
 
     OperationTreeErrorContainer *errorContainer = (OperationTreeErrorContainer*)malloc(sizeof(OperationTreeErrorContainer));
     errorContainer->error = NULL;
+    errorContainer->strings = program->strings;
+    errorContainer->calls = cfg->callSites;
     OperationTreeNode *otNode = buildExprOperationTreeFromAstNode(ifBlock->children[0]->children[0], false, false, errorContainer, filename);
     addInstruction(conditionBlock, ifBlock->children[0]->label, otNode);
+    placeCallSites(cfg->callSites, conditionBlock);
+    resolveLastInstruction(cfg, conditionBlock);
 
     OperationTreeErrorInfo *errorInfo = errorContainer->error;
     while (errorInfo != NULL) {
@@ -377,6 +424,8 @@ BasicBlock *parseBlock(MyAstNode* block, Program *program, const char* filename,
     currentBlock = existingBlock;
   }
 
+  openSymbolScope(cfg->symbols);
+
   //bad idea! But this is to maintain back-compatibility for handling non-BLOCK cases.
   bool fakeNodeCreated = false;
   MyAstNode* fakeNode = NULL;
@@ -393,7 +442,7 @@ BasicBlock *parseBlock(MyAstNode* block, Program *program, const char* filename,
       currentBlock->name = strdup("Base block");
     }
     if (strcmp(block->children[i]->label, VAR) == 0) {
-      parseVar(block->children[i], currentBlock, program, filename);
+      parseVar(block->children[i], currentBlock, program, filename, cfg);
     } else if (strcmp(block->children[i]->label, BLOCK) == 0) {
       BasicBlock *toExistingBlock = currentBlock->isEmpty ? currentBlock : NULL;
       BasicBlock *nestedExitBlock = parseBlock(block->children[i], program, filename, isLoop, currentBlock, toExistingBlock, loopExitBlock, cfg, uid);
@@ -436,7 +485,7 @@ BasicBlock *parseBlock(MyAstNode* block, Program *program, const char* filename,
         addProgramError(program, error);
       }
     } else if (strcmp(block->children[i]->label, EXPR) == 0) {
-      parseExpr(block->children[i], currentBlock, program, filename);
+      parseExpr(block->children[i], currentBlock, program, filename, cfg);
     }
   }
 
@@ -446,15 +495,209 @@ BasicBlock *parseBlock(MyAstNode* block, Program *program, const char* filename,
     free(fakeNode);
   }
 
+  closeSymbolScope(cfg->symbols);
   return currentBlock;
 }
 
-Program *buildProgram(FilesToAnalyze *files, bool debug) {
+typedef struct FunctionDefinition {
+  MyAstNode *node;
+  const char *fileName;
+  FunctionInfo *info;
+  bool queued;                 // already waiting for or given a CFG by the reachability walk
+} FunctionDefinition;
+
+// Function definitions in file order with a name index, a name maps to its latest definition
+typedef struct FunctionTable {
+  FunctionDefinition *definitions;
+  uint32_t count;
+  uint32_t capacity;
+  int32_t *buckets;
+  uint32_t bucketCount;
+} FunctionTable;
+
+static void initFunctionTable(FunctionTable *table) {
+  table->count = 0;
+  table->capacity = 16;
+  table->definitions = (FunctionDefinition *)malloc(sizeof(FunctionDefinition) * table->capacity);
+  table->bucketCount = 32;
+  table->buckets = (int32_t *)malloc(sizeof(int32_t) * table->bucketCount);
+  for (uint32_t i = 0; i < table->bucketCount; i++) {
+    table->buckets[i] = -1;
+  }
+}
+
+static uint32_t findFunctionSlot(FunctionTable *table, const char *name) {
+  uint32_t slot = hashString(name) & (table->bucketCount - 1);
+  while (table->buckets[slot] != -1 && strcmp(table->definitions[table->buckets[slot]].info->functionName, name) != 0) {
+    slot = (slot + 1) & (table->bucketCount - 1);
+  }
+  return slot;
+}
+
+static int32_t findFunctionDefinition(FunctionTable *table, const char *name) {
+  return table->buckets[findFunctionSlot(table, name)];
+}
+
+// returns the definition the new one replaces in the index, -1 if the name is new
+static int32_t addFunctionDefinition(FunctionTable *table, MyAstNode *node, const char *fileName, FunctionInfo *info) {
+  if ((table->count + 1) * 2 > table->bucketCount) {
+    free(table->buckets);
+    table->bucketCount *= 2;
+    table->buckets = (int32_t *)malloc(sizeof(int32_t) * table->bucketCount);
+    for (uint32_t i = 0; i < table->bucketCount; i++) {
+      table->buckets[i] = -1;
+    }
+    for (uint32_t d = 0; d < table->count; d++) {
+      table->buckets[findFunctionSlot(table, table->definitions[d].info->functionName)] = d;
+    }
+  }
+  if (table->count >= table->capacity) {
+    table->capacity *= 2;
+    table->definitions = (FunctionDefinition *)realloc(table->definitions, sizeof(FunctionDefinition) * table->capacity);
+  }
+  FunctionDefinition *definition = &table->definitions[table->count];
+  definition->node = node;
+  definition->fileName = fileName;
+  definition->info = info;
+  definition->queued = false;
+  uint32_t slot = findFunctionSlot(table, info->functionName);
+  int32_t previous = table->buckets[slot];
+  table->buckets[slot] = table->count++;
+  return previous;
+}
+
+static void freeFunctionTable(FunctionTable *table) {
+  free(table->definitions);
+  free(table->buckets);
+}
+
+// arguments are the outermost scope, the list is in reverse declaration order
+static void declareArgumentSymbols(SymbolTable *symbols, ArgumentInfo *arg) {
+  if (arg == NULL) {
+    return;
+  }
+  declareArgumentSymbols(symbols, arg->next);
+  arg->symbol = declareSymbol(symbols, arg->name, -1, 0, arg->line, arg->pos, true);
+}
+
+static void buildFunctionCFG(Program *program, FunctionDefinition *definition) {
+  MyAstNode *block = definition->node->children[1];
+  assert(strcmp(block->label, BLOCK) == 0);
+  MyAstNode* funcSignature = definition->node->children[0];
+  assert(strcmp(funcSignature->label, FUNC_SIGNATURE) == 0);
+  MyAstNode* name;
+  if (funcSignature->childCount == 2) {
+    name = funcSignature->children[0];
+    assert(strcmp(name->label, NAME) == 0);
+  } else if (funcSignature->childCount == 3) {
+    name = funcSignature->children[1];
+    assert(strcmp(name->label, NAME) == 0);
+  }
+  CFG *cfg = createCFG();
+  uint32_t uid = 0;
+  BasicBlock *startBlock = createBasicBlock(uid, UNCONDITIONAL, "START");
+  cfg->entryBlock = startBlock;
+  addBasicBlock(cfg, startBlock);
+  declareArgumentSymbols(cfg->symbols, definition->info->arguments);
+
+  BasicBlock *lastBlock = parseBlock(block, program, definition->fileName, false, startBlock, NULL, NULL, cfg, &uid);
+  BasicBlock *retCheckBlock;
+  if (lastBlock->isEmpty) {
+    lastBlock->type = TERMINAL;
+    free(lastBlock->name);
+    lastBlock->name = strdup("END");
+    retCheckBlock = lastBlock;
+  } else {
+    BasicBlock *endBlock = createBasicBlock(++uid, TERMINAL, "END");
+    addBasicBlock(cfg, endBlock);
+    addEdge(lastBlock, endBlock, UNCONDITIONAL_JUMP, NULL);
+    retCheckBlock = endBlock;
+  }
+
+  Edge *inEdge = retCheckBlock->inEdges;
+  while (inEdge != NULL) {
+      BasicBlock *incomingBlock = inEdge->fromBlock;
+      if (incomingBlock->instructionCount > 0) {
+        OperationTreeNode *lastOperation = incomingBlock->instructions[incomingBlock->instructionCount - 1].otRoot;
+        if (incomingBlock->type == UNCONDITIONAL && ( isBinaryOp(lastOperation->label) ||
+            isUnaryOp(lastOperation->label) ||
+            strcmp(lastOperation->label, LIT_READ) == 0 ||
+            strcmp(lastOperation->label, READ) == 0 ||
+            strcmp(lastOperation->label, OT_CALL) == 0 ||
+            strcmp(lastOperation->label, INDEX) == 0)) {
+            OperationTreeNode *returnNode = newOperationTreeNode(RETURN, 1, lastOperation->line, lastOperation->pos, false);
+            returnNode->children[0] = lastOperation;
+            incomingBlock->instructions[incomingBlock->instructionCount - 1].otRoot = returnNode;
+        } else {
+          char buffer[1024];
+          
+          snprintf(buffer, sizeof(buffer), 
+          "No return warning. Can't use instruction at %s:%d:%d as a return value",
+                  definition->fileName, lastOperation->line, lastOperation->pos + 1);
+          ProgramWarningInfo* warning = createProgramWarningInfo(buffer);
+          addProgramWarning(program, warning);
+        }
+      } else {
+        char buffer[1024];
+
+        snprintf(buffer, sizeof(buffer), 
+        "No return warning. There is no instructions to use as a return value at %s in function %s",
+                definition->fileName, name->children[0]->label);
+        ProgramWarningInfo* warning = createProgramWarningInfo(buffer);
+        addProgramWarning(program, warning);
+      }
+      inEdge = inEdge->nextIn;
+  }
+
+  finishSymbolTable(cfg->symbols, program, definition->fileName);
+  cfg->loops = buildLoopForest(cfg);
+  definition->info->cfg = cfg;
+}
+
+// Breadth first from the roots, callees are found in the call sites of every CFG built
+static void buildReachableCFGs(Program *program, FunctionTable *table, const char **roots, uint32_t rootCount, bool debug) {
+  uint32_t *queue = (uint32_t *)malloc(sizeof(uint32_t) * (table->count + 1));
+  uint32_t head = 0;
+  uint32_t tail = 0;
+  for (uint32_t r = 0; r < rootCount; r++) {
+    int32_t root = findFunctionDefinition(table, roots[r]);
+    if (root == -1) {
+      char buffer[1024];
+      snprintf(buffer, sizeof(buffer), "Unknown root warning. Function %s is not defined", roots[r]);
+      addProgramWarning(program, createProgramWarningInfo(buffer));
+    } else if (!table->definitions[root].queued) {
+      table->definitions[root].queued = true;
+      queue[tail++] = root;
+    }
+  }
+  while (head < tail) {
+    FunctionDefinition *definition = &table->definitions[queue[head++]];
+    buildFunctionCFG(program, definition);
+    CallSiteList *calls = definition->info->cfg->callSites;
+    for (uint32_t i = 0; i < calls->count; i++) {
+      int32_t callee = findFunctionDefinition(table, calls->sites[i].callee);
+      if (callee != -1 && !table->definitions[callee].queued) {
+        table->definitions[callee].queued = true;
+        queue[tail++] = callee;
+      }
+    }
+  }
+  if (debug) {
+    printf("Built CFGs of %u of %u functions reachable from the roots\n", tail, table->count);
+  }
+  free(queue);
+}
+
+Program *buildProgramFromRoots(FilesToAnalyze *files, const char **roots, uint32_t rootCount, bool debug) {
   Program *program = (Program *)malloc(sizeof(Program));
   program->functions = NULL;
   program->errors = NULL;
   program->warnings = NULL;
+  program->strings = createStringPool();
+  program->types = createTypeTable();
 
+  FunctionTable table;
+  initFunctionTable(&table);
   bool redef = false;
   for (uint32_t i = 0; i < files->filesCount; i++) {
     MyLangResult* result = files->result[i];
@@ -484,31 +727,22 @@ Program *buildProgram(FilesToAnalyze *files, bool debug) {
         assert(strcmp(argdefList->label, ARGDEF_LIST) == 0);
       }
 
-      TypeInfo* returnType;
-      if (typeRef == NULL) {
-        returnType = createTypeInfo("void", false, false, 0, name->line, name->pos);
-      } else {
-        returnType = parseTyperef(typeRef);
-      }
+      uint32_t returnType = typeRef == NULL ? program->types->voidType : parseTyperef(program->types, typeRef);
 
       FunctionInfo* info = createFunctionInfo(files->fileName[i], name->children[0]->label, returnType, name->children[0]->line, name->children[0]->pos);
-      parseArgdefList(argdefList, info);
+      parseArgdefList(argdefList, info, program->types);
 
-      FunctionInfo *func = program->functions;
-      while (func != NULL) {
-        FunctionInfo *nextFunc = func->next;
-        if (strcmp(func->functionName, info->functionName) == 0) {
-          char buffer[1024];
-          redef = true;
-          snprintf(buffer, sizeof(buffer),
-            "Redeclaration error. Function %s at %s:%d:%d was previously declared at %s:%d:%d\n",
-            info->functionName, info->fileName, info->line, info->pos + 1,
-            func->fileName, func->line, func->pos);
-          ProgramErrorInfo* error = createProgramErrorInfo(buffer);
-          addProgramError(program, error);
-          break;
-        }
-        func = nextFunc;
+      int32_t previous = addFunctionDefinition(&table, funcDefs[j], files->fileName[i], info);
+      if (previous != -1) {
+        FunctionInfo *func = table.definitions[previous].info;
+        char buffer[1024];
+        redef = true;
+        snprintf(buffer, sizeof(buffer),
+          "Redeclaration error. Function %s at %s:%d:%d was previously declared at %s:%d:%d\n",
+          info->functionName, info->fileName, info->line, info->pos + 1,
+          func->fileName, func->line, func->pos);
+        ProgramErrorInfo* error = createProgramErrorInfo(buffer);
+        addProgramError(program, error);
       }
 
       addFunctionToProgram(program, info);
@@ -516,107 +750,53 @@ Program *buildProgram(FilesToAnalyze *files, bool debug) {
   }
   
   if (!redef) {
-    for (uint32_t i = 0; i < files->filesCount; i++) {
-      MyLangResult *result = files->result[i];
-      MyAstNode **funcDefs = result->tree->children;
-      uint32_t childCount = result->tree->childCount;
-      for (uint32_t j = 0; j < childCount; j++) {
-        MyAstNode *block = funcDefs[j]->children[1];
-        assert(strcmp(block->label, BLOCK) == 0);
-        MyAstNode* funcSignature = funcDefs[j]->children[0];
-        assert(strcmp(funcSignature->label, FUNC_SIGNATURE) == 0);
-        MyAstNode* name;
-        if (funcSignature->childCount == 2) {
-          name = funcSignature->children[0];
-          assert(strcmp(name->label, NAME) == 0);
-        } else if (funcSignature->childCount == 3) {
-          name = funcSignature->children[1];
-          assert(strcmp(name->label, NAME) == 0);
-        }
-        CFG *cfg = createCFG();
-        uint32_t uid = 0;
-        BasicBlock *startBlock = createBasicBlock(uid, UNCONDITIONAL, "START");
-        cfg->entryBlock = startBlock;
-        addBasicBlock(cfg, startBlock);
-
-        BasicBlock *lastBlock = parseBlock(block, program, files->fileName[i], false, startBlock, NULL, NULL, cfg, &uid);
-        BasicBlock *retCheckBlock;
-        if (lastBlock->isEmpty) {
-          lastBlock->type = TERMINAL;
-          free(lastBlock->name);
-          lastBlock->name = strdup("END");
-          retCheckBlock = lastBlock;
-        } else {
-          BasicBlock *endBlock = createBasicBlock(++uid, TERMINAL, "END");
-          addBasicBlock(cfg, endBlock);
-          addEdge(lastBlock, endBlock, UNCONDITIONAL_JUMP, NULL);
-          retCheckBlock = endBlock;
-        }
-
-        Edge *inEdge = retCheckBlock->inEdges;
-        while (inEdge != NULL) {
-            BasicBlock *incomingBlock = inEdge->fromBlock;
-            if (incomingBlock->instructionCount > 0) {
-              OperationTreeNode *lastOperation = incomingBlock->instructions[incomingBlock->instructionCount - 1].otRoot;
-              if (incomingBlock->type == UNCONDITIONAL && ( isBinaryOp(lastOperation->label) ||
-                  isUnaryOp(lastOperation->label) ||
-                  strcmp(lastOperation->label, LIT_READ) == 0 ||
-                  strcmp(lastOperation->label, READ) == 0 ||
-                  strcmp(lastOperation->label, OT_CALL) == 0 ||
-                  strcmp(lastOperation->label, INDEX) == 0)) {
-                  OperationTreeNode *returnNode = newOperationTreeNode(RETURN, 1, lastOperation->line, lastOperation->pos, false);
-                  returnNode->children[0] = lastOperation;
-                  incomingBlock->instructions[incomingBlock->instructionCount - 1].otRoot = returnNode;
-              } else {
-                char buffer[1024];
-                
-                snprintf(buffer, sizeof(buffer), 
-                "No return warning. Can't use instruction at %s:%d:%d as a return value",
-                        files->fileName[i], lastOperation->line, lastOperation->pos + 1);
-                ProgramWarningInfo* warning = createProgramWarningInfo(buffer);
-                addProgramWarning(program, warning);
-              }
-            } else {
-              char buffer[1024];
-
-              snprintf(buffer, sizeof(buffer), 
-              "No return warning. There is no instructions to use as a return value at %s in function %s",
-                      files->fileName[i], name->children[0]->label);
-              ProgramWarningInfo* warning = createProgramWarningInfo(buffer);
-              addProgramWarning(program, warning);
-            }
-            inEdge = inEdge->nextIn;
-        }
-
-        FunctionInfo *func = program->functions;
-        while (func != NULL) {
-          if (strcmp(func->functionName, name->children[0]->label) == 0) {
-            func->cfg = cfg;
-          }
-          func = func->next;
-        }
+    if (roots == NULL) {
+      for (uint32_t d = 0; d < table.count; d++) {
+        buildFunctionCFG(program, &table.definitions[d]);
       }
+    } else {
+      buildReachableCFGs(program, &table, roots, rootCount, debug);
     }
 
     if (debug) {
       FunctionInfo *func = program->functions;
       while (func != NULL) {
-        printFunctionInfo(func);
+        printFunctionInfo(program->types, func);
         func = func->next;
       }
     }
   }
+  freeFunctionTable(&table);
 
   return program;
 }
 
+Program *buildProgram(FilesToAnalyze *files, bool debug) {
+  return buildProgramFromRoots(files, NULL, 0, debug);
+}
+
 CFG *createCFG() {
   CFG *cfg = (CFG *)malloc(sizeof(CFG));
   cfg->entryBlock = NULL;
   cfg->blocks = NULL;
+  cfg->loops = NULL;
+  cfg->callSites = createCallSiteList();
+  cfg->symbols = createSymbolTable();
   return cfg;
 }
 
+int getMaxBlockId(CFG *cfg) {
+  int maxId = -1;
+  BasicBlock *block = cfg->blocks;
+  while (block != NULL) {
+    if (block->id > maxId) {
+      maxId = block->id;
+    }
+    block = block->next;
+  }
+  return maxId;
+}
+
 void printCFG(CFG *cfg) {
   BasicBlock *block = cfg->blocks;
   while (block != NULL) {
@@ -655,7 +835,6 @@ void printCFG(CFG *cfg) {
 
 void freeInstructions(BasicBlock *block) {
   for (int i = 0; i < block->instructionCount; i++) {
-    free(block->instructions[i].text);
     if (block->instructions[i].otRoot != NULL)
       destroyOperationTreeNodeTree(block->instructions[i].otRoot);
   }
@@ -673,6 +852,84 @@ void freeOutEdges(Edge *edge) {
   }
 }
 
+void removeEdge(Edge *edge) {
+  // Edge is packed, so the lists are relinked through the previous edge instead of a pointer to the link
+  Edge *prev = NULL;
+  Edge *current = edge->fromBlock->outEdges;
+  while (current != edge) {
+    prev = current;
+    current = current->nextOut;
+  }
+  if (prev == NULL) {
+    edge->fromBlock->outEdges = edge->nextOut;
+  } else {
+    prev->nextOut = edge->nextOut;
+  }
+  prev = NULL;
+  current = edge->targetBlock->inEdges;
+  while (current != edge) {
+    prev = current;
+    current = current->nextIn;
+  }
+  if (prev == NULL) {
+    edge->targetBlock->inEdges = edge->nextIn;
+  } else {
+    prev->nextIn = edge->nextIn;
+  }
+  if (edge->condition != NULL) {
+    free(edge->condition);
+  }
+  free(edge);
+}
+
+void retargetEdge(Edge *edge, BasicBlock *target) {
+  Edge *prev = NULL;
+  Edge *current = edge->targetBlock->inEdges;
+  while (current != edge) {
+    prev = current;
+    current = current->nextIn;
+  }
+  if (prev == NULL) {
+    edge->targetBlock->inEdges = edge->nextIn;
+  } else {
+    prev->nextIn = edge->nextIn;
+  }
+  edge->targetBlock = target;
+  edge->nextIn = target->inEdges;
+  target->inEdges = edge;
+}
+
+bool isConditionBlock(BasicBlock *block) {
+  for (Edge *edge = block->outEdges; edge != NULL; edge = edge->nextOut) {
+    if (edge->type != UNCONDITIONAL_JUMP) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void removeBasicBlock(CFG *cfg, BasicBlock *block) {
+  while (block->outEdges != NULL) {
+    removeEdge(block->outEdges);
+  }
+  while (block->inEdges != NULL) {
+    removeEdge(block->inEdges);
+  }
+  BasicBlock **link = &cfg->blocks;
+  while (*link != NULL && *link != block) {
+    link = &(*link)->next;
+  }
+  if (*link == NULL) {
+    fprintf(stderr, "removeBasicBlock: block is not in CFG.\n");
+    return;
+  }
+  *link = block->next;
+  cfg->callSites->stale = true;
+  freeInstructions(block);
+  free(block->name);
+  free(block);
+}
+
 void freeBasicBlocks(BasicBlock *block) {
   while (block != NULL) {
     BasicBlock *nextBlock = block->next;
@@ -686,41 +943,18 @@ void freeBasicBlocks(BasicBlock *block) {
 }
 
 void freeCFG(CFG *cfg) {
+  freeLoopForest(cfg->loops);
   freeBasicBlocks(cfg->blocks);
+  freeCallSiteList(cfg->callSites);
+  freeSymbolTable(cfg->symbols);
   free(cfg);
 }
 
-TypeInfo *createTypeInfo(const char *typeName, bool custom, bool isArray, uint32_t arrayDim, uint32_t line, uint32_t pos) {
-  TypeInfo *typeInfo = (TypeInfo *)malloc(sizeof(TypeInfo));
-  typeInfo->typeName = strdup(typeName);
-  typeInfo->custom = custom;
-  typeInfo->isArray = isArray;
-  typeInfo->arrayDim = arrayDim;
-  typeInfo->line = line;
-  typeInfo->pos = pos;
-  typeInfo->next = NULL;
-  return typeInfo;
-}
-
-void freeTypeInfo(TypeInfo *head) {
-    TypeInfo *current = head;
-    while (current != NULL) {
-        TypeInfo *nextNode = current->next;
-
-        if (current->typeName != NULL) {
-            free(current->typeName);
-            current->typeName = NULL;
-        }
-
-        free(current);
-        current = nextNode;
-    }
-}
-
-ArgumentInfo *createArgumentInfo(TypeInfo *type, const char *name, uint32_t line, uint32_t pos) {
+ArgumentInfo *createArgumentInfo(uint32_t type, const char *name, uint32_t line, uint32_t pos) {
   ArgumentInfo *argInfo = (ArgumentInfo *)malloc(sizeof(ArgumentInfo));
   argInfo->type = type;
   argInfo->name = strdup(name);
+  argInfo->symbol = -1;
   argInfo->next = NULL;
   argInfo->line = line;
   argInfo->pos = pos;
@@ -735,9 +969,6 @@ void addArgument(FunctionInfo *funcInfo, ArgumentInfo *argInfo) {
 void freeArguments(ArgumentInfo *arg) {
   while (arg != NULL) {
     ArgumentInfo *nextArg = arg->next;
-    if (arg->type != NULL) {
-      freeTypeInfo(arg->type);
-    }
     if (arg->name != NULL) {
       free(arg->name);
     }
@@ -747,13 +978,14 @@ void freeArguments(ArgumentInfo *arg) {
 }
 
 FunctionInfo *createFunctionInfo(const char *fileName, const char *functionName,
-                                 TypeInfo *returnType, uint32_t line, uint32_t pos) {
+                                 uint32_t returnType, uint32_t line, uint32_t pos) {
   FunctionInfo *funcInfo = (FunctionInfo *)malloc(sizeof(FunctionInfo));
   funcInfo->fileName = strdup(fileName);
   funcInfo->functionName = strdup(functionName);
   funcInfo->returnType = returnType;
   funcInfo->arguments = NULL;
   funcInfo->cfg = NULL;
+  funcInfo->summary = NULL;
   funcInfo->next = NULL;
   funcInfo->line = line;
   funcInfo->pos = pos;
@@ -773,15 +1005,13 @@ void freeFunctionInfo(FunctionInfo *funcInfo) {
     if (funcInfo->functionName != NULL) {
       free(funcInfo->functionName);
     }
-    if (funcInfo->returnType != NULL) {
-      freeTypeInfo(funcInfo->returnType);
-    }
     if (funcInfo->arguments != NULL) {
       freeArguments(funcInfo->arguments);
     }
     if (funcInfo->cfg != NULL) {
       freeCFG(funcInfo->cfg);
     }
+    freeFunctionSummary(funcInfo->summary);
     free(funcInfo);
   }
 }
@@ -795,6 +1025,8 @@ void freeProgram(Program *program) {
   }
   freeProgramErrors(program->errors);
   freeProgramWarnings(program->warnings);
+  freeStringPool(program->strings);
+  freeTypeTable(program->types);
   free(program);
 }
 
@@ -840,23 +1072,25 @@ void freeProgramWarnings(ProgramWarningInfo *warning) {
     }
 }
 
-void printFunctionInfo(FunctionInfo *funcInfo) {
+void printFunctionInfo(TypeTable *types, FunctionInfo *funcInfo) {
   printf("File: %s\n", funcInfo->fileName);
   printf("Function: %s\n", funcInfo->functionName);
-  printf("Return type: %s", funcInfo->returnType->typeName);
-  if (funcInfo->returnType->custom)
+  const TypeEntry *returnType = getType(types, funcInfo->returnType);
+  printf("Return type: %s", returnType->name);
+  if (returnType->custom)
     printf(", custom type");
-  if (funcInfo->returnType->isArray)
-    printf(", array with dim %d", funcInfo->returnType->arrayDim);
+  if (returnType->isArray)
+    printf(", array with dim %d", returnType->arrayDim);
   printf("\n");
   printf("Arguments:\n");
   ArgumentInfo *arg = funcInfo->arguments;
   while (arg != NULL) {
-    printf("  %s %s", arg->type->typeName, arg->name);
-    if (arg->type->custom)
+    const TypeEntry *type = getType(types, arg->type);
+    printf("  %s %s", type->name, arg->name);
+    if (type->custom)
       printf(", custom type");
-    if (arg->type->isArray)
-      printf(", array with dim %d", arg->type->arrayDim);
+    if (type->isArray)
+      printf(", array with dim %d", type->arrayDim);
     printf("\n");
     arg = arg->next;
   }
@@ -866,7 +1100,38 @@ void printFunctionInfo(FunctionInfo *funcInfo) {
     printCFG(funcInfo->cfg);
 }
 
-void writeOperationTreeToDot(FILE *file, OperationTreeNode *node, int *nodeCounter) {
+static const char* getPurityColor(FunctionPurity purity) {
+    switch (purity) {
+        case PURITY_PURE:
+            return "darkgreen";
+        case PURITY_WRITES_ARGUMENTS:
+            return "orange";
+        case PURITY_UNKNOWN:
+            return "red";
+    }
+    return "red";
+}
+
+static bool isCallNode(OperationTreeNode *node) {
+    return strcmp(node->label, OT_CALL) == 0 && node->childCount >= 1;
+}
+
+// one line per call of the instruction, in the order the tree was built
+static void writeCallPurityToDot(FILE *file, Program *program, OperationTreeNode *node) {
+    if (node == NULL) {
+        return;
+    }
+    if (isCallNode(node)) {
+        FunctionPurity purity = getCallPurity(program, node);
+        const char *callee = node->children[0]->childCount == 0 ? node->children[0]->label : "expression";
+        fprintf(file, "<FONT COLOR=\"%s\">call %s: %s</FONT><BR ALIGN=\"CENTER\"/>", getPurityColor(purity), callee, getPurityName(purity));
+    }
+    for (uint32_t i = 0; i < node->childCount; i++) {
+        writeCallPurityToDot(file, program, node->children[i]);
+    }
+}
+
+void writeOperationTreeToDot(FILE *file, OperationTreeNode *node, int *nodeCounter, CFGDotOptions *options) {
     if (node == NULL) {
         return;
     }
@@ -875,6 +1140,14 @@ void writeOperationTreeToDot(FILE *file, OperationTreeNode *node, int *nodeCount
     
     char escapedLabel[256];
     const char *src = node->label;
+    // withType leaves only hold the id of their type, spell it out for the reader
+    char typeLabel[128];
+    if (node->typeId != TYPE_NONE && options->program != NULL) {
+        char typeText[96];
+        formatType(options->program->types, node->typeId, typeText, sizeof(typeText));
+        snprintf(typeLabel, sizeof(typeLabel), "%s %s", node->label, typeText);
+        src = typeLabel;
+    }
     char *dst = escapedLabel;
     while (*src && (dst - escapedLabel) < 255) {
         if (*src == '<') {
@@ -903,16 +1176,46 @@ void writeOperationTreeToDot(FILE *file, OperationTreeNode *node, int *nodeCount
     }
     *dst = '\0';
 
-    fprintf(file, "        node%d [label=\"%s\", color=blue];\n", currentNodeId, escapedLabel);
+    const char *color = "blue";
+    if (options->drawPurity && isCallNode(node)) {
+        color = getPurityColor(getCallPurity(options->program, node));
+    }
+    fprintf(file, "        node%d [label=\"%s\", color=%s];\n", currentNodeId, escapedLabel, color);
 
     for (uint32_t i = 0; i < node->childCount; i++) {
         int childNodeId = *nodeCounter;
-        writeOperationTreeToDot(file, node->children[i], nodeCounter);
+        writeOperationTreeToDot(file, node->children[i], nodeCounter, options);
         fprintf(file, "        node%d -> node%d[color=blue];\n", currentNodeId, childNodeId);
     }
 }
 
-void writeCFGToDotFile(CFG *cfg, const char *filename, bool drawOt) {
+void writeLoopInfoToDot(FILE *file, LoopForest *forest, BasicBlock *block) {
+    Loop *loop = &forest->loops[getBlockLoop(forest, block)];
+    if (loop->header != block) {
+        fprintf(file, "<FONT COLOR=\"brown\">loop BB%d, depth %u</FONT><BR ALIGN=\"CENTER\"/>", loop->header->id, loop->depth);
+        return;
+    }
+    fprintf(file, "<FONT COLOR=\"brown\">loop header, depth %u, exits", loop->depth);
+    for (uint32_t i = 0; i < loop->exitCount; i++) {
+        fprintf(file, " BB%d", loop->exits[i]->id);
+    }
+    fprintf(file, "</FONT><BR ALIGN=\"CENTER\"/>");
+}
+
+void writeDominatorTreeToDot(FILE *file, DominatorTree *tree, const char *color) {
+    if (tree == NULL) {
+        return;
+    }
+    for (uint32_t i = 0; i < tree->nodeCount; i++) {
+        if (tree->idom[i] == DOM_NO_NODE || tree->blocks[i] == NULL || tree->blocks[tree->idom[i]] == NULL) {
+            continue;
+        }
+        fprintf(file, "    BB%d -> BB%d [style=dashed, color=%s, constraint=false];\n",
+                tree->blocks[tree->idom[i]]->id, tree->blocks[i]->id, color);
+    }
+}
+
+void writeCFGToDotFile(CFG *cfg, const char *filename, CFGDotOptions *options) {
     FILE *file = fopen(filename, "w");
     if (file == NULL) {
         fprintf(stderr, "Can't open file %s to write\n", filename);
@@ -928,17 +1231,39 @@ void writeCFGToDotFile(CFG *cfg, const char *filename, bool drawOt) {
       return;
     }
 
+    if (options->drawPurity) {
+        for (FunctionInfo *func = options->program->functions; func != NULL; func = func->next) {
+            if (func->cfg == cfg) {
+                FunctionPurity purity = getFunctionPurity(func);
+                fprintf(file, "    label=\"%s: %s\";\n", func->functionName, getPurityName(purity));
+                fprintf(file, "    fontcolor=%s;\n\n", getPurityColor(purity));
+            }
+        }
+    }
+
     BasicBlock *block = cfg->blocks;
     int nodeCounter = 0;
     int clusterCounter = 0;
+    SSAForm *ssa = options->drawSsa ? buildSSA(cfg) : NULL;
+    char ssaLine[512];
 
     while (block != NULL) {
         fprintf(file, "    BB%d [label=<", block->id);
         fprintf(file, "<B>BB%d: %s</B><BR ALIGN=\"CENTER\"/>", block->id, block->name);
 
+        BlockSSA *blockSSA = ssa != NULL ? getBlockSSA(ssa, block) : NULL;
+        for (uint32_t p = 0; blockSSA != NULL && p < blockSSA->phiCount; p++) {
+            formatSSAPhi(ssa, &blockSSA->phis[p], ssaLine, sizeof(ssaLine));
+            fprintf(file, "<FONT COLOR=\"darkgreen\">%s</FONT><BR ALIGN=\"CENTER\"/>", ssaLine);
+        }
+
+        if (options->drawLoops && getBlockLoop(cfg->loops, block) != LOOP_NONE) {
+            writeLoopInfoToDot(file, cfg->loops, block);
+        }
+
         for (int i = 0; i < block->instructionCount; i++) {
             char instruction[256];
-            char *src = block->instructions[i].text;
+            const char *src = block->instructions[i].text;
             char *dst = instruction;
             while (*src && (dst - instruction) < 255) {
                 if (*src == '<') {
@@ -967,11 +1292,20 @@ void writeCFGToDotFile(CFG *cfg, const char *filename, bool drawOt) {
             }
             *dst = '\0';
             fprintf(file, "%s<BR ALIGN=\"CENTER\"/>", instruction);
+            if (block->instructions[i].movedFrom != -1) {
+                fprintf(file, "<FONT COLOR=\"navy\">moved from BB%d</FONT><BR ALIGN=\"CENTER\"/>", block->instructions[i].movedFrom);
+            }
+            if (blockSSA != NULL && formatSSAInstruction(ssa, block, i, ssaLine, sizeof(ssaLine))) {
+                fprintf(file, "<FONT COLOR=\"darkgreen\">%s</FONT><BR ALIGN=\"CENTER\"/>", ssaLine);
+            }
+            if (options->drawPurity) {
+                writeCallPurityToDot(file, options->program, block->instructions[i].otRoot);
+            }
         }
 
         fprintf(file, ">];\n");
 
-        if (drawOt) {
+        if (options->drawOt) {
           for (int i = 0; i < block->instructionCount; i++) {
               if (block->instructions[i].otRoot != NULL) {
                   fprintf(file, "    subgraph cluster_instruction%d {\n", clusterCounter);
@@ -983,7 +1317,7 @@ void writeCFGToDotFile(CFG *cfg, const char *filename, bool drawOt) {
                   snprintf(entryNodeName, sizeof(entryNodeName), "entry%d", clusterCounter);
                   fprintf(file, "        %s [shape=point, style=invis];\n", entryNodeName);
 
-                  writeOperationTreeToDot(file, block->instructions[i].otRoot, &nodeCounter);
+                  writeOperationTreeToDot(file, block->instructions[i].otRoot, &nodeCounter, options);
 
                   fprintf(file, "    }\n");
 
@@ -1021,81 +1355,99 @@ void writeCFGToDotFile(CFG *cfg, const char *filename, bool drawOt) {
         block = block->next;
     }
 
+    if (options->drawDominators) {
+        DominatorTree *tree = buildDominatorTree(cfg);
+        writeDominatorTreeToDot(file, tree, "purple");
+        freeDominatorTree(tree);
+    }
+
+    if (options->drawPostDominators) {
+        DominatorTree *tree = buildPostDominatorTree(cfg);
+        writeDominatorTreeToDot(file, tree, "orange");
+        freeDominatorTree(tree);
+    }
+
+    freeSSA(ssa);
+
     fprintf(file, "}\n");
 
     fclose(file);
 }
 
-void traverseOperationTreeAndBuildCallGraph(OperationTreeNode *node, int depth, CallGraph *cg, const char *callerName, bool debug) {
+static void collectTreeCallSites(OperationTreeNode *node, CallSiteList *calls, BasicBlock *block, uint32_t instruction) {
     if (node == NULL) {
         return;
     }
-
-    if (debug) {
-      for (int i = 0; i < depth; i++) {
-        printf("  ");
-      }
-      printf("Node Label: %s, Line: %u, Pos: %u, IsImaginary: %s\n",
-             node->label, node->line, node->pos + 1,
-             node->isImaginary ? "true" : "false");
+    if (strcmp(node->label, OT_CALL) == 0 && node->childCount >= 1 && node->children[0] != NULL && node->children[0]->childCount == 0) {
+        addCallSite(calls, node->children[0]->label, node->line, node->pos);
+        calls->sites[calls->count - 1].block = block->id;
+        calls->sites[calls->count - 1].instruction = instruction;
     }
-
-    if (strcmp(node->label, "call") == 0 && node->childCount >= 1 && node->children[0] != NULL && node->children[0]->childCount == 0) {
-        const char *calleeName = node->children[0]->label;
-        if (debug)
-          printf("    Detected function call: %s -> %s\n", callerName, calleeName);
-        addCallEdge(cg, callerName, calleeName);
-    }
-
     for (uint32_t i = 0; i < node->childCount; i++) {
-        traverseOperationTreeAndBuildCallGraph(node->children[i], depth + 1, cg, callerName, debug);
+        collectTreeCallSites(node->children[i], calls, block, instruction);
     }
 }
 
-void traverseInstructionAndBuildCallGraph(Instruction *instr, CallGraph *cg, const char *callerName, bool debug) {
-    if (instr == NULL) {
-        return;
-    }
-
-    if (debug)
-      printf("    Instruction: %s\n", instr->text);
-
-    if (instr->otRoot != NULL) {
-        if (debug)
-          printf("      Operation Tree:\n");
-        traverseOperationTreeAndBuildCallGraph(instr->otRoot, 3, cg, callerName, debug);
+void collectCallSites(CFG *cfg) {
+    clearCallSites(cfg->callSites);
+    for (BasicBlock *block = cfg->blocks; block != NULL; block = block->next) {
+        for (int i = 0; i < block->instructionCount; i++) {
+            collectTreeCallSites(block->instructions[i].otRoot, cfg->callSites, block, (uint32_t)i);
+        }
     }
 }
 
-void traverseBasicBlockAndBuildCallGraph(BasicBlock *block, CallGraph *cg, const char *functionName, bool debug) {
-    if (block == NULL) {
-        return;
+typedef struct CallSiteOrder {
+    uint32_t blockRank;        // position of the block in the block list
+    uint32_t instruction;
+    uint32_t site;
+} CallSiteOrder;
+
+static int compareCallSiteOrder(const void *a, const void *b) {
+    const CallSiteOrder *left = (const CallSiteOrder *)a;
+    const CallSiteOrder *right = (const CallSiteOrder *)b;
+    if (left->blockRank != right->blockRank) {
+        return left->blockRank < right->blockRank ? -1 : 1;
     }
-
-    if (debug)
-      printf("  BasicBlock ID: %d, Name: %s\n", block->id, block->name);
-
-    for (int i = 0; i < block->instructionCount; i++) {
-        traverseInstructionAndBuildCallGraph(&block->instructions[i], cg, functionName, debug);
+    if (left->instruction != right->instruction) {
+        return left->instruction < right->instruction ? -1 : 1;
     }
+    return left->site < right->site ? -1 : (left->site > right->site ? 1 : 0);
 }
 
-void traverseCFGAndBuildCallGraph(CFG *cfg, CallGraph *cg, const char *functionName, bool debug) {
-    if (cfg == NULL) {
+// Call sites are kept in the order the trees were built, edges are added in block list
+// order, the order the graph has always listed them in.
+static void addFunctionCallEdges(CFG *cfg, CallGraph *cg, const char *functionName, bool debug) {
+    if (cfg->callSites->stale) {
+        collectCallSites(cfg);
+    }
+    CallSiteList *calls = cfg->callSites;
+    if (calls->count == 0) {
         return;
     }
-
-    if (debug)
-      printf("Traversing CFG for function: %s\n", functionName);
-
-    BasicBlock *block = cfg->blocks;
-    while (block != NULL) {
-        traverseBasicBlockAndBuildCallGraph(block, cg, functionName, debug);
-        block = block->next;
+    int maxId = getMaxBlockId(cfg);
+    uint32_t *ranks = (uint32_t *)malloc(sizeof(uint32_t) * (maxId + 1));
+    uint32_t rank = 0;
+    for (BasicBlock *block = cfg->blocks; block != NULL; block = block->next) {
+        ranks[block->id] = rank++;
     }
-
-    if (debug)
-      printf("End of CFG Traversal for function: %s\n", functionName);
+    CallSiteOrder *order = (CallSiteOrder *)malloc(sizeof(CallSiteOrder) * calls->count);
+    for (uint32_t i = 0; i < calls->count; i++) {
+        order[i].blockRank = ranks[calls->sites[i].block];
+        order[i].instruction = calls->sites[i].instruction;
+        order[i].site = i;
+    }
+    qsort(order, calls->count, sizeof(CallSiteOrder), compareCallSiteOrder);
+    for (uint32_t i = 0; i < calls->count; i++) {
+        CallSite *site = &calls->sites[order[i].site];
+        if (debug) {
+            printf("  Call %s -> %s at %u:%u, block %d, instruction %u\n", functionName, site->callee,
+                   site->line, site->pos + 1, site->block, site->instruction);
+        }
+        addCallEdge(cg, functionName, site->callee);
+    }
+    free(order);
+    free(ranks);
 }
 
 void traverseProgramAndBuildCallGraph(Program *program, CallGraph *cg, bool debug) {
@@ -1117,7 +1469,9 @@ void traverseProgramAndBuildCallGraph(Program *program, CallGraph *cg, bool debu
       }
 
 
-        traverseCFGAndBuildCallGraph(func->cfg, cg, func->functionName, debug);
+        if (func->cfg != NULL) {
+            addFunctionCallEdges(func->cfg, cg, func->functionName, debug);
+        }
 
         func = func->next;
     }
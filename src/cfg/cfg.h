@@ -21,8 +21,10 @@ typedef enum {
 } EdgeType;
 
 typedef struct {
-    char *text;
+    const char *text; // not owned, points to the AST node label, so AST must outlive the CFG
     OperationTreeNode *otRoot;
+    int movedFrom;    // id of the block the instruction was hoisted out of, -1 if it wasn't moved
+    int32_t scope;    // scope in the function's symbol table the instruction was written in, -1 if unknown
 } Instruction;
 
 struct BasicBlock;
@@ -50,14 +52,22 @@ typedef struct BasicBlock {
     struct BasicBlock *next;
 } BasicBlock;
 
+struct LoopForest;
+struct FunctionSummary;
+struct SymbolTable;
+
 typedef struct {
     BasicBlock *entryBlock;
     BasicBlock *blocks;
+    struct LoopForest *loops; // natural loops, built together with the CFG
+    CallSiteList *callSites;  // calls recorded while the operation trees were built
+    struct SymbolTable *symbols; // declarations and def-use chains resolved while the CFG was built
 } CFG;
 
 typedef struct ArgumentInfo {
-    TypeInfo *type;
+    uint32_t type;             // id in the program type table
     char *name;
+    int32_t symbol;            // declaration in the function's symbol table, -1 until the CFG is built
     struct ArgumentInfo *next;
     uint32_t line;
     uint32_t pos;
@@ -66,9 +76,10 @@ typedef struct ArgumentInfo {
 typedef struct FunctionInfo {
     char *fileName;
     char *functionName;
-    TypeInfo *returnType;
+    uint32_t returnType;       // id in the program type table
     ArgumentInfo *arguments;
     CFG *cfg;
+    struct FunctionSummary *summary; // effects of the function and its callees, filled by computeProgramSummaries
     struct FunctionInfo *next;
     uint32_t line;
     uint32_t pos;
@@ -90,10 +101,22 @@ typedef struct __attribute__((packed)) ProgramWarningInfo {
     struct ProgramWarningInfo *next;
 } ProgramWarningInfo;
 
+typedef struct CFGDotOptions {
+    bool drawOt;
+    bool drawDominators;
+    bool drawPostDominators;
+    bool drawSsa;
+    bool drawLoops;
+    bool drawPurity;           // colors calls and the function by purity, needs summaries
+    struct Program *program;   // where callees are looked up for drawPurity
+} CFGDotOptions;
+
 typedef struct Program {
     FunctionInfo *functions;
     ProgramErrorInfo *errors;
     ProgramWarningInfo *warnings;
+    StringPool *strings;       // string literals of all functions
+    TypeTable *types;          // types of all declarations, arguments and return types
 } Program;
 
 BasicBlock* createBasicBlock(int id, BlockType type, const char *name);
@@ -106,6 +129,8 @@ void addBasicBlock(CFG *cfg, BasicBlock *block);
 
 CFG* createCFG();
 
+int getMaxBlockId(CFG *cfg);
+
 void printCFG(CFG *cfg);
 
 void freeInstructions(BasicBlock *block);
@@ -114,13 +139,21 @@ void freeOutEdges(Edge *edge);
 
 void freeBasicBlocks(BasicBlock *block);
 
-void freeCFG(CFG *cfg);
+// unlinks the edge from both blocks and frees it
+void removeEdge(Edge *edge);
 
-TypeInfo* createTypeInfo(const char *typeName, bool custom, bool isArray, uint32_t arrayDim, uint32_t line, uint32_t pos);
+// moves the edge to another target block
+void retargetEdge(Edge *edge, BasicBlock *target);
 
-void freeTypeInfo(TypeInfo *typeInfo);
+// true if the block ends with a condition, blocks reused for a condition keep their old type
+bool isConditionBlock(BasicBlock *block);
 
-ArgumentInfo* createArgumentInfo(TypeInfo *type, const char *name, uint32_t line, uint32_t pos);
+// removes the block together with all its edges
+void removeBasicBlock(CFG *cfg, BasicBlock *block);
+
+void freeCFG(CFG *cfg);
+
+ArgumentInfo* createArgumentInfo(uint32_t type, const char *name, uint32_t line, uint32_t pos);
 
 void addArgument(FunctionInfo *funcInfo, ArgumentInfo *argInfo);
 
@@ -130,14 +163,17 @@ void addFunctionToProgram(Program *program, FunctionInfo *funcInfo);
 
 void freeProgram(Program *program);
 
-FunctionInfo* createFunctionInfo(const char *fileName, const char *functionName, TypeInfo *returnType, uint32_t line, uint32_t pos);
+FunctionInfo* createFunctionInfo(const char *fileName, const char *functionName, uint32_t returnType, uint32_t line, uint32_t pos);
 
 void freeFunctionInfo(FunctionInfo *funcInfo);
 
-void printFunctionInfo(FunctionInfo *funcInfo);
+void printFunctionInfo(TypeTable *types, FunctionInfo *funcInfo);
 
 Program* buildProgram(FilesToAnalyze *files, bool debug);
 
+// builds CFGs only for the roots and the functions they reach through calls, the others keep a NULL cfg
+Program* buildProgramFromRoots(FilesToAnalyze *files, const char **roots, uint32_t rootCount, bool debug);
+
 ProgramErrorInfo* createProgramErrorInfo(const char *message);
 
 void addProgramError(Program *program, ProgramErrorInfo *errorInfo);
@@ -150,6 +186,10 @@ void addProgramWarning(Program *program, ProgramWarningInfo *errorInfo);
 
 void freeProgramWarnings(ProgramWarningInfo *error);
 
-void writeCFGToDotFile(CFG *cfg, const char *filename, bool drawOt);
+void writeCFGToDotFile(CFG *cfg, const char *filename, CFGDotOptions *options);
+
+// collects the call sites of the CFG again, for passes that moved or removed instructions
+void collectCallSites(CFG *cfg);
 
+// adds the recorded call sites of every function to the graph
 void traverseProgramAndBuildCallGraph(Program *program, CallGraph *cg, bool debug);
\ No newline at end of file
@@ -1,95 +1,193 @@
 #include "cg.h"
+#include "cfg/hash.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-FunctionNode* createFunctionNode(const char *functionName) {
-    FunctionNode *node = (FunctionNode *)malloc(sizeof(FunctionNode));
-    node->functionName = strdup(functionName);
-    node->next = NULL;
-    node->outEdges = NULL;
-    node->inEdges = NULL;
-    return node;
+#define CG_INITIAL_CAPACITY 16
+#define CG_EMPTY_EDGE UINT64_MAX
+
+CallGraph* createCallGraph() {
+    CallGraph *cg = (CallGraph *)malloc(sizeof(CallGraph));
+    cg->functionCount = 0;
+    cg->functionCapacity = CG_INITIAL_CAPACITY;
+    cg->functions = (FunctionNode *)malloc(sizeof(FunctionNode) * cg->functionCapacity);
+    cg->bucketCount = CG_INITIAL_CAPACITY * 2;
+    cg->buckets = (int32_t *)malloc(sizeof(int32_t) * cg->bucketCount);
+    for (uint32_t i = 0; i < cg->bucketCount; i++) {
+        cg->buckets[i] = CG_NO_NODE;
+    }
+    cg->edgeCount = 0;
+    cg->edgeCapacity = CG_INITIAL_CAPACITY;
+    cg->edges = (CallEdge *)malloc(sizeof(CallEdge) * cg->edgeCapacity);
+    cg->edgeSlotCount = CG_INITIAL_CAPACITY * 2;
+    cg->edgeSlots = (uint64_t *)malloc(sizeof(uint64_t) * cg->edgeSlotCount);
+    for (uint32_t i = 0; i < cg->edgeSlotCount; i++) {
+        cg->edgeSlots[i] = CG_EMPTY_EDGE;
+    }
+    cg->frozen = false;
+    cg->succOffsets = NULL;
+    cg->succs = NULL;
+    cg->predOffsets = NULL;
+    cg->preds = NULL;
+    return cg;
 }
 
-FunctionNode* findFunction(CallGraph *cg, const char *functionName) {
-    FunctionNode *current = cg->functions;
-    while (current != NULL) {
-        if (strcmp(current->functionName, functionName) == 0) {
-            return current;
+static void thawCallGraph(CallGraph *cg) {
+    free(cg->succOffsets);
+    free(cg->succs);
+    free(cg->predOffsets);
+    free(cg->preds);
+    cg->succOffsets = NULL;
+    cg->succs = NULL;
+    cg->predOffsets = NULL;
+    cg->preds = NULL;
+    cg->frozen = false;
+}
+
+static void rehashFunctions(CallGraph *cg) {
+    free(cg->buckets);
+    cg->bucketCount *= 2;
+    cg->buckets = (int32_t *)malloc(sizeof(int32_t) * cg->bucketCount);
+    for (uint32_t i = 0; i < cg->bucketCount; i++) {
+        cg->buckets[i] = CG_NO_NODE;
+    }
+    for (uint32_t i = 0; i < cg->functionCount; i++) {
+        uint32_t slot = hashString(cg->functions[i].functionName) & (cg->bucketCount - 1);
+        while (cg->buckets[slot] != CG_NO_NODE) {
+            slot = (slot + 1) & (cg->bucketCount - 1);
         }
-        current = current->next;
+        cg->buckets[slot] = i;
+    }
+}
+
+int32_t findFunction(CallGraph *cg, const char *functionName) {
+    uint32_t slot = hashString(functionName) & (cg->bucketCount - 1);
+    while (cg->buckets[slot] != CG_NO_NODE) {
+        if (strcmp(cg->functions[cg->buckets[slot]].functionName, functionName) == 0) {
+            return cg->buckets[slot];
+        }
+        slot = (slot + 1) & (cg->bucketCount - 1);
+    }
+    return CG_NO_NODE;
+}
+
+uint32_t addFunctionToCallGraph(CallGraph *cg, const char *functionName) {
+    int32_t existing = findFunction(cg, functionName);
+    if (existing != CG_NO_NODE) {
+        return existing;
+    }
+    if (cg->frozen) {
+        thawCallGraph(cg);
+    }
+    if (cg->functionCount >= cg->functionCapacity) {
+        cg->functionCapacity *= 2;
+        cg->functions = (FunctionNode *)realloc(cg->functions, sizeof(FunctionNode) * cg->functionCapacity);
+    }
+    cg->functions[cg->functionCount].functionName = strdup(functionName);
+    if ((cg->functionCount + 1) * 2 > cg->bucketCount) {
+        cg->functionCount++;
+        rehashFunctions(cg);
+        return cg->functionCount - 1;
+    }
+    uint32_t slot = hashString(functionName) & (cg->bucketCount - 1);
+    while (cg->buckets[slot] != CG_NO_NODE) {
+        slot = (slot + 1) & (cg->bucketCount - 1);
     }
-    return NULL;
+    cg->buckets[slot] = cg->functionCount;
+    return cg->functionCount++;
 }
 
-void addFunctionToCallGraph(CallGraph *cg, const char *functionName) {
-    if (findFunction(cg, functionName) == NULL) {
-        FunctionNode *newNode = createFunctionNode(functionName);
-        newNode->next = cg->functions;
-        cg->functions = newNode;
+static uint32_t getEdgeSlot(CallGraph *cg, uint64_t key) {
+    uint64_t mixed = key * 0x9e3779b97f4a7c15ull;
+    return (uint32_t)(mixed >> 32) & (cg->edgeSlotCount - 1);
+}
+
+static void rehashEdges(CallGraph *cg) {
+    free(cg->edgeSlots);
+    cg->edgeSlotCount *= 2;
+    cg->edgeSlots = (uint64_t *)malloc(sizeof(uint64_t) * cg->edgeSlotCount);
+    for (uint32_t i = 0; i < cg->edgeSlotCount; i++) {
+        cg->edgeSlots[i] = CG_EMPTY_EDGE;
+    }
+    for (uint32_t i = 0; i < cg->edgeCount; i++) {
+        uint64_t key = (uint64_t)cg->edges[i].caller << 32 | cg->edges[i].callee;
+        uint32_t slot = getEdgeSlot(cg, key);
+        while (cg->edgeSlots[slot] != CG_EMPTY_EDGE) {
+            slot = (slot + 1) & (cg->edgeSlotCount - 1);
+        }
+        cg->edgeSlots[slot] = key;
     }
 }
 
 void addCallEdge(CallGraph *cg, const char *callerName, const char *calleeName) {
-    FunctionNode *caller = findFunction(cg, callerName);
-    if (caller == NULL) {
-        caller = createFunctionNode(callerName);
-        caller->next = cg->functions;
-        cg->functions = caller;
-    }
-    
-    FunctionNode *callee = findFunction(cg, calleeName);
-    if (callee == NULL) {
-        callee = createFunctionNode(calleeName);
-        callee->next = cg->functions;
-        cg->functions = callee;
-    }
-    
-    CallEdge *existingEdge = caller->outEdges;
-    while (existingEdge != NULL) {
-        if (strcmp(existingEdge->callee->functionName, calleeName) == 0) {
+    uint32_t caller = addFunctionToCallGraph(cg, callerName);
+    uint32_t callee = addFunctionToCallGraph(cg, calleeName);
+    uint64_t key = (uint64_t)caller << 32 | callee;
+    uint32_t slot = getEdgeSlot(cg, key);
+    while (cg->edgeSlots[slot] != CG_EMPTY_EDGE) {
+        if (cg->edgeSlots[slot] == key) {
             return;
         }
-        existingEdge = existingEdge->nextOut;
-    }
-    
-    CallEdge *outEdge = (CallEdge *)malloc(sizeof(CallEdge));
-    outEdge->caller = caller;
-    outEdge->callee = callee;
-    outEdge->nextOut = caller->outEdges;
-    caller->outEdges = outEdge;
-    
-    CallEdge *inEdge = (CallEdge *)malloc(sizeof(CallEdge));
-    inEdge->caller = caller;
-    inEdge->callee = callee;
-    inEdge->nextIn = callee->inEdges;
-    callee->inEdges = inEdge;
+        slot = (slot + 1) & (cg->edgeSlotCount - 1);
+    }
+    if (cg->frozen) {
+        thawCallGraph(cg);
+    }
+    if (cg->edgeCount >= cg->edgeCapacity) {
+        cg->edgeCapacity *= 2;
+        cg->edges = (CallEdge *)realloc(cg->edges, sizeof(CallEdge) * cg->edgeCapacity);
+    }
+    cg->edges[cg->edgeCount].caller = caller;
+    cg->edges[cg->edgeCount].callee = callee;
+    cg->edgeCount++;
+    if (cg->edgeCount * 2 > cg->edgeSlotCount) {
+        rehashEdges(cg);
+    } else {
+        cg->edgeSlots[slot] = key;
+    }
+}
+
+// counting sort by one end of the edge, stable so every list keeps the insertion order
+static void buildAdjacency(CallGraph *cg, bool byCaller, uint32_t **offsets, uint32_t **targets) {
+    *offsets = (uint32_t *)calloc(cg->functionCount + 1, sizeof(uint32_t));
+    *targets = (uint32_t *)malloc(sizeof(uint32_t) * (cg->edgeCount + 1));
+    for (uint32_t e = 0; e < cg->edgeCount; e++) {
+        (*offsets)[(byCaller ? cg->edges[e].caller : cg->edges[e].callee) + 1]++;
+    }
+    for (uint32_t n = 0; n < cg->functionCount; n++) {
+        (*offsets)[n + 1] += (*offsets)[n];
+    }
+    uint32_t *next = (uint32_t *)malloc(sizeof(uint32_t) * (cg->functionCount + 1));
+    memcpy(next, *offsets, sizeof(uint32_t) * (cg->functionCount + 1));
+    for (uint32_t e = 0; e < cg->edgeCount; e++) {
+        uint32_t from = byCaller ? cg->edges[e].caller : cg->edges[e].callee;
+        (*targets)[next[from]++] = byCaller ? cg->edges[e].callee : cg->edges[e].caller;
+    }
+    free(next);
+}
+
+void freezeCallGraph(CallGraph *cg) {
+    if (cg->frozen) {
+        return;
+    }
+    buildAdjacency(cg, true, &cg->succOffsets, &cg->succs);
+    buildAdjacency(cg, false, &cg->predOffsets, &cg->preds);
+    cg->frozen = true;
 }
 
 void freeCallGraph(CallGraph *cg) {
-    FunctionNode *fn = cg->functions;
-    while (fn != NULL) {
-        FunctionNode *nextFn = fn->next;
-        
-        CallEdge *outEdge = fn->outEdges;
-        while (outEdge != NULL) {
-            CallEdge *nextOut = outEdge->nextOut;
-            free(outEdge);
-            outEdge = nextOut;
-        }
-        
-        CallEdge *inEdge = fn->inEdges;
-        while (inEdge != NULL) {
-            CallEdge *nextIn = inEdge->nextIn;
-            free(inEdge);
-            inEdge = nextIn;
-        }
-        
-        free(fn->functionName);
-        free(fn);
-        fn = nextFn;
+    if (cg == NULL) {
+        return;
+    }
+    for (uint32_t i = 0; i < cg->functionCount; i++) {
+        free(cg->functions[i].functionName);
     }
+    thawCallGraph(cg);
+    free(cg->functions);
+    free(cg->buckets);
+    free(cg->edges);
+    free(cg->edgeSlots);
     free(cg);
 }
 
@@ -99,28 +197,24 @@ void writeCallGraphToDot(CallGraph *cg, const char *filename) {
         fprintf(stderr, "Can't open file %s to write\n", filename);
         return;
     }
-    
+    freezeCallGraph(cg);
+
     fprintf(file, "digraph CallGraph {\n");
     fprintf(file, "    node [shape=ellipse, style=filled, color=lightblue];\n\n");
-    
-    FunctionNode *fn = cg->functions;
-    while (fn != NULL) {
-        fprintf(file, "    \"%s\";\n", fn->functionName);
-        fn = fn->next;
+
+    // newest first, the order the graph has always been written in
+    for (uint32_t n = cg->functionCount; n-- > 0;) {
+        fprintf(file, "    \"%s\";\n", cg->functions[n].functionName);
     }
-    
+
     fprintf(file, "\n");
-    
-    fn = cg->functions;
-    while (fn != NULL) {
-        CallEdge *edge = fn->outEdges;
-        while (edge != NULL) {
-            fprintf(file, "    \"%s\" -> \"%s\" [color=blue];\n", edge->caller->functionName, edge->callee->functionName);
-            edge = edge->nextOut;
+
+    for (uint32_t n = cg->functionCount; n-- > 0;) {
+        for (uint32_t e = cg->succOffsets[n + 1]; e-- > cg->succOffsets[n];) {
+            fprintf(file, "    \"%s\" -> \"%s\" [color=blue];\n", cg->functions[n].functionName, cg->functions[cg->succs[e]].functionName);
         }
-        fn = fn->next;
     }
-    
+
     fprintf(file, "}\n");
     fclose(file);
-}
\ No newline at end of file
+}
@@ -1,31 +1,51 @@
 #pragma once
 
+#include <stdbool.h>
+#include <stdint.h>
+
+#define CG_NO_NODE -1
+
 typedef struct FunctionNode {
     char *functionName;
-    struct FunctionNode *next;
-    struct CallEdge *outEdges;
-    struct CallEdge *inEdges;
 } FunctionNode;
 
 typedef struct CallEdge {
-    FunctionNode *caller;
-    FunctionNode *callee;
-    struct CallEdge *nextOut;
-    struct CallEdge *nextIn;
+    uint32_t caller;
+    uint32_t callee;
 } CallEdge;
 
+// Nodes are numbered in the order their names were first seen. Edges are collected
+// in a hashed set while the graph is built and frozen into CSR arrays afterwards.
 typedef struct CallGraph {
-    FunctionNode *functions;
+    FunctionNode *functions;   // indexed by node id
+    uint32_t functionCount;
+    uint32_t functionCapacity;
+    int32_t *buckets;          // function name hash -> node id, open addressing
+    uint32_t bucketCount;
+    CallEdge *edges;           // in insertion order, without duplicates
+    uint32_t edgeCount;
+    uint32_t edgeCapacity;
+    uint64_t *edgeSlots;       // caller << 32 | callee, open addressing, UINT64_MAX when free
+    uint32_t edgeSlotCount;
+    bool frozen;
+    uint32_t *succOffsets;     // callees of node i are succs[succOffsets[i] .. succOffsets[i + 1]), built by freezeCallGraph
+    uint32_t *succs;
+    uint32_t *predOffsets;     // callers, same layout
+    uint32_t *preds;
 } CallGraph;
 
-FunctionNode* createFunctionNode(const char *functionName);
+CallGraph* createCallGraph();
 
-FunctionNode* findFunction(CallGraph *cg, const char *functionName);
+// node id, CG_NO_NODE if the function is not in the graph
+int32_t findFunction(CallGraph *cg, const char *functionName);
 
-void addFunctionToCallGraph(CallGraph *cg, const char *functionName);
+uint32_t addFunctionToCallGraph(CallGraph *cg, const char *functionName);
 
 void addCallEdge(CallGraph *cg, const char *callerName, const char *calleeName);
 
+// builds the CSR arrays, adding nodes or edges afterwards thaws the graph again
+void freezeCallGraph(CallGraph *cg);
+
 void freeCallGraph(CallGraph *cg);
 
-void writeCallGraphToDot(CallGraph *cg, const char *filename);
\ No newline at end of file
+void writeCallGraphToDot(CallGraph *cg, const char *filename);
@@ -0,0 +1,212 @@
+#include "reach.h"
+#include "cfg/hash.h"
+#include "cfg/dataflow/bitset.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define REACH_MAGIC "CGRI"
+#define REACH_VERSION 1
+// more functions than any program the index is built for, keeps the sizes below from overflowing
+#define REACH_NODE_LIMIT (1u << 24)
+
+static void indexNames(ReachabilityIndex *index) {
+    index->bucketCount = 16;
+    while (index->bucketCount < index->nodeCount * 2) {
+        index->bucketCount *= 2;
+    }
+    index->buckets = (int32_t *)malloc(sizeof(int32_t) * index->bucketCount);
+    for (uint32_t i = 0; i < index->bucketCount; i++) {
+        index->buckets[i] = CG_NO_NODE;
+    }
+    for (uint32_t n = 0; n < index->nodeCount; n++) {
+        uint32_t slot = hashString(index->names[n]) & (index->bucketCount - 1);
+        while (index->buckets[slot] != CG_NO_NODE) {
+            slot = (slot + 1) & (index->bucketCount - 1);
+        }
+        index->buckets[slot] = n;
+    }
+}
+
+ReachabilityIndex* buildReachabilityIndex(CallGraph *cg, CallGraphSCC *scc) {
+    ReachabilityIndex *index = (ReachabilityIndex *)malloc(sizeof(ReachabilityIndex));
+    index->nodeCount = cg->functionCount;
+    index->names = (char **)malloc(sizeof(char *) * (index->nodeCount + 1));
+    index->componentOf = (uint32_t *)malloc(sizeof(uint32_t) * (index->nodeCount + 1));
+    for (uint32_t n = 0; n < index->nodeCount; n++) {
+        index->names[n] = strdup(cg->functions[n].functionName);
+        index->componentOf[n] = scc->componentOf[n];
+    }
+    indexNames(index);
+
+    index->componentCount = scc->componentCount;
+    index->wordCount = getBitSetWordCount(index->componentCount);
+    index->reach = createBitSetMatrix(index->componentCount, index->wordCount);
+    // callees have smaller ids, so their rows are complete before any caller reads them
+    for (uint32_t c = 0; c < index->componentCount; c++) {
+        uint64_t *row = index->reach + (size_t)c * index->wordCount;
+        if (scc->recursive[c]) {
+            setBit(row, c);
+        }
+        for (uint32_t e = scc->succOffsets[c]; e < scc->succOffsets[c + 1]; e++) {
+            uint32_t callee = scc->succs[e];
+            setBit(row, callee);
+            unionBitSet(row, index->reach + (size_t)callee * index->wordCount, index->wordCount);
+        }
+    }
+    return index;
+}
+
+int32_t findIndexedFunction(ReachabilityIndex *index, const char *functionName) {
+    uint32_t slot = hashString(functionName) & (index->bucketCount - 1);
+    while (index->buckets[slot] != CG_NO_NODE) {
+        if (strcmp(index->names[index->buckets[slot]], functionName) == 0) {
+            return index->buckets[slot];
+        }
+        slot = (slot + 1) & (index->bucketCount - 1);
+    }
+    return CG_NO_NODE;
+}
+
+bool canReachNode(ReachabilityIndex *index, uint32_t caller, uint32_t callee) {
+    const uint64_t *row = index->reach + (size_t)index->componentOf[caller] * index->wordCount;
+    return testBit(row, index->componentOf[callee]);
+}
+
+bool canReach(ReachabilityIndex *index, const char *callerName, const char *calleeName) {
+    int32_t caller = findIndexedFunction(index, callerName);
+    int32_t callee = findIndexedFunction(index, calleeName);
+    if (caller == CG_NO_NODE || callee == CG_NO_NODE) {
+        return false;
+    }
+    return canReachNode(index, caller, callee);
+}
+
+static uint32_t* collectNodes(ReachabilityIndex *index, const char *functionName, bool callees, uint32_t *count) {
+    *count = 0;
+    int32_t node = findIndexedFunction(index, functionName);
+    if (node == CG_NO_NODE) {
+        return NULL;
+    }
+    uint32_t *nodes = (uint32_t *)malloc(sizeof(uint32_t) * (index->nodeCount + 1));
+    for (uint32_t n = 0; n < index->nodeCount; n++) {
+        if (callees ? canReachNode(index, node, n) : canReachNode(index, n, node)) {
+            nodes[(*count)++] = n;
+        }
+    }
+    return nodes;
+}
+
+uint32_t* getTransitiveCallees(ReachabilityIndex *index, const char *functionName, uint32_t *count) {
+    return collectNodes(index, functionName, true, count);
+}
+
+uint32_t* getTransitiveCallers(ReachabilityIndex *index, const char *functionName, uint32_t *count) {
+    return collectNodes(index, functionName, false, count);
+}
+
+// little-endian host layout: magic, version, node, component and word counts, then every
+// name as length and bytes, componentOf and the rows
+bool saveReachabilityIndex(ReachabilityIndex *index, const char *filename) {
+    FILE *file = fopen(filename, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "Can't open file %s to write\n", filename);
+        return false;
+    }
+    uint32_t header[4] = {REACH_VERSION, index->nodeCount, index->componentCount, index->wordCount};
+    bool ok = fwrite(REACH_MAGIC, 1, 4, file) == 4 && fwrite(header, sizeof(uint32_t), 4, file) == 4;
+    for (uint32_t n = 0; ok && n < index->nodeCount; n++) {
+        uint32_t length = strlen(index->names[n]);
+        ok = fwrite(&length, sizeof(uint32_t), 1, file) == 1 && fwrite(index->names[n], 1, length, file) == length;
+    }
+    size_t words = (size_t)index->componentCount * index->wordCount;
+    ok = ok && fwrite(index->componentOf, sizeof(uint32_t), index->nodeCount, file) == index->nodeCount;
+    ok = ok && fwrite(index->reach, sizeof(uint64_t), words, file) == words;
+    if (fclose(file) != 0 || !ok) {
+        fprintf(stderr, "Can't write reachability index %s\n", filename);
+        return false;
+    }
+    return true;
+}
+
+ReachabilityIndex* loadReachabilityIndex(const char *filename) {
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+    char magic[4];
+    uint32_t header[4];
+    if (fread(magic, 1, 4, file) != 4 || memcmp(magic, REACH_MAGIC, 4) != 0 ||
+        fread(header, sizeof(uint32_t), 4, file) != 4 || header[0] != REACH_VERSION ||
+        header[1] > REACH_NODE_LIMIT || header[2] > header[1] || header[3] != getBitSetWordCount(header[2])) {
+        fclose(file);
+        return NULL;
+    }
+    // the name lengths, componentOf and the rows have to fit in what is left of the file
+    uint64_t payload = (uint64_t)header[1] * sizeof(uint32_t) * 2 + (uint64_t)header[2] * header[3] * sizeof(uint64_t);
+    long start = ftell(file);
+    if (start < 0 || fseek(file, 0, SEEK_END) != 0) {
+        fclose(file);
+        return NULL;
+    }
+    long end = ftell(file);
+    if (end < start || (uint64_t)(end - start) < payload || fseek(file, start, SEEK_SET) != 0) {
+        fclose(file);
+        return NULL;
+    }
+
+    ReachabilityIndex *index = (ReachabilityIndex *)malloc(sizeof(ReachabilityIndex));
+    if (index == NULL) {
+        fclose(file);
+        return NULL;
+    }
+    index->nodeCount = header[1];
+    index->componentCount = header[2];
+    index->wordCount = header[3];
+    index->names = (char **)calloc(index->nodeCount + 1, sizeof(char *));
+    index->componentOf = (uint32_t *)malloc(sizeof(uint32_t) * (index->nodeCount + 1));
+    index->reach = createBitSetMatrix(index->componentCount, index->wordCount);
+    index->buckets = NULL;
+    bool ok = index->names != NULL && index->componentOf != NULL && index->reach != NULL;
+    if (index->names == NULL) {
+        index->nodeCount = 0;
+    }
+    for (uint32_t n = 0; ok && n < index->nodeCount; n++) {
+        uint32_t length;
+        ok = fread(&length, sizeof(uint32_t), 1, file) == 1 && length < 65536;
+        if (ok) {
+            index->names[n] = (char *)malloc(length + 1);
+            ok = index->names[n] != NULL && fread(index->names[n], 1, length, file) == length;
+            if (ok) {
+                index->names[n][length] = '\0';
+            }
+        }
+    }
+    size_t words = (size_t)index->componentCount * index->wordCount;
+    ok = ok && fread(index->componentOf, sizeof(uint32_t), index->nodeCount, file) == index->nodeCount;
+    ok = ok && fread(index->reach, sizeof(uint64_t), words, file) == words;
+    for (uint32_t n = 0; ok && n < index->nodeCount; n++) {
+        ok = index->componentOf[n] < index->componentCount;
+    }
+    fclose(file);
+    if (!ok) {
+        freeReachabilityIndex(index);
+        return NULL;
+    }
+    indexNames(index);
+    return index;
+}
+
+void freeReachabilityIndex(ReachabilityIndex *index) {
+    if (index == NULL) {
+        return;
+    }
+    for (uint32_t n = 0; n < index->nodeCount; n++) {
+        free(index->names[n]);
+    }
+    free(index->names);
+    free(index->buckets);
+    free(index->componentOf);
+    free(index->reach);
+    free(index);
+}
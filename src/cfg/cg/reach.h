@@ -0,0 +1,42 @@
+#pragma once
+
+#include "cg.h"
+#include "scc.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Transitive closure of the call graph over its SCC condensation: one bitset row per
+// component holding every component reached by at least one call. Names are copied,
+// so an index saved to a file answers queries without the graph it was built from.
+typedef struct ReachabilityIndex {
+    uint32_t nodeCount;
+    char **names;              // call graph node -> function name
+    int32_t *buckets;          // function name hash -> node, open addressing
+    uint32_t bucketCount;
+    uint32_t *componentOf;
+    uint32_t componentCount;
+    uint32_t wordCount;
+    uint64_t *reach;           // wordCount words per component
+} ReachabilityIndex;
+
+ReachabilityIndex* buildReachabilityIndex(CallGraph *cg, CallGraphSCC *scc);
+
+// node id, CG_NO_NODE if the function is not in the index
+int32_t findIndexedFunction(ReachabilityIndex *index, const char *functionName);
+
+// true if a chain of one or more calls leads from caller to callee
+bool canReachNode(ReachabilityIndex *index, uint32_t caller, uint32_t callee);
+
+bool canReach(ReachabilityIndex *index, const char *callerName, const char *calleeName);
+
+// nodes reached from the function, or reaching it, NULL with count 0 for unknown names
+uint32_t* getTransitiveCallees(ReachabilityIndex *index, const char *functionName, uint32_t *count);
+
+uint32_t* getTransitiveCallers(ReachabilityIndex *index, const char *functionName, uint32_t *count);
+
+bool saveReachabilityIndex(ReachabilityIndex *index, const char *filename);
+
+// NULL if the file can't be read or is not an index
+ReachabilityIndex* loadReachabilityIndex(const char *filename);
+
+void freeReachabilityIndex(ReachabilityIndex *index);
@@ -0,0 +1,241 @@
+#include "scc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SCC_UNVISITED UINT32_MAX
+
+// Tarjan's algorithm with an explicit stack of open nodes, each remembers the next edge to
+// follow. Closed components are written to members in the order they are closed.
+static void findComponents(CallGraph *cg, CallGraphSCC *scc) {
+    uint32_t nodeCount = cg->functionCount;
+    uint32_t *index = (uint32_t *)malloc(sizeof(uint32_t) * (nodeCount + 1));
+    uint32_t *lowLink = (uint32_t *)malloc(sizeof(uint32_t) * (nodeCount + 1));
+    uint32_t *nextEdge = (uint32_t *)malloc(sizeof(uint32_t) * (nodeCount + 1));
+    uint32_t *frames = (uint32_t *)malloc(sizeof(uint32_t) * (nodeCount + 1));
+    uint32_t *stack = (uint32_t *)malloc(sizeof(uint32_t) * (nodeCount + 1));
+    bool *onStack = (bool *)calloc(nodeCount + 1, sizeof(bool));
+    for (uint32_t n = 0; n < nodeCount; n++) {
+        index[n] = SCC_UNVISITED;
+    }
+
+    uint32_t counter = 0;
+    uint32_t frameCount = 0;
+    uint32_t stackCount = 0;
+    uint32_t memberCount = 0;
+    for (uint32_t root = 0; root < nodeCount; root++) {
+        if (index[root] != SCC_UNVISITED) {
+            continue;
+        }
+        index[root] = lowLink[root] = counter++;
+        nextEdge[root] = cg->succOffsets[root];
+        stack[stackCount++] = root;
+        onStack[root] = true;
+        frames[frameCount++] = root;
+        while (frameCount > 0) {
+            uint32_t node = frames[frameCount - 1];
+            if (nextEdge[node] < cg->succOffsets[node + 1]) {
+                uint32_t callee = cg->succs[nextEdge[node]++];
+                if (index[callee] == SCC_UNVISITED) {
+                    index[callee] = lowLink[callee] = counter++;
+                    nextEdge[callee] = cg->succOffsets[callee];
+                    stack[stackCount++] = callee;
+                    onStack[callee] = true;
+                    frames[frameCount++] = callee;
+                } else if (onStack[callee] && index[callee] < lowLink[node]) {
+                    lowLink[node] = index[callee];
+                }
+                continue;
+            }
+            frameCount--;
+            if (lowLink[node] == index[node]) {
+                uint32_t component = scc->componentCount++;
+                scc->memberOffsets[component] = memberCount;
+                uint32_t member;
+                do {
+                    member = stack[--stackCount];
+                    onStack[member] = false;
+                    scc->componentOf[member] = component;
+                    scc->members[memberCount++] = member;
+                } while (member != node);
+            }
+            if (frameCount > 0) {
+                uint32_t parent = frames[frameCount - 1];
+                if (lowLink[node] < lowLink[parent]) {
+                    lowLink[parent] = lowLink[node];
+                }
+            }
+        }
+    }
+    scc->memberOffsets[scc->componentCount] = memberCount;
+
+    free(index);
+    free(lowLink);
+    free(nextEdge);
+    free(frames);
+    free(stack);
+    free(onStack);
+}
+
+static void buildCondensation(CallGraph *cg, CallGraphSCC *scc) {
+    uint32_t componentCount = scc->componentCount;
+    scc->succOffsets = (uint32_t *)malloc(sizeof(uint32_t) * (componentCount + 1));
+    scc->succs = (uint32_t *)malloc(sizeof(uint32_t) * (cg->edgeCount + 1));
+    // last component that added an edge to the one indexed, stops duplicates
+    uint32_t *seenBy = (uint32_t *)malloc(sizeof(uint32_t) * (componentCount + 1));
+    for (uint32_t c = 0; c < componentCount; c++) {
+        seenBy[c] = SCC_UNVISITED;
+    }
+    uint32_t succCount = 0;
+    for (uint32_t c = 0; c < componentCount; c++) {
+        scc->succOffsets[c] = succCount;
+        scc->recursive[c] = scc->memberOffsets[c + 1] - scc->memberOffsets[c] > 1;
+        for (uint32_t m = scc->memberOffsets[c]; m < scc->memberOffsets[c + 1]; m++) {
+            uint32_t node = scc->members[m];
+            for (uint32_t e = cg->succOffsets[node]; e < cg->succOffsets[node + 1]; e++) {
+                uint32_t target = scc->componentOf[cg->succs[e]];
+                if (target == c) {
+                    scc->recursive[c] = true;
+                } else if (seenBy[target] != c) {
+                    seenBy[target] = c;
+                    scc->succs[succCount++] = target;
+                }
+            }
+        }
+    }
+    scc->succOffsets[componentCount] = succCount;
+    free(seenBy);
+
+    scc->predOffsets = (uint32_t *)calloc(componentCount + 1, sizeof(uint32_t));
+    scc->preds = (uint32_t *)malloc(sizeof(uint32_t) * (succCount + 1));
+    for (uint32_t e = 0; e < succCount; e++) {
+        scc->predOffsets[scc->succs[e] + 1]++;
+    }
+    for (uint32_t c = 0; c < componentCount; c++) {
+        scc->predOffsets[c + 1] += scc->predOffsets[c];
+    }
+    uint32_t *next = (uint32_t *)malloc(sizeof(uint32_t) * (componentCount + 1));
+    memcpy(next, scc->predOffsets, sizeof(uint32_t) * (componentCount + 1));
+    for (uint32_t c = 0; c < componentCount; c++) {
+        for (uint32_t e = scc->succOffsets[c]; e < scc->succOffsets[c + 1]; e++) {
+            scc->preds[next[scc->succs[e]]++] = c;
+        }
+    }
+    free(next);
+
+    // callees have smaller ids, so their heights are known first
+    for (uint32_t c = 0; c < componentCount; c++) {
+        scc->height[c] = 0;
+        for (uint32_t e = scc->succOffsets[c]; e < scc->succOffsets[c + 1]; e++) {
+            if (scc->height[scc->succs[e]] + 1 > scc->height[c]) {
+                scc->height[c] = scc->height[scc->succs[e]] + 1;
+            }
+        }
+    }
+}
+
+CallGraphSCC* computeCallGraphSCC(CallGraph *cg) {
+    freezeCallGraph(cg);
+    uint32_t nodeCount = cg->functionCount;
+    CallGraphSCC *scc = (CallGraphSCC *)malloc(sizeof(CallGraphSCC));
+    scc->componentCount = 0;
+    scc->componentOf = (uint32_t *)malloc(sizeof(uint32_t) * (nodeCount + 1));
+    scc->memberOffsets = (uint32_t *)malloc(sizeof(uint32_t) * (nodeCount + 1));
+    scc->members = (uint32_t *)malloc(sizeof(uint32_t) * (nodeCount + 1));
+    findComponents(cg, scc);
+    scc->recursive = (bool *)malloc(sizeof(bool) * (scc->componentCount + 1));
+    scc->height = (uint32_t *)malloc(sizeof(uint32_t) * (scc->componentCount + 1));
+    buildCondensation(cg, scc);
+    return scc;
+}
+
+uint32_t* getTopologicalComponentOrder(CallGraphSCC *scc) {
+    uint32_t *order = (uint32_t *)malloc(sizeof(uint32_t) * (scc->componentCount + 1));
+    for (uint32_t c = 0; c < scc->componentCount; c++) {
+        order[c] = scc->componentCount - 1 - c;
+    }
+    return order;
+}
+
+static void writeNode(FILE *file, CallGraph *cg, CallGraphSCC *scc, uint32_t node, const char *indent) {
+    uint32_t component = scc->componentOf[node];
+    fprintf(file, "%s\"%s\" [label=\"%s\\nscc %u, height %u\"];\n", indent, cg->functions[node].functionName,
+            cg->functions[node].functionName, component, scc->height[component]);
+}
+
+void writeCallGraphSCCToDot(CallGraph *cg, CallGraphSCC *scc, const char *filename) {
+    FILE *file = fopen(filename, "w");
+    if (file == NULL) {
+        fprintf(stderr, "Can't open file %s to write\n", filename);
+        return;
+    }
+
+    fprintf(file, "digraph CallGraph {\n");
+    fprintf(file, "    node [shape=ellipse, style=filled, color=lightblue];\n\n");
+
+    // callers first, like the plain graph lists its nodes
+    for (uint32_t c = scc->componentCount; c-- > 0;) {
+        if (!scc->recursive[c]) {
+            writeNode(file, cg, scc, scc->members[scc->memberOffsets[c]], "    ");
+            continue;
+        }
+        fprintf(file, "    subgraph cluster_scc%u {\n", c);
+        fprintf(file, "        label=\"SCC %u\";\n", c);
+        fprintf(file, "        style=dashed;\n");
+        fprintf(file, "        color=red;\n");
+        for (uint32_t m = scc->memberOffsets[c]; m < scc->memberOffsets[c + 1]; m++) {
+            writeNode(file, cg, scc, scc->members[m], "        ");
+        }
+        fprintf(file, "    }\n");
+    }
+
+    fprintf(file, "\n");
+
+    for (uint32_t n = cg->functionCount; n-- > 0;) {
+        for (uint32_t e = cg->succOffsets[n + 1]; e-- > cg->succOffsets[n];) {
+            uint32_t callee = cg->succs[e];
+            bool inCycle = scc->componentOf[callee] == scc->componentOf[n];
+            fprintf(file, "    \"%s\" -> \"%s\" [color=%s];\n", cg->functions[n].functionName,
+                    cg->functions[callee].functionName, inCycle ? "red" : "blue");
+        }
+    }
+
+    fprintf(file, "}\n");
+    fclose(file);
+}
+
+void printCallGraphSCC(CallGraph *cg, CallGraphSCC *scc) {
+    uint32_t recursiveCount = 0;
+    for (uint32_t c = 0; c < scc->componentCount; c++) {
+        if (scc->recursive[c]) {
+            recursiveCount++;
+        }
+    }
+    printf("Call graph: %u functions, %u components, %u recursive\n", cg->functionCount, scc->componentCount, recursiveCount);
+    for (uint32_t c = 0; c < scc->componentCount; c++) {
+        if (!scc->recursive[c]) {
+            continue;
+        }
+        printf("  Component %u (height %u):", c, scc->height[c]);
+        for (uint32_t m = scc->memberOffsets[c]; m < scc->memberOffsets[c + 1]; m++) {
+            printf(" %s", cg->functions[scc->members[m]].functionName);
+        }
+        printf("\n");
+    }
+}
+
+void freeCallGraphSCC(CallGraphSCC *scc) {
+    if (scc == NULL) {
+        return;
+    }
+    free(scc->componentOf);
+    free(scc->memberOffsets);
+    free(scc->members);
+    free(scc->recursive);
+    free(scc->height);
+    free(scc->succOffsets);
+    free(scc->succs);
+    free(scc->predOffsets);
+    free(scc->preds);
+    free(scc);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "cg.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Strongly connected components of the call graph, found by an iterative Tarjan walk.
+// Components are numbered in the order the walk closes them, which is a reverse
+// topological order of the condensation: a callee component always has a smaller id
+// than its callers, so walking ids upwards visits the graph bottom-up.
+typedef struct CallGraphSCC {
+    uint32_t componentCount;
+    uint32_t *componentOf;     // call graph node -> component
+    uint32_t *memberOffsets;   // nodes of component c are members[memberOffsets[c] .. memberOffsets[c + 1])
+    uint32_t *members;
+    bool *recursive;           // more than one node, or a node calling itself
+    uint32_t *height;          // longest path to a component without callees, equal heights never call each other
+    uint32_t *succOffsets;     // condensed DAG: callee components without duplicates or self edges
+    uint32_t *succs;
+    uint32_t *predOffsets;     // caller components, same layout
+    uint32_t *preds;
+} CallGraphSCC;
+
+// freezes the graph, adding nodes or edges afterwards makes the result stale
+CallGraphSCC* computeCallGraphSCC(CallGraph *cg);
+
+// components from callers down to callees, the reverse of the numbering
+uint32_t* getTopologicalComponentOrder(CallGraphSCC *scc);
+
+// cg.dot with every recursive component drawn as a cluster and nodes labelled with their component
+void writeCallGraphSCCToDot(CallGraph *cg, CallGraphSCC *scc, const char *filename);
+
+void printCallGraphSCC(CallGraph *cg, CallGraphSCC *scc);
+
+void freeCallGraphSCC(CallGraphSCC *scc);
@@ -0,0 +1,257 @@
+#include "access.h"
+#include "cfg/hash.h"
+#include <stdlib.h>
+#include <string.h>
+
+VariableTable* createVariableTable() {
+    VariableTable *table = (VariableTable *)malloc(sizeof(VariableTable));
+    table->count = 0;
+    table->capacity = INITIAL_CAPACITY;
+    table->names = (char **)malloc(sizeof(char *) * table->capacity);
+    table->symbols = (int32_t *)malloc(sizeof(int32_t) * table->capacity);
+    table->bucketCount = INITIAL_CAPACITY * 2;
+    table->buckets = (int32_t *)malloc(sizeof(int32_t) * table->bucketCount);
+    for (uint32_t i = 0; i < table->bucketCount; i++) {
+        table->buckets[i] = -1;
+    }
+    return table;
+}
+
+static uint32_t hashVariable(const char *name, int32_t symbol) {
+    return hashCombine(hashString(name), (uint32_t)symbol);
+}
+
+static void rehashVariables(VariableTable *table) {
+    free(table->buckets);
+    table->bucketCount *= 2;
+    table->buckets = (int32_t *)malloc(sizeof(int32_t) * table->bucketCount);
+    for (uint32_t i = 0; i < table->bucketCount; i++) {
+        table->buckets[i] = -1;
+    }
+    for (uint32_t i = 0; i < table->count; i++) {
+        uint32_t slot = hashVariable(table->names[i], table->symbols[i]) & (table->bucketCount - 1);
+        while (table->buckets[slot] != -1) {
+            slot = (slot + 1) & (table->bucketCount - 1);
+        }
+        table->buckets[slot] = i;
+    }
+}
+
+int32_t findDeclaredVariable(VariableTable *table, const char *name, int32_t symbol) {
+    uint32_t slot = hashVariable(name, symbol) & (table->bucketCount - 1);
+    while (table->buckets[slot] != -1) {
+        int32_t variable = table->buckets[slot];
+        if (table->symbols[variable] == symbol && strcmp(table->names[variable], name) == 0) {
+            return variable;
+        }
+        slot = (slot + 1) & (table->bucketCount - 1);
+    }
+    return -1;
+}
+
+uint32_t internDeclaredVariable(VariableTable *table, const char *name, int32_t symbol) {
+    int32_t existing = findDeclaredVariable(table, name, symbol);
+    if (existing != -1) {
+        return existing;
+    }
+    if (table->count >= table->capacity) {
+        table->capacity *= 2;
+        table->names = (char **)realloc(table->names, sizeof(char *) * table->capacity);
+        table->symbols = (int32_t *)realloc(table->symbols, sizeof(int32_t) * table->capacity);
+    }
+    table->names[table->count] = strdup(name);
+    table->symbols[table->count] = symbol;
+    if ((table->count + 1) * 2 > table->bucketCount) {
+        table->count++;
+        rehashVariables(table);
+        return table->count - 1;
+    }
+    uint32_t slot = hashVariable(name, symbol) & (table->bucketCount - 1);
+    while (table->buckets[slot] != -1) {
+        slot = (slot + 1) & (table->bucketCount - 1);
+    }
+    table->buckets[slot] = table->count;
+    return table->count++;
+}
+
+int32_t findVariable(VariableTable *table, const char *name) {
+    return findDeclaredVariable(table, name, -1);
+}
+
+uint32_t internVariable(VariableTable *table, const char *name) {
+    return internDeclaredVariable(table, name, -1);
+}
+
+int32_t findLeafVariable(VariableTable *table, OperationTreeNode *leaf) {
+    return findDeclaredVariable(table, leaf->label, leaf->symbol);
+}
+
+static uint32_t internLeafVariable(VariableTable *table, OperationTreeNode *leaf) {
+    return internDeclaredVariable(table, leaf->label, leaf->symbol);
+}
+
+void freeVariableTable(VariableTable *table) {
+    if (table == NULL) {
+        return;
+    }
+    for (uint32_t i = 0; i < table->count; i++) {
+        free(table->names[i]);
+    }
+    free(table->names);
+    free(table->symbols);
+    free(table->buckets);
+    free(table);
+}
+
+bool isFullDefinition(VarAccessKind kind) {
+    return kind == ACCESS_DEF || kind == ACCESS_DECLARE;
+}
+
+bool readsVariableValue(VarAccessKind kind) {
+    return kind == ACCESS_USE || kind == ACCESS_PARTIAL_DEF;
+}
+
+static void addAccess(BlockAccesses *accesses, uint32_t variable, VarAccessKind kind, uint32_t instruction, OperationTreeNode *node) {
+    if (accesses->count >= accesses->capacity) {
+        accesses->capacity = accesses->capacity == 0 ? INITIAL_CAPACITY : accesses->capacity * 2;
+        accesses->accesses = (VarAccess *)realloc(accesses->accesses, sizeof(VarAccess) * accesses->capacity);
+    }
+    VarAccess *access = &accesses->accesses[accesses->count++];
+    access->variable = variable;
+    access->kind = kind;
+    access->instruction = instruction;
+    access->node = node;
+}
+
+void collectOperationTreeAccesses(OperationTreeNode *node, uint32_t instruction, VariableTable *variables, BlockAccesses *accesses) {
+    if (node == NULL) {
+        return;
+    }
+
+    if (strcmp(node->label, READ) == 0) {
+        addAccess(accesses, internLeafVariable(variables, node->children[0]), ACCESS_USE, instruction, node);
+    } else if (strcmp(node->label, LIT_READ) == 0 || strcmp(node->label, WITH_TYPE) == 0) {
+        return;
+    } else if (strcmp(node->label, WRITE) == 0) {
+        OperationTreeNode *target = node->children[0];
+        collectOperationTreeAccesses(node->children[1], instruction, variables, accesses);
+        if (target->childCount == 0) {
+            addAccess(accesses, internLeafVariable(variables, target), ACCESS_DEF, instruction, node);
+        } else if (strcmp(target->label, INDEX) == 0 && target->children[0]->childCount == 0) {
+            for (uint32_t i = 1; i < target->childCount; i++) {
+                collectOperationTreeAccesses(target->children[i], instruction, variables, accesses);
+            }
+            addAccess(accesses, internLeafVariable(variables, target->children[0]), ACCESS_PARTIAL_DEF, instruction, node);
+        } else {
+            collectOperationTreeAccesses(target, instruction, variables, accesses);
+        }
+    } else if (strcmp(node->label, DECLARE) == 0) {
+        if (node->childCount == 3) {
+            collectOperationTreeAccesses(node->children[2], instruction, variables, accesses);
+        } else {
+            addAccess(accesses, internLeafVariable(variables, node->children[1]), ACCESS_DECLARE, instruction, node);
+        }
+    } else if (strcmp(node->label, INDEX) == 0) {
+        if (node->children[0]->childCount == 0) {
+            addAccess(accesses, internLeafVariable(variables, node->children[0]), ACCESS_USE, instruction, node);
+        } else {
+            collectOperationTreeAccesses(node->children[0], instruction, variables, accesses);
+        }
+        for (uint32_t i = 1; i < node->childCount; i++) {
+            collectOperationTreeAccesses(node->children[i], instruction, variables, accesses);
+        }
+    } else if (strcmp(node->label, OT_CALL) == 0) {
+        if (node->children[0]->childCount != 0) {
+            collectOperationTreeAccesses(node->children[0], instruction, variables, accesses);
+        }
+        for (uint32_t i = 1; i < node->childCount; i++) {
+            collectOperationTreeAccesses(node->children[i], instruction, variables, accesses);
+        }
+        // arrays are passed by reference, so the callee may change any variable passed as is
+        for (uint32_t i = 1; i < node->childCount; i++) {
+            if (strcmp(node->children[i]->label, READ) == 0) {
+                addAccess(accesses, internLeafVariable(variables, node->children[i]->children[0]), ACCESS_PARTIAL_DEF, instruction, node);
+            }
+        }
+    } else {
+        for (uint32_t i = 0; i < node->childCount; i++) {
+            collectOperationTreeAccesses(node->children[i], instruction, variables, accesses);
+        }
+    }
+}
+
+FunctionAccesses* collectFunctionAccesses(CFG *cfg) {
+    FunctionAccesses *accesses = (FunctionAccesses *)malloc(sizeof(FunctionAccesses));
+    accesses->order = buildBlockOrder(cfg);
+    accesses->variables = createVariableTable();
+    accesses->blocks = (BlockAccesses *)calloc(accesses->order->blockCount + 1, sizeof(BlockAccesses));
+    for (uint32_t b = 0; b < accesses->order->blockCount; b++) {
+        BasicBlock *block = accesses->order->blocks[b];
+        for (int i = 0; i < block->instructionCount; i++) {
+            collectOperationTreeAccesses(block->instructions[i].otRoot, i, accesses->variables, &accesses->blocks[b]);
+        }
+    }
+    return accesses;
+}
+
+void freeFunctionAccesses(FunctionAccesses *accesses) {
+    if (accesses == NULL) {
+        return;
+    }
+    for (uint32_t b = 0; b < accesses->order->blockCount; b++) {
+        free(accesses->blocks[b].accesses);
+    }
+    free(accesses->blocks);
+    freeVariableTable(accesses->variables);
+    freeBlockOrder(accesses->order);
+    free(accesses);
+}
+
+AccessMap* buildAccessMap(FunctionAccesses *accesses) {
+    uint32_t accessCount = 0;
+    for (uint32_t b = 0; b < accesses->order->blockCount; b++) {
+        accessCount += accesses->blocks[b].count;
+    }
+    AccessMap *map = (AccessMap *)malloc(sizeof(AccessMap));
+    map->slotCount = INITIAL_CAPACITY * 4;
+    while (map->slotCount < accessCount * 2) {
+        map->slotCount *= 2;
+    }
+    map->nodes = (OperationTreeNode **)calloc(map->slotCount, sizeof(OperationTreeNode *));
+    map->indexes = (uint32_t *)malloc(sizeof(uint32_t) * map->slotCount);
+    for (uint32_t b = 0; b < accesses->order->blockCount; b++) {
+        BlockAccesses *block = &accesses->blocks[b];
+        for (uint32_t i = 0; i < block->count; i++) {
+            OperationTreeNode *node = block->accesses[i].node;
+            uint32_t slot = hashPointer(node) & (map->slotCount - 1);
+            while (map->nodes[slot] != NULL && map->nodes[slot] != node) {
+                slot = (slot + 1) & (map->slotCount - 1);
+            }
+            if (map->nodes[slot] == NULL) {
+                map->nodes[slot] = node;
+                map->indexes[slot] = i;
+            }
+        }
+    }
+    return map;
+}
+
+int32_t findNodeAccess(AccessMap *map, OperationTreeNode *node) {
+    uint32_t slot = hashPointer(node) & (map->slotCount - 1);
+    while (map->nodes[slot] != NULL) {
+        if (map->nodes[slot] == node) {
+            return map->indexes[slot];
+        }
+        slot = (slot + 1) & (map->slotCount - 1);
+    }
+    return -1;
+}
+
+void freeAccessMap(AccessMap *map) {
+    if (map == NULL) {
+        return;
+    }
+    free(map->nodes);
+    free(map->indexes);
+    free(map);
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "dataflow.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum {
+    ACCESS_USE,
+    ACCESS_DEF,          // write to a plain variable
+    ACCESS_DECLARE,      // declaration without initializer, starts a new undefined value
+    ACCESS_PARTIAL_DEF   // array element write or array passed to a call, doesn't kill older values
+} VarAccessKind;
+
+typedef struct VarAccess {
+    uint32_t variable;
+    VarAccessKind kind;
+    uint32_t instruction;
+    OperationTreeNode *node;   // read node for uses, write/declare/index/call node for definitions
+} VarAccess;
+
+// Variables of a function keyed by name and declaration, so shadowing declarations are
+// different variables. Tables that only need names use -1 as the declaration.
+typedef struct VariableTable {
+    char **names;
+    int32_t *symbols;          // declaration in the function's symbol table, -1 for names keyed alone
+    uint32_t count;
+    uint32_t capacity;
+    int32_t *buckets;
+    uint32_t bucketCount;
+} VariableTable;
+
+typedef struct BlockAccesses {
+    VarAccess *accesses;       // in evaluation order
+    uint32_t count;
+    uint32_t capacity;
+} BlockAccesses;
+
+typedef struct FunctionAccesses {
+    BlockOrder *order;
+    VariableTable *variables;
+    BlockAccesses *blocks;     // indexed like order->blocks
+} FunctionAccesses;
+
+// operation tree node -> index of its first access in the block, open addressing over the whole function
+typedef struct AccessMap {
+    OperationTreeNode **nodes;
+    uint32_t *indexes;
+    uint32_t slotCount;
+} AccessMap;
+
+VariableTable* createVariableTable();
+
+uint32_t internVariable(VariableTable *table, const char *name);
+
+int32_t findVariable(VariableTable *table, const char *name);
+
+uint32_t internDeclaredVariable(VariableTable *table, const char *name, int32_t symbol);
+
+int32_t findDeclaredVariable(VariableTable *table, const char *name, int32_t symbol);
+
+// variable of a name leaf, the leaf's label and the declaration it was resolved to
+int32_t findLeafVariable(VariableTable *table, OperationTreeNode *leaf);
+
+void freeVariableTable(VariableTable *table);
+
+bool isFullDefinition(VarAccessKind kind);
+
+// element writes and calls reach the array through the variable's current value, so they read it
+bool readsVariableValue(VarAccessKind kind);
+
+void collectOperationTreeAccesses(OperationTreeNode *node, uint32_t instruction, VariableTable *variables, BlockAccesses *accesses);
+
+FunctionAccesses* collectFunctionAccesses(CFG *cfg);
+
+void freeFunctionAccesses(FunctionAccesses *accesses);
+
+AccessMap* buildAccessMap(FunctionAccesses *accesses);
+
+// -1 if the node makes no access
+int32_t findNodeAccess(AccessMap *map, OperationTreeNode *node);
+
+void freeAccessMap(AccessMap *map);
@@ -0,0 +1,112 @@
+#include "bitset.h"
+#include <stdlib.h>
+#include <string.h>
+
+uint32_t getBitSetWordCount(uint32_t bitCount) {
+    uint32_t words = (bitCount + BITSET_WORD_BITS - 1) / BITSET_WORD_BITS;
+    words = (words + BITSET_CHUNK_WORDS - 1) / BITSET_CHUNK_WORDS * BITSET_CHUNK_WORDS;
+    return words == 0 ? BITSET_CHUNK_WORDS : words;
+}
+
+uint64_t* createBitSetMatrix(uint32_t rowCount, uint32_t wordCount) {
+    size_t size = sizeof(uint64_t) * (size_t)wordCount * (rowCount > 0 ? rowCount : 1);
+    uint64_t *matrix = (uint64_t *)aligned_alloc(sizeof(BitSetChunk), size);
+    memset(matrix, 0, size);
+    return matrix;
+}
+
+void setBit(uint64_t *set, uint32_t bit) {
+    set[bit / BITSET_WORD_BITS] |= (uint64_t)1 << (bit % BITSET_WORD_BITS);
+}
+
+void clearBit(uint64_t *set, uint32_t bit) {
+    set[bit / BITSET_WORD_BITS] &= ~((uint64_t)1 << (bit % BITSET_WORD_BITS));
+}
+
+bool testBit(const uint64_t *set, uint32_t bit) {
+    return (set[bit / BITSET_WORD_BITS] >> (bit % BITSET_WORD_BITS)) & 1;
+}
+
+void clearBitSet(uint64_t *set, uint32_t wordCount) {
+    memset(set, 0, sizeof(uint64_t) * wordCount);
+}
+
+void fillBitSet(uint64_t *set, uint32_t wordCount, uint32_t bitCount) {
+    memset(set, 0xff, sizeof(uint64_t) * wordCount);
+    for (uint32_t bit = bitCount; bit < wordCount * BITSET_WORD_BITS; bit++) {
+        clearBit(set, bit);
+    }
+}
+
+void copyBitSet(uint64_t *dst, const uint64_t *src, uint32_t wordCount) {
+    memcpy(dst, src, sizeof(uint64_t) * wordCount);
+}
+
+bool unionBitSet(uint64_t *dst, const uint64_t *src, uint32_t wordCount) {
+    BitSetChunk *d = (BitSetChunk *)dst;
+    const BitSetChunk *s = (const BitSetChunk *)src;
+    BitSetChunk changed = {0, 0};
+    for (uint32_t i = 0; i < wordCount / BITSET_CHUNK_WORDS; i++) {
+        BitSetChunk value = d[i] | s[i];
+        changed |= value ^ d[i];
+        d[i] = value;
+    }
+    return (changed[0] | changed[1]) != 0;
+}
+
+bool intersectBitSet(uint64_t *dst, const uint64_t *src, uint32_t wordCount) {
+    BitSetChunk *d = (BitSetChunk *)dst;
+    const BitSetChunk *s = (const BitSetChunk *)src;
+    BitSetChunk changed = {0, 0};
+    for (uint32_t i = 0; i < wordCount / BITSET_CHUNK_WORDS; i++) {
+        BitSetChunk value = d[i] & s[i];
+        changed |= value ^ d[i];
+        d[i] = value;
+    }
+    return (changed[0] | changed[1]) != 0;
+}
+
+void subtractBitSet(uint64_t *dst, const uint64_t *src, uint32_t wordCount) {
+    BitSetChunk *d = (BitSetChunk *)dst;
+    const BitSetChunk *s = (const BitSetChunk *)src;
+    for (uint32_t i = 0; i < wordCount / BITSET_CHUNK_WORDS; i++) {
+        d[i] &= ~s[i];
+    }
+}
+
+bool transferBitSet(uint64_t *out, const uint64_t *in, const uint64_t *gen, const uint64_t *kill, uint32_t wordCount) {
+    BitSetChunk *o = (BitSetChunk *)out;
+    const BitSetChunk *i0 = (const BitSetChunk *)in;
+    const BitSetChunk *g = (const BitSetChunk *)gen;
+    const BitSetChunk *k = (const BitSetChunk *)kill;
+    BitSetChunk changed = {0, 0};
+    for (uint32_t i = 0; i < wordCount / BITSET_CHUNK_WORDS; i++) {
+        BitSetChunk value = g[i] | (i0[i] & ~k[i]);
+        changed |= value ^ o[i];
+        o[i] = value;
+    }
+    return (changed[0] | changed[1]) != 0;
+}
+
+uint32_t countBitSet(const uint64_t *set, uint32_t wordCount) {
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < wordCount; i++) {
+        count += __builtin_popcountll(set[i]);
+    }
+    return count;
+}
+
+int32_t nextSetBit(const uint64_t *set, uint32_t wordCount, uint32_t from) {
+    uint32_t word = from / BITSET_WORD_BITS;
+    if (word >= wordCount) {
+        return -1;
+    }
+    uint64_t bits = set[word] & (~(uint64_t)0 << (from % BITSET_WORD_BITS));
+    while (bits == 0) {
+        if (++word >= wordCount) {
+            return -1;
+        }
+        bits = set[word];
+    }
+    return word * BITSET_WORD_BITS + __builtin_ctzll(bits);
+}
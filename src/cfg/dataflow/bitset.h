@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define BITSET_WORD_BITS 64
+// rows are padded to whole chunks, so every row of a matrix stays 16-byte aligned
+#define BITSET_CHUNK_WORDS 2
+
+typedef uint64_t BitSetChunk __attribute__((vector_size(16)));
+
+uint32_t getBitSetWordCount(uint32_t bitCount);
+
+uint64_t* createBitSetMatrix(uint32_t rowCount, uint32_t wordCount);
+
+void setBit(uint64_t *set, uint32_t bit);
+
+void clearBit(uint64_t *set, uint32_t bit);
+
+bool testBit(const uint64_t *set, uint32_t bit);
+
+void clearBitSet(uint64_t *set, uint32_t wordCount);
+
+void fillBitSet(uint64_t *set, uint32_t wordCount, uint32_t bitCount);
+
+void copyBitSet(uint64_t *dst, const uint64_t *src, uint32_t wordCount);
+
+bool unionBitSet(uint64_t *dst, const uint64_t *src, uint32_t wordCount);
+
+bool intersectBitSet(uint64_t *dst, const uint64_t *src, uint32_t wordCount);
+
+void subtractBitSet(uint64_t *dst, const uint64_t *src, uint32_t wordCount);
+
+bool transferBitSet(uint64_t *out, const uint64_t *in, const uint64_t *gen, const uint64_t *kill, uint32_t wordCount);
+
+uint32_t countBitSet(const uint64_t *set, uint32_t wordCount);
+
+int32_t nextSetBit(const uint64_t *set, uint32_t wordCount, uint32_t from);
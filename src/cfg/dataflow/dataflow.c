@@ -0,0 +1,220 @@
+#include "dataflow.h"
+#include <stdlib.h>
+#include <string.h>
+
+static void buildOrderEdges(BlockOrder *order) {
+    uint32_t n = order->blockCount;
+    order->succOffsets = (uint32_t *)calloc(n + 1, sizeof(uint32_t));
+    order->predOffsets = (uint32_t *)calloc(n + 1, sizeof(uint32_t));
+    for (uint32_t i = 0; i < n; i++) {
+        Edge *edge = order->blocks[i]->outEdges;
+        while (edge != NULL) {
+            int32_t target = getBlockOrderIndex(order, edge->targetBlock);
+            order->succOffsets[i + 1]++;
+            order->predOffsets[target + 1]++;
+            edge = edge->nextOut;
+        }
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        order->succOffsets[i + 1] += order->succOffsets[i];
+        order->predOffsets[i + 1] += order->predOffsets[i];
+    }
+    order->succs = (uint32_t *)malloc(sizeof(uint32_t) * (order->succOffsets[n] + 1));
+    order->preds = (uint32_t *)malloc(sizeof(uint32_t) * (order->predOffsets[n] + 1));
+    uint32_t *predFill = (uint32_t *)malloc(sizeof(uint32_t) * (n + 1));
+    memcpy(predFill, order->predOffsets, sizeof(uint32_t) * (n + 1));
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t succFill = order->succOffsets[i];
+        Edge *edge = order->blocks[i]->outEdges;
+        while (edge != NULL) {
+            int32_t target = getBlockOrderIndex(order, edge->targetBlock);
+            order->succs[succFill++] = target;
+            order->preds[predFill[target]++] = i;
+            edge = edge->nextOut;
+        }
+    }
+    free(predFill);
+}
+
+BlockOrder* buildBlockOrder(CFG *cfg) {
+    BlockOrder *order = (BlockOrder *)malloc(sizeof(BlockOrder));
+    order->idCount = getMaxBlockId(cfg) + 1;
+    order->indexById = (int32_t *)malloc(sizeof(int32_t) * (order->idCount > 0 ? order->idCount : 1));
+    for (int i = 0; i < order->idCount; i++) {
+        order->indexById[i] = -1;
+    }
+    order->blocks = (BasicBlock **)malloc(sizeof(BasicBlock *) * (order->idCount > 0 ? order->idCount : 1));
+    order->blockCount = 0;
+    if (cfg->entryBlock == NULL) {
+        order->succOffsets = (uint32_t *)calloc(1, sizeof(uint32_t));
+        order->predOffsets = (uint32_t *)calloc(1, sizeof(uint32_t));
+        order->succs = NULL;
+        order->preds = NULL;
+        return order;
+    }
+
+    // iterative DFS, blocks are collected in postorder and reversed afterwards
+    BasicBlock **stackBlock = (BasicBlock **)malloc(sizeof(BasicBlock *) * order->idCount);
+    Edge **stackEdge = (Edge **)malloc(sizeof(Edge *) * order->idCount);
+    bool *visited = (bool *)calloc(order->idCount, sizeof(bool));
+    uint32_t stackSize = 1;
+    stackBlock[0] = cfg->entryBlock;
+    stackEdge[0] = cfg->entryBlock->outEdges;
+    visited[cfg->entryBlock->id] = true;
+    while (stackSize > 0) {
+        Edge *edge = stackEdge[stackSize - 1];
+        if (edge == NULL) {
+            order->blocks[order->blockCount++] = stackBlock[--stackSize];
+            continue;
+        }
+        stackEdge[stackSize - 1] = edge->nextOut;
+        if (!visited[edge->targetBlock->id]) {
+            visited[edge->targetBlock->id] = true;
+            stackBlock[stackSize] = edge->targetBlock;
+            stackEdge[stackSize] = edge->targetBlock->outEdges;
+            stackSize++;
+        }
+    }
+    free(stackBlock);
+    free(stackEdge);
+    free(visited);
+
+    for (uint32_t i = 0; i < order->blockCount / 2; i++) {
+        BasicBlock *tmp = order->blocks[i];
+        order->blocks[i] = order->blocks[order->blockCount - 1 - i];
+        order->blocks[order->blockCount - 1 - i] = tmp;
+    }
+    for (uint32_t i = 0; i < order->blockCount; i++) {
+        order->indexById[order->blocks[i]->id] = i;
+    }
+    buildOrderEdges(order);
+    return order;
+}
+
+int32_t getBlockOrderIndex(BlockOrder *order, BasicBlock *block) {
+    if (block == NULL || block->id < 0 || block->id >= order->idCount) {
+        return -1;
+    }
+    return order->indexById[block->id];
+}
+
+void freeBlockOrder(BlockOrder *order) {
+    if (order == NULL) {
+        return;
+    }
+    free(order->blocks);
+    free(order->indexById);
+    free(order->succOffsets);
+    free(order->succs);
+    free(order->predOffsets);
+    free(order->preds);
+    free(order);
+}
+
+DataflowResult* createDataflowResult(uint32_t blockCount, uint32_t bitCount, DataflowDirection direction, DataflowMeet meet) {
+    DataflowResult *result = (DataflowResult *)malloc(sizeof(DataflowResult));
+    result->direction = direction;
+    result->meet = meet;
+    result->blockCount = blockCount;
+    result->bitCount = bitCount;
+    result->wordCount = getBitSetWordCount(bitCount);
+    result->gen = createBitSetMatrix(blockCount, result->wordCount);
+    result->kill = createBitSetMatrix(blockCount, result->wordCount);
+    result->in = createBitSetMatrix(blockCount, result->wordCount);
+    result->out = createBitSetMatrix(blockCount, result->wordCount);
+    result->visits = 0;
+    return result;
+}
+
+uint64_t* getDataflowRow(DataflowResult *result, uint64_t *matrix, uint32_t blockIndex) {
+    return matrix + (size_t)blockIndex * result->wordCount;
+}
+
+static void meetInto(DataflowResult *result, uint64_t *target, const uint64_t *source, bool first) {
+    if (first) {
+        copyBitSet(target, source, result->wordCount);
+    } else if (result->meet == DATAFLOW_UNION) {
+        unionBitSet(target, source, result->wordCount);
+    } else {
+        intersectBitSet(target, source, result->wordCount);
+    }
+}
+
+// Round-robin worklist: pending blocks are always taken in RPO for forward problems
+// and in postorder for backward ones, so acyclic regions converge in one sweep.
+void solveDataflow(DataflowResult *result, BlockOrder *order, const uint64_t *boundary) {
+    uint32_t n = order->blockCount;
+    uint32_t words = result->wordCount;
+    bool forward = result->direction == DATAFLOW_FORWARD;
+    uint64_t *meetSide = forward ? result->in : result->out;
+    uint64_t *transferSide = forward ? result->out : result->in;
+
+    for (uint32_t b = 0; b < n; b++) {
+        uint64_t *row = getDataflowRow(result, transferSide, b);
+        if (result->meet == DATAFLOW_INTERSECTION) {
+            fillBitSet(row, words, result->bitCount);
+        } else {
+            clearBitSet(row, words);
+        }
+    }
+
+    uint64_t *pending = createBitSetMatrix(1, getBitSetWordCount(n));
+    fillBitSet(pending, getBitSetWordCount(n), n);
+    uint32_t pendingCount = n;
+
+    while (pendingCount > 0) {
+        for (uint32_t step = 0; step < n; step++) {
+            uint32_t b = forward ? step : n - 1 - step;
+            if (!testBit(pending, b)) {
+                continue;
+            }
+            clearBit(pending, b);
+            pendingCount--;
+
+            uint32_t *neighbours = forward ? order->preds : order->succs;
+            uint32_t from = forward ? order->predOffsets[b] : order->succOffsets[b];
+            uint32_t to = forward ? order->predOffsets[b + 1] : order->succOffsets[b + 1];
+            uint64_t *meetRow = getDataflowRow(result, meetSide, b);
+            if ((forward && b == 0) || from == to) {
+                if (boundary != NULL) {
+                    copyBitSet(meetRow, boundary, words);
+                } else {
+                    clearBitSet(meetRow, words);
+                }
+            } else {
+                for (uint32_t i = from; i < to; i++) {
+                    meetInto(result, meetRow, getDataflowRow(result, transferSide, neighbours[i]), i == from);
+                }
+            }
+
+            result->visits++;
+            bool changed = transferBitSet(getDataflowRow(result, transferSide, b), meetRow,
+                                          getDataflowRow(result, result->gen, b),
+                                          getDataflowRow(result, result->kill, b), words);
+            if (!changed) {
+                continue;
+            }
+            uint32_t *dependents = forward ? order->succs : order->preds;
+            uint32_t depFrom = forward ? order->succOffsets[b] : order->predOffsets[b];
+            uint32_t depTo = forward ? order->succOffsets[b + 1] : order->predOffsets[b + 1];
+            for (uint32_t i = depFrom; i < depTo; i++) {
+                if (!testBit(pending, dependents[i])) {
+                    setBit(pending, dependents[i]);
+                    pendingCount++;
+                }
+            }
+        }
+    }
+    free(pending);
+}
+
+void freeDataflowResult(DataflowResult *result) {
+    if (result == NULL) {
+        return;
+    }
+    free(result->gen);
+    free(result->kill);
+    free(result->in);
+    free(result->out);
+    free(result);
+}
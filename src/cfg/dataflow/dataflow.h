@@ -0,0 +1,54 @@
+#pragma once
+
+#include "cfg/cfg.h"
+#include "bitset.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum {
+    DATAFLOW_FORWARD,
+    DATAFLOW_BACKWARD
+} DataflowDirection;
+
+typedef enum {
+    DATAFLOW_UNION,
+    DATAFLOW_INTERSECTION
+} DataflowMeet;
+
+typedef struct BlockOrder {
+    uint32_t blockCount;
+    BasicBlock **blocks;       // blocks reachable from entry in reverse postorder
+    int32_t *indexById;        // block id -> order index, -1 for unreachable blocks
+    int idCount;
+    uint32_t *succOffsets;     // successors of block i are succs[succOffsets[i] .. succOffsets[i + 1])
+    uint32_t *succs;
+    uint32_t *predOffsets;
+    uint32_t *preds;
+} BlockOrder;
+
+typedef struct DataflowResult {
+    DataflowDirection direction;
+    DataflowMeet meet;
+    uint32_t blockCount;
+    uint32_t bitCount;
+    uint32_t wordCount;
+    uint64_t *gen;             // one row of wordCount words per block, in BlockOrder order
+    uint64_t *kill;
+    uint64_t *in;
+    uint64_t *out;
+    uint32_t visits;           // transfer function evaluations until fixpoint
+} DataflowResult;
+
+BlockOrder* buildBlockOrder(CFG *cfg);
+
+int32_t getBlockOrderIndex(BlockOrder *order, BasicBlock *block);
+
+void freeBlockOrder(BlockOrder *order);
+
+DataflowResult* createDataflowResult(uint32_t blockCount, uint32_t bitCount, DataflowDirection direction, DataflowMeet meet);
+
+uint64_t* getDataflowRow(DataflowResult *result, uint64_t *matrix, uint32_t blockIndex);
+
+void solveDataflow(DataflowResult *result, BlockOrder *order, const uint64_t *boundary);
+
+void freeDataflowResult(DataflowResult *result);
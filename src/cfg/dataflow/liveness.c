@@ -0,0 +1,61 @@
+#include "liveness.h"
+#include <stdio.h>
+
+DataflowResult* computeLiveness(FunctionAccesses *accesses) {
+    BlockOrder *order = accesses->order;
+    DataflowResult *liveness = createDataflowResult(order->blockCount, accesses->variables->count, DATAFLOW_BACKWARD, DATAFLOW_UNION);
+    for (uint32_t b = 0; b < order->blockCount; b++) {
+        uint64_t *gen = getDataflowRow(liveness, liveness->gen, b);
+        uint64_t *kill = getDataflowRow(liveness, liveness->kill, b);
+        BlockAccesses *blockAccesses = &accesses->blocks[b];
+        for (uint32_t i = 0; i < blockAccesses->count; i++) {
+            VarAccess *access = &blockAccesses->accesses[i];
+            if (readsVariableValue(access->kind)) {
+                if (!testBit(kill, access->variable)) {
+                    setBit(gen, access->variable);
+                }
+            } else if (isFullDefinition(access->kind)) {
+                setBit(kill, access->variable);
+            }
+        }
+    }
+    solveDataflow(liveness, order, NULL);
+    return liveness;
+}
+
+static bool isVariableLive(FunctionAccesses *accesses, DataflowResult *liveness, uint64_t *matrix, BasicBlock *block, OperationTreeNode *leaf) {
+    int32_t index = getBlockOrderIndex(accesses->order, block);
+    int32_t variable = findLeafVariable(accesses->variables, leaf);
+    if (index == -1 || variable == -1) {
+        return false;
+    }
+    return testBit(getDataflowRow(liveness, matrix, index), variable);
+}
+
+bool isVariableLiveIn(FunctionAccesses *accesses, DataflowResult *liveness, BasicBlock *block, OperationTreeNode *leaf) {
+    return isVariableLive(accesses, liveness, liveness->in, block, leaf);
+}
+
+bool isVariableLiveOut(FunctionAccesses *accesses, DataflowResult *liveness, BasicBlock *block, OperationTreeNode *leaf) {
+    return isVariableLive(accesses, liveness, liveness->out, block, leaf);
+}
+
+static void printVariableSet(FunctionAccesses *accesses, DataflowResult *liveness, uint64_t *set) {
+    int32_t bit = nextSetBit(set, liveness->wordCount, 0);
+    while (bit != -1) {
+        printf(" %s", accesses->variables->names[bit]);
+        bit = nextSetBit(set, liveness->wordCount, bit + 1);
+    }
+    printf("\n");
+}
+
+void printLiveness(FunctionAccesses *accesses, DataflowResult *liveness) {
+    printf("Liveness (%u transfer evaluations):\n", liveness->visits);
+    for (uint32_t b = 0; b < accesses->order->blockCount; b++) {
+        printf("  BB%d live in:", accesses->order->blocks[b]->id);
+        printVariableSet(accesses, liveness, getDataflowRow(liveness, liveness->in, b));
+        printf("  BB%d live out:", accesses->order->blocks[b]->id);
+        printVariableSet(accesses, liveness, getDataflowRow(liveness, liveness->out, b));
+    }
+    printf("\n");
+}
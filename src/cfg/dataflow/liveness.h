@@ -0,0 +1,13 @@
+#pragma once
+
+#include "access.h"
+#include "dataflow.h"
+#include <stdbool.h>
+
+DataflowResult* computeLiveness(FunctionAccesses *accesses);
+
+bool isVariableLiveIn(FunctionAccesses *accesses, DataflowResult *liveness, BasicBlock *block, OperationTreeNode *leaf);
+
+bool isVariableLiveOut(FunctionAccesses *accesses, DataflowResult *liveness, BasicBlock *block, OperationTreeNode *leaf);
+
+void printLiveness(FunctionAccesses *accesses, DataflowResult *liveness);
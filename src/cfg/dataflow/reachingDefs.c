@@ -0,0 +1,134 @@
+#include "reachingDefs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void numberDefinitions(ReachingDefinitions *definitions) {
+    FunctionAccesses *accesses = definitions->accesses;
+    uint32_t blockCount = accesses->order->blockCount;
+    uint32_t variableCount = accesses->variables->count;
+
+    definitions->definitionCount = 0;
+    definitions->definitionByAccess = (int32_t **)malloc(sizeof(int32_t *) * (blockCount + 1));
+    for (uint32_t b = 0; b < blockCount; b++) {
+        BlockAccesses *blockAccesses = &accesses->blocks[b];
+        definitions->definitionByAccess[b] = (int32_t *)malloc(sizeof(int32_t) * (blockAccesses->count + 1));
+        for (uint32_t i = 0; i < blockAccesses->count; i++) {
+            definitions->definitionByAccess[b][i] = blockAccesses->accesses[i].kind == ACCESS_USE ? -1 : (int32_t)definitions->definitionCount++;
+        }
+    }
+
+    definitions->definitions = (Definition *)malloc(sizeof(Definition) * (definitions->definitionCount + 1));
+    definitions->variableDefOffsets = (uint32_t *)calloc(variableCount + 1, sizeof(uint32_t));
+    for (uint32_t b = 0; b < blockCount; b++) {
+        BlockAccesses *blockAccesses = &accesses->blocks[b];
+        for (uint32_t i = 0; i < blockAccesses->count; i++) {
+            int32_t id = definitions->definitionByAccess[b][i];
+            if (id == -1) {
+                continue;
+            }
+            definitions->definitions[id].variable = blockAccesses->accesses[i].variable;
+            definitions->definitions[id].block = b;
+            definitions->definitions[id].access = i;
+            definitions->variableDefOffsets[blockAccesses->accesses[i].variable + 1]++;
+        }
+    }
+    for (uint32_t v = 0; v < variableCount; v++) {
+        definitions->variableDefOffsets[v + 1] += definitions->variableDefOffsets[v];
+    }
+    definitions->variableDefs = (uint32_t *)malloc(sizeof(uint32_t) * (definitions->definitionCount + 1));
+    uint32_t *fill = (uint32_t *)malloc(sizeof(uint32_t) * (variableCount + 1));
+    memcpy(fill, definitions->variableDefOffsets, sizeof(uint32_t) * (variableCount + 1));
+    for (uint32_t d = 0; d < definitions->definitionCount; d++) {
+        definitions->variableDefs[fill[definitions->definitions[d].variable]++] = d;
+    }
+    free(fill);
+}
+
+static void killVariableDefinitions(ReachingDefinitions *definitions, uint64_t *set, uint32_t variable) {
+    for (uint32_t i = definitions->variableDefOffsets[variable]; i < definitions->variableDefOffsets[variable + 1]; i++) {
+        clearBit(set, definitions->variableDefs[i]);
+    }
+}
+
+void applyReachingAccess(ReachingDefinitions *definitions, uint64_t *set, uint32_t block, uint32_t access) {
+    VarAccess *varAccess = &definitions->accesses->blocks[block].accesses[access];
+    if (varAccess->kind == ACCESS_USE) {
+        return;
+    }
+    if (isFullDefinition(varAccess->kind)) {
+        killVariableDefinitions(definitions, set, varAccess->variable);
+    }
+    setBit(set, definitions->definitionByAccess[block][access]);
+}
+
+ReachingDefinitions* computeReachingDefinitions(FunctionAccesses *accesses) {
+    ReachingDefinitions *definitions = (ReachingDefinitions *)malloc(sizeof(ReachingDefinitions));
+    definitions->accesses = accesses;
+    numberDefinitions(definitions);
+
+    BlockOrder *order = accesses->order;
+    DataflowResult *result = createDataflowResult(order->blockCount, definitions->definitionCount, DATAFLOW_FORWARD, DATAFLOW_UNION);
+    for (uint32_t b = 0; b < order->blockCount; b++) {
+        uint64_t *gen = getDataflowRow(result, result->gen, b);
+        uint64_t *kill = getDataflowRow(result, result->kill, b);
+        BlockAccesses *blockAccesses = &accesses->blocks[b];
+        for (uint32_t i = 0; i < blockAccesses->count; i++) {
+            VarAccess *access = &blockAccesses->accesses[i];
+            if (access->kind == ACCESS_USE) {
+                continue;
+            }
+            if (isFullDefinition(access->kind)) {
+                for (uint32_t d = definitions->variableDefOffsets[access->variable]; d < definitions->variableDefOffsets[access->variable + 1]; d++) {
+                    setBit(kill, definitions->variableDefs[d]);
+                }
+            }
+            applyReachingAccess(definitions, gen, b, i);
+        }
+    }
+    solveDataflow(result, order, NULL);
+    definitions->result = result;
+    return definitions;
+}
+
+void getReachingDefinitionsAt(ReachingDefinitions *definitions, uint32_t block, uint32_t access, uint64_t *set) {
+    copyBitSet(set, getDataflowRow(definitions->result, definitions->result->in, block), definitions->result->wordCount);
+    for (uint32_t i = 0; i < access; i++) {
+        applyReachingAccess(definitions, set, block, i);
+    }
+}
+
+void printReachingDefinitions(ReachingDefinitions *definitions) {
+    FunctionAccesses *accesses = definitions->accesses;
+    DataflowResult *result = definitions->result;
+    printf("Reaching definitions (%u transfer evaluations):\n", result->visits);
+    for (uint32_t b = 0; b < accesses->order->blockCount; b++) {
+        printf("  BB%d reaching in:", accesses->order->blocks[b]->id);
+        uint64_t *in = getDataflowRow(result, result->in, b);
+        int32_t d = nextSetBit(in, result->wordCount, 0);
+        while (d != -1) {
+            Definition *definition = &definitions->definitions[d];
+            VarAccess *access = &accesses->blocks[definition->block].accesses[definition->access];
+            printf(" %s@BB%d:%u", accesses->variables->names[definition->variable],
+                   accesses->order->blocks[definition->block]->id, access->instruction);
+            d = nextSetBit(in, result->wordCount, d + 1);
+        }
+        printf("\n");
+    }
+    printf("\n");
+}
+
+void freeReachingDefinitions(ReachingDefinitions *definitions) {
+    if (definitions == NULL) {
+        return;
+    }
+    for (uint32_t b = 0; b < definitions->accesses->order->blockCount; b++) {
+        free(definitions->definitionByAccess[b]);
+    }
+    free(definitions->definitionByAccess);
+    free(definitions->definitions);
+    free(definitions->variableDefOffsets);
+    free(definitions->variableDefs);
+    freeDataflowResult(definitions->result);
+    free(definitions);
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "access.h"
+#include "dataflow.h"
+#include <stdint.h>
+
+typedef struct Definition {
+    uint32_t variable;
+    uint32_t block;            // BlockOrder index
+    uint32_t access;           // index in the block accesses
+} Definition;
+
+typedef struct ReachingDefinitions {
+    FunctionAccesses *accesses;
+    uint32_t definitionCount;
+    Definition *definitions;   // numbered in block order, then in evaluation order inside a block
+    int32_t **definitionByAccess; // per block: access index -> definition id, -1 for uses
+    uint32_t *variableDefOffsets; // definitions of variable v are variableDefs[variableDefOffsets[v] .. variableDefOffsets[v + 1])
+    uint32_t *variableDefs;
+    DataflowResult *result;
+} ReachingDefinitions;
+
+ReachingDefinitions* computeReachingDefinitions(FunctionAccesses *accesses);
+
+// updates a reaching set with the effect of one access of the block
+void applyReachingAccess(ReachingDefinitions *definitions, uint64_t *set, uint32_t block, uint32_t access);
+
+void getReachingDefinitionsAt(ReachingDefinitions *definitions, uint32_t block, uint32_t access, uint64_t *set);
+
+void printReachingDefinitions(ReachingDefinitions *definitions);
+
+void freeReachingDefinitions(ReachingDefinitions *definitions);
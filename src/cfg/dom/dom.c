@@ -0,0 +1,495 @@
+#include "dom.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct DomGraph {
+    uint32_t vertexCount;       // block ids and the virtual exit (last vertex) for post-dominators
+    uint32_t *adjOffsets;       // successors in the search direction
+    uint32_t *adj;
+    uint32_t *exitAdj;          // successors of the virtual exit, grown while searching
+    uint32_t exitAdjCount;
+    uint32_t nodeCount;         // vertices reached by DFS, numbered in preorder
+    uint32_t *vertexOf;
+    int32_t *nodeOf;
+    int32_t *parent;
+    uint32_t *postNumber;
+    uint32_t *predOffsets;
+    uint32_t *preds;
+} DomGraph;
+
+static void buildAdjacency(DomGraph *graph, CFG *cfg, bool reverse) {
+    graph->adjOffsets = (uint32_t *)calloc(graph->vertexCount + 1, sizeof(uint32_t));
+    BasicBlock *block = cfg->blocks;
+    while (block != NULL) {
+        Edge *edge = reverse ? block->inEdges : block->outEdges;
+        while (edge != NULL) {
+            graph->adjOffsets[block->id + 1]++;
+            edge = reverse ? edge->nextIn : edge->nextOut;
+        }
+        block = block->next;
+    }
+    for (uint32_t i = 0; i < graph->vertexCount; i++) {
+        graph->adjOffsets[i + 1] += graph->adjOffsets[i];
+    }
+    graph->adj = (uint32_t *)malloc(sizeof(uint32_t) * (graph->adjOffsets[graph->vertexCount] + 1));
+    block = cfg->blocks;
+    while (block != NULL) {
+        uint32_t fill = graph->adjOffsets[block->id];
+        Edge *edge = reverse ? block->inEdges : block->outEdges;
+        while (edge != NULL) {
+            graph->adj[fill++] = reverse ? edge->fromBlock->id : edge->targetBlock->id;
+            edge = reverse ? edge->nextIn : edge->nextOut;
+        }
+        block = block->next;
+    }
+}
+
+static void searchGraph(DomGraph *graph, CFG *cfg, uint32_t root, bool hasVirtualExit) {
+    graph->vertexOf = (uint32_t *)malloc(sizeof(uint32_t) * graph->vertexCount);
+    graph->nodeOf = (int32_t *)malloc(sizeof(int32_t) * graph->vertexCount);
+    graph->parent = (int32_t *)malloc(sizeof(int32_t) * graph->vertexCount);
+    graph->postNumber = (uint32_t *)malloc(sizeof(uint32_t) * graph->vertexCount);
+    for (uint32_t i = 0; i < graph->vertexCount; i++) {
+        graph->nodeOf[i] = DOM_NO_NODE;
+    }
+
+    uint32_t *stackVertex = (uint32_t *)malloc(sizeof(uint32_t) * graph->vertexCount);
+    uint32_t *stackPosition = (uint32_t *)malloc(sizeof(uint32_t) * graph->vertexCount);
+    uint32_t stackSize = 0;
+    uint32_t postCounter = 0;
+    BasicBlock *unvisitedCursor = cfg->blocks;
+
+    graph->nodeCount = 1;
+    graph->vertexOf[0] = root;
+    graph->nodeOf[root] = 0;
+    graph->parent[0] = DOM_NO_NODE;
+    stackVertex[0] = root;
+    stackPosition[0] = 0;
+    stackSize = 1;
+
+    while (stackSize > 0) {
+        uint32_t vertex = stackVertex[stackSize - 1];
+        uint32_t position = stackPosition[stackSize - 1]++;
+        uint32_t next;
+        bool hasNext;
+        if (hasVirtualExit && vertex == root) {
+            // blocks that can't reach any exit (endless loops) hang off the virtual exit too
+            while (graph->exitAdjCount <= position && unvisitedCursor != NULL) {
+                if (graph->nodeOf[unvisitedCursor->id] == DOM_NO_NODE) {
+                    graph->exitAdj[graph->exitAdjCount++] = unvisitedCursor->id;
+                }
+                unvisitedCursor = unvisitedCursor->next;
+            }
+            hasNext = position < graph->exitAdjCount;
+            next = hasNext ? graph->exitAdj[position] : 0;
+        } else {
+            hasNext = graph->adjOffsets[vertex] + position < graph->adjOffsets[vertex + 1];
+            next = hasNext ? graph->adj[graph->adjOffsets[vertex] + position] : 0;
+        }
+
+        if (!hasNext) {
+            graph->postNumber[graph->nodeOf[vertex]] = postCounter++;
+            stackSize--;
+        } else if (graph->nodeOf[next] == DOM_NO_NODE) {
+            graph->nodeOf[next] = graph->nodeCount;
+            graph->vertexOf[graph->nodeCount] = next;
+            graph->parent[graph->nodeCount] = graph->nodeOf[vertex];
+            graph->nodeCount++;
+            stackVertex[stackSize] = next;
+            stackPosition[stackSize] = 0;
+            stackSize++;
+        }
+    }
+
+    free(stackVertex);
+    free(stackPosition);
+}
+
+static void buildPredecessors(DomGraph *graph, uint32_t root, bool hasVirtualExit) {
+    graph->predOffsets = (uint32_t *)calloc(graph->nodeCount + 1, sizeof(uint32_t));
+    for (uint32_t v = 0; v < graph->nodeCount; v++) {
+        uint32_t vertex = graph->vertexOf[v];
+        if (hasVirtualExit && vertex == root) {
+            for (uint32_t i = 0; i < graph->exitAdjCount; i++) {
+                graph->predOffsets[graph->nodeOf[graph->exitAdj[i]] + 1]++;
+            }
+            continue;
+        }
+        for (uint32_t i = graph->adjOffsets[vertex]; i < graph->adjOffsets[vertex + 1]; i++) {
+            if (graph->nodeOf[graph->adj[i]] != DOM_NO_NODE) {
+                graph->predOffsets[graph->nodeOf[graph->adj[i]] + 1]++;
+            }
+        }
+    }
+    for (uint32_t i = 0; i < graph->nodeCount; i++) {
+        graph->predOffsets[i + 1] += graph->predOffsets[i];
+    }
+    graph->preds = (uint32_t *)malloc(sizeof(uint32_t) * (graph->predOffsets[graph->nodeCount] + 1));
+    uint32_t *fill = (uint32_t *)malloc(sizeof(uint32_t) * graph->nodeCount);
+    memcpy(fill, graph->predOffsets, sizeof(uint32_t) * graph->nodeCount);
+    for (uint32_t v = 0; v < graph->nodeCount; v++) {
+        uint32_t vertex = graph->vertexOf[v];
+        if (hasVirtualExit && vertex == root) {
+            for (uint32_t i = 0; i < graph->exitAdjCount; i++) {
+                graph->preds[fill[graph->nodeOf[graph->exitAdj[i]]]++] = v;
+            }
+            continue;
+        }
+        for (uint32_t i = graph->adjOffsets[vertex]; i < graph->adjOffsets[vertex + 1]; i++) {
+            int32_t w = graph->nodeOf[graph->adj[i]];
+            if (w != DOM_NO_NODE) {
+                graph->preds[fill[w]++] = v;
+            }
+        }
+    }
+    free(fill);
+}
+
+static void freeDomGraph(DomGraph *graph) {
+    free(graph->adjOffsets);
+    free(graph->adj);
+    free(graph->exitAdj);
+    free(graph->vertexOf);
+    free(graph->nodeOf);
+    free(graph->parent);
+    free(graph->postNumber);
+    free(graph->predOffsets);
+    free(graph->preds);
+}
+
+static int32_t intersect(DomGraph *graph, int32_t *idom, int32_t a, int32_t b) {
+    while (a != b) {
+        while (graph->postNumber[a] < graph->postNumber[b]) {
+            a = idom[a];
+        }
+        while (graph->postNumber[b] < graph->postNumber[a]) {
+            b = idom[b];
+        }
+    }
+    return a;
+}
+
+// Cooper, Harvey, Kennedy "A Simple, Fast Dominance Algorithm"
+static void computeIdomsIterative(DomGraph *graph, int32_t *idom) {
+    uint32_t n = graph->nodeCount;
+    uint32_t *rpo = (uint32_t *)malloc(sizeof(uint32_t) * n);
+    for (uint32_t v = 0; v < n; v++) {
+        rpo[n - 1 - graph->postNumber[v]] = v;
+        idom[v] = DOM_NO_NODE;
+    }
+    idom[0] = 0;
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (uint32_t i = 1; i < n; i++) {
+            uint32_t b = rpo[i];
+            int32_t newIdom = DOM_NO_NODE;
+            for (uint32_t p = graph->predOffsets[b]; p < graph->predOffsets[b + 1]; p++) {
+                int32_t pred = graph->preds[p];
+                if (idom[pred] == DOM_NO_NODE) {
+                    continue;
+                }
+                newIdom = newIdom == DOM_NO_NODE ? pred : intersect(graph, idom, pred, newIdom);
+            }
+            if (idom[b] != newIdom) {
+                idom[b] = newIdom;
+                changed = true;
+            }
+        }
+    }
+    idom[0] = DOM_NO_NODE;
+    free(rpo);
+}
+
+static void compress(int32_t *ancestor, uint32_t *label, uint32_t *semi, uint32_t *path, uint32_t v) {
+    uint32_t top = 0;
+    path[0] = v;
+    while (ancestor[ancestor[path[top]]] != DOM_NO_NODE) {
+        path[top + 1] = ancestor[path[top]];
+        top++;
+    }
+    while (top > 0) {
+        top--;
+        uint32_t x = path[top];
+        uint32_t a = ancestor[x];
+        if (semi[label[a]] < semi[label[x]]) {
+            label[x] = label[a];
+        }
+        ancestor[x] = ancestor[a];
+    }
+}
+
+// Semi-NCA from Georgiadis, Tarjan "Finding dominators in practice"
+static void computeIdomsSemiNCA(DomGraph *graph, int32_t *idom) {
+    uint32_t n = graph->nodeCount;
+    uint32_t *semi = (uint32_t *)malloc(sizeof(uint32_t) * n);
+    uint32_t *label = (uint32_t *)malloc(sizeof(uint32_t) * n);
+    int32_t *ancestor = (int32_t *)malloc(sizeof(int32_t) * n);
+    uint32_t *path = (uint32_t *)malloc(sizeof(uint32_t) * n);
+    for (uint32_t v = 0; v < n; v++) {
+        semi[v] = v;
+        label[v] = v;
+        ancestor[v] = DOM_NO_NODE;
+    }
+
+    for (uint32_t w = n - 1; w > 0; w--) {
+        for (uint32_t p = graph->predOffsets[w]; p < graph->predOffsets[w + 1]; p++) {
+            uint32_t v = graph->preds[p];
+            uint32_t u = v;
+            if (ancestor[v] != DOM_NO_NODE) {
+                compress(ancestor, label, semi, path, v);
+                u = label[v];
+            }
+            if (semi[u] < semi[w]) {
+                semi[w] = semi[u];
+            }
+        }
+        ancestor[w] = graph->parent[w];
+    }
+
+    idom[0] = DOM_NO_NODE;
+    for (uint32_t w = 1; w < n; w++) {
+        int32_t candidate = graph->parent[w];
+        while ((uint32_t)candidate > semi[w]) {
+            candidate = idom[candidate];
+        }
+        idom[w] = candidate;
+    }
+
+    free(semi);
+    free(label);
+    free(ancestor);
+    free(path);
+}
+
+static void numberDominatorTree(DominatorTree *tree) {
+    uint32_t n = tree->nodeCount;
+    tree->childOffsets = (uint32_t *)calloc(n + 1, sizeof(uint32_t));
+    for (uint32_t v = 1; v < n; v++) {
+        tree->childOffsets[tree->idom[v] + 1]++;
+    }
+    for (uint32_t v = 0; v < n; v++) {
+        tree->childOffsets[v + 1] += tree->childOffsets[v];
+    }
+    tree->children = (uint32_t *)malloc(sizeof(uint32_t) * (n > 1 ? n - 1 : 1));
+    uint32_t *fill = (uint32_t *)malloc(sizeof(uint32_t) * n);
+    memcpy(fill, tree->childOffsets, sizeof(uint32_t) * n);
+    for (uint32_t v = 1; v < n; v++) {
+        tree->children[fill[tree->idom[v]]++] = v;
+    }
+
+    tree->preorder = (uint32_t *)malloc(sizeof(uint32_t) * n);
+    tree->postorder = (uint32_t *)malloc(sizeof(uint32_t) * n);
+    uint32_t *stackNode = fill;
+    uint32_t *stackPosition = (uint32_t *)malloc(sizeof(uint32_t) * n);
+    uint32_t stackSize = 1;
+    uint32_t preCounter = 0;
+    uint32_t postCounter = 0;
+    stackNode[0] = 0;
+    stackPosition[0] = 0;
+    tree->preorder[0] = preCounter++;
+    while (stackSize > 0) {
+        uint32_t v = stackNode[stackSize - 1];
+        uint32_t childIndex = tree->childOffsets[v] + stackPosition[stackSize - 1]++;
+        if (childIndex < tree->childOffsets[v + 1]) {
+            uint32_t child = tree->children[childIndex];
+            tree->preorder[child] = preCounter++;
+            stackNode[stackSize] = child;
+            stackPosition[stackSize] = 0;
+            stackSize++;
+        } else {
+            tree->postorder[v] = postCounter++;
+            stackSize--;
+        }
+    }
+    free(stackNode);
+    free(stackPosition);
+}
+
+static DominatorTree* buildTree(CFG *cfg, bool post) {
+    if (cfg == NULL || cfg->entryBlock == NULL) {
+        return NULL;
+    }
+
+    DomGraph graph;
+    memset(&graph, 0, sizeof(DomGraph));
+    int idCount = getMaxBlockId(cfg) + 1;
+    graph.vertexCount = idCount + (post ? 1 : 0);
+    buildAdjacency(&graph, cfg, post);
+
+    uint32_t root = cfg->entryBlock->id;
+    if (post) {
+        root = idCount;
+        graph.exitAdj = (uint32_t *)malloc(sizeof(uint32_t) * (idCount + 1));
+        BasicBlock *block = cfg->blocks;
+        while (block != NULL) {
+            if (block->outEdges == NULL) {
+                graph.exitAdj[graph.exitAdjCount++] = block->id;
+            }
+            block = block->next;
+        }
+    }
+    searchGraph(&graph, cfg, root, post);
+    buildPredecessors(&graph, root, post);
+
+    DominatorTree *tree = (DominatorTree *)malloc(sizeof(DominatorTree));
+    tree->isPostDominator = post;
+    tree->nodeCount = graph.nodeCount;
+    tree->idCount = idCount;
+    tree->idom = (int32_t *)malloc(sizeof(int32_t) * graph.nodeCount);
+    if (graph.nodeCount <= DOM_SMALL_GRAPH_LIMIT) {
+        computeIdomsIterative(&graph, tree->idom);
+    } else {
+        computeIdomsSemiNCA(&graph, tree->idom);
+    }
+
+    BasicBlock **blocksById = (BasicBlock **)calloc(graph.vertexCount, sizeof(BasicBlock *));
+    BasicBlock *block = cfg->blocks;
+    while (block != NULL) {
+        blocksById[block->id] = block;
+        block = block->next;
+    }
+    tree->blocks = (BasicBlock **)malloc(sizeof(BasicBlock *) * graph.nodeCount);
+    for (uint32_t v = 0; v < graph.nodeCount; v++) {
+        tree->blocks[v] = blocksById[graph.vertexOf[v]];
+    }
+    tree->indexById = (int32_t *)malloc(sizeof(int32_t) * (idCount > 0 ? idCount : 1));
+    memcpy(tree->indexById, graph.nodeOf, sizeof(int32_t) * idCount);
+    free(blocksById);
+
+    numberDominatorTree(tree);
+    freeDomGraph(&graph);
+    return tree;
+}
+
+DominatorTree* buildDominatorTree(CFG *cfg) {
+    return buildTree(cfg, false);
+}
+
+DominatorTree* buildPostDominatorTree(CFG *cfg) {
+    return buildTree(cfg, true);
+}
+
+int32_t getDominatorTreeIndex(DominatorTree *tree, BasicBlock *block) {
+    if (block == NULL || block->id < 0 || block->id >= tree->idCount) {
+        return DOM_NO_NODE;
+    }
+    return tree->indexById[block->id];
+}
+
+bool dominates(DominatorTree *tree, BasicBlock *dominator, BasicBlock *block) {
+    int32_t a = getDominatorTreeIndex(tree, dominator);
+    int32_t b = getDominatorTreeIndex(tree, block);
+    if (a == DOM_NO_NODE || b == DOM_NO_NODE) {
+        return false;
+    }
+    return tree->preorder[a] <= tree->preorder[b] && tree->postorder[b] <= tree->postorder[a];
+}
+
+bool strictlyDominates(DominatorTree *tree, BasicBlock *dominator, BasicBlock *block) {
+    return dominator != block && dominates(tree, dominator, block);
+}
+
+BasicBlock* getImmediateDominator(DominatorTree *tree, BasicBlock *block) {
+    int32_t index = getDominatorTreeIndex(tree, block);
+    if (index == DOM_NO_NODE || tree->idom[index] == DOM_NO_NODE) {
+        return NULL;
+    }
+    return tree->blocks[tree->idom[index]];
+}
+
+void printDominatorTree(DominatorTree *tree) {
+    printf("%s tree:\n", tree->isPostDominator ? "Post-dominator" : "Dominator");
+    for (uint32_t v = 0; v < tree->nodeCount; v++) {
+        if (tree->blocks[v] == NULL) {
+            printf("  EXIT (virtual)\n");
+            continue;
+        }
+        printf("  BB%d (%s)", tree->blocks[v]->id, tree->blocks[v]->name);
+        if (tree->idom[v] == DOM_NO_NODE) {
+            printf(" root\n");
+        } else if (tree->blocks[tree->idom[v]] == NULL) {
+            printf(" idom EXIT\n");
+        } else {
+            printf(" idom BB%d\n", tree->blocks[tree->idom[v]]->id);
+        }
+    }
+    printf("\n");
+}
+
+void freeDominatorTree(DominatorTree *tree) {
+    if (tree == NULL) {
+        return;
+    }
+    free(tree->blocks);
+    free(tree->indexById);
+    free(tree->idom);
+    free(tree->childOffsets);
+    free(tree->children);
+    free(tree->preorder);
+    free(tree->postorder);
+    free(tree);
+}
+
+// Cooper-Harvey-Kennedy: walk up from every predecessor of a join node until its idom,
+// the join node belongs to the frontier of every node on the way. Forward trees only.
+DominanceFrontier* computeDominanceFrontier(DominatorTree *tree) {
+    if (tree == NULL || tree->isPostDominator) {
+        return NULL;
+    }
+    uint32_t n = tree->nodeCount;
+    uint32_t *counts = (uint32_t *)calloc(n + 1, sizeof(uint32_t));
+    int32_t *lastJoin = (int32_t *)malloc(sizeof(int32_t) * (n + 1));
+
+    // first pass counts frontier sizes, second pass fills them
+    DominanceFrontier *frontier = (DominanceFrontier *)malloc(sizeof(DominanceFrontier));
+    frontier->nodeCount = n;
+    frontier->offsets = (uint32_t *)calloc(n + 1, sizeof(uint32_t));
+    frontier->nodes = NULL;
+    for (int pass = 0; pass < 2; pass++) {
+        for (uint32_t v = 0; v < n; v++) {
+            lastJoin[v] = DOM_NO_NODE;
+        }
+        for (uint32_t join = 0; join < n; join++) {
+            Edge *edge = tree->blocks[join]->inEdges;
+            if (edge == NULL || edge->nextIn == NULL) {
+                continue;
+            }
+            for (; edge != NULL; edge = edge->nextIn) {
+                int32_t runner = getDominatorTreeIndex(tree, edge->fromBlock);
+                while (runner != DOM_NO_NODE && runner != tree->idom[join]) {
+                    if (lastJoin[runner] != (int32_t)join) {
+                        lastJoin[runner] = join;
+                        if (pass == 0) {
+                            counts[runner]++;
+                        } else {
+                            frontier->nodes[counts[runner]++] = join;
+                        }
+                    }
+                    runner = tree->idom[runner];
+                }
+            }
+        }
+        if (pass == 0) {
+            for (uint32_t v = 0; v < n; v++) {
+                frontier->offsets[v + 1] = frontier->offsets[v] + counts[v];
+                counts[v] = frontier->offsets[v];
+            }
+            frontier->nodes = (uint32_t *)malloc(sizeof(uint32_t) * (frontier->offsets[n] + 1));
+        }
+    }
+    free(counts);
+    free(lastJoin);
+    return frontier;
+}
+
+void freeDominanceFrontier(DominanceFrontier *frontier) {
+    if (frontier == NULL) {
+        return;
+    }
+    free(frontier->offsets);
+    free(frontier->nodes);
+    free(frontier);
+}
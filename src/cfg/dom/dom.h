@@ -0,0 +1,49 @@
+#pragma once
+
+#include "cfg/cfg.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// graphs up to this size use Cooper-Harvey-Kennedy, bigger ones use Semi-NCA
+#define DOM_SMALL_GRAPH_LIMIT 256
+
+#define DOM_NO_NODE -1
+
+typedef struct DominatorTree {
+    bool isPostDominator;
+    uint32_t nodeCount;
+    BasicBlock **blocks;       // node index -> block, NULL for the virtual exit of post-dominator tree
+    int32_t *indexById;        // block id -> node index, DOM_NO_NODE if block is not in the tree
+    int idCount;
+    int32_t *idom;             // node index -> immediate dominator node index, DOM_NO_NODE for root
+    uint32_t *childOffsets;    // children of node i are children[childOffsets[i] .. childOffsets[i + 1])
+    uint32_t *children;
+    uint32_t *preorder;        // DFS interval numbering of the tree for O(1) dominance queries
+    uint32_t *postorder;
+} DominatorTree;
+
+typedef struct DominanceFrontier {
+    uint32_t nodeCount;        // indexed like the nodes of the dominator tree it was computed from
+    uint32_t *offsets;         // frontier of node i is nodes[offsets[i] .. offsets[i + 1])
+    uint32_t *nodes;
+} DominanceFrontier;
+
+DominatorTree* buildDominatorTree(CFG *cfg);
+
+DominatorTree* buildPostDominatorTree(CFG *cfg);
+
+int32_t getDominatorTreeIndex(DominatorTree *tree, BasicBlock *block);
+
+bool dominates(DominatorTree *tree, BasicBlock *dominator, BasicBlock *block);
+
+bool strictlyDominates(DominatorTree *tree, BasicBlock *dominator, BasicBlock *block);
+
+BasicBlock* getImmediateDominator(DominatorTree *tree, BasicBlock *block);
+
+void printDominatorTree(DominatorTree *tree);
+
+void freeDominatorTree(DominatorTree *tree);
+
+DominanceFrontier* computeDominanceFrontier(DominatorTree *tree);
+
+void freeDominanceFrontier(DominanceFrontier *frontier);
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+
+// FNV-1a, used by the name tables of the analyses
+static inline uint32_t hashString(const char *text) {
+    uint32_t hash = 2166136261u;
+    while (*text) {
+        hash ^= (uint8_t)*text++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static inline uint32_t hashBytes(const char *data, uint32_t length) {
+    uint32_t hash = 2166136261u;
+    for (uint32_t i = 0; i < length; i++) {
+        hash ^= (uint8_t)data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static inline uint32_t hashCombine(uint32_t hash, uint32_t value) {
+    hash ^= value + 0x9e3779b9u + (hash << 6) + (hash >> 2);
+    return hash;
+}
+
+static inline uint32_t hashPointer(const void *pointer) {
+    uint64_t value = (uint64_t)(uintptr_t)pointer;
+    return hashCombine((uint32_t)value, (uint32_t)(value >> 32));
+}
@@ -0,0 +1,213 @@
+#include "loops.h"
+#include "cfg/dom/dom.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+static int32_t addLoop(LoopForest *forest, uint32_t *capacity, BasicBlock *header) {
+    if (forest->loopCount >= *capacity) {
+        *capacity = *capacity == 0 ? INITIAL_CAPACITY : *capacity * 2;
+        forest->loops = (Loop *)realloc(forest->loops, sizeof(Loop) * *capacity);
+    }
+    Loop *loop = &forest->loops[forest->loopCount];
+    loop->header = header;
+    loop->parent = LOOP_NONE;
+    loop->depth = 0;
+    loop->blockCount = 0;
+    loop->exits = NULL;
+    loop->exitCount = 0;
+    loop->exitCapacity = 0;
+    return forest->loopCount++;
+}
+
+static void addLoopExit(Loop *loop, BasicBlock *exit) {
+    for (uint32_t i = 0; i < loop->exitCount; i++) {
+        if (loop->exits[i] == exit) {
+            return;
+        }
+    }
+    if (loop->exitCount >= loop->exitCapacity) {
+        loop->exitCapacity = loop->exitCapacity == 0 ? INITIAL_CAPACITY : loop->exitCapacity * 2;
+        loop->exits = (BasicBlock **)realloc(loop->exits, sizeof(BasicBlock *) * loop->exitCapacity);
+    }
+    loop->exits[loop->exitCount++] = exit;
+}
+
+static int32_t getOutermostLoop(LoopForest *forest, int32_t loop) {
+    while (forest->loops[loop].parent != LOOP_NONE) {
+        loop = forest->loops[loop].parent;
+    }
+    return loop;
+}
+
+// Walks backwards from the latches to the header. Blocks that already belong to
+// an inner loop are skipped by jumping to the header of its outermost loop found so far,
+// that loop becomes a child of the current one.
+static void collectLoopBody(LoopForest *forest, DominatorTree *tree, int32_t loop, BasicBlock **stack, int32_t *visited) {
+    BasicBlock *header = forest->loops[loop].header;
+    uint32_t stackSize = 0;
+    visited[header->id] = loop;
+    if (forest->loopById[header->id] == LOOP_NONE) {
+        forest->loopById[header->id] = loop;
+    }
+    for (Edge *edge = header->inEdges; edge != NULL; edge = edge->nextIn) {
+        if (visited[edge->fromBlock->id] != loop && dominates(tree, header, edge->fromBlock)) {
+            visited[edge->fromBlock->id] = loop;
+            stack[stackSize++] = edge->fromBlock;
+        }
+    }
+
+    while (stackSize > 0) {
+        BasicBlock *block = stack[--stackSize];
+        int32_t owner = forest->loopById[block->id];
+        if (owner == LOOP_NONE) {
+            forest->loopById[block->id] = loop;
+        } else {
+            int32_t inner = getOutermostLoop(forest, owner);
+            if (inner == loop) {
+                continue;
+            }
+            forest->loops[inner].parent = loop;
+            block = forest->loops[inner].header;
+            visited[block->id] = loop;
+        }
+        for (Edge *edge = block->inEdges; edge != NULL; edge = edge->nextIn) {
+            BasicBlock *pred = edge->fromBlock;
+            if (visited[pred->id] != loop && getDominatorTreeIndex(tree, pred) != DOM_NO_NODE) {
+                visited[pred->id] = loop;
+                stack[stackSize++] = pred;
+            }
+        }
+    }
+}
+
+LoopForest* buildLoopForest(CFG *cfg) {
+    LoopForest *forest = (LoopForest *)malloc(sizeof(LoopForest));
+    forest->loopCount = 0;
+    forest->loops = NULL;
+    forest->idCount = getMaxBlockId(cfg) + 1;
+    forest->loopById = (int32_t *)malloc(sizeof(int32_t) * (forest->idCount > 0 ? forest->idCount : 1));
+    for (int i = 0; i < forest->idCount; i++) {
+        forest->loopById[i] = LOOP_NONE;
+    }
+    DominatorTree *tree = buildDominatorTree(cfg);
+    if (tree == NULL) {
+        return forest;
+    }
+
+    // headers are taken in reverse dominator tree preorder, so inner loops come first
+    uint32_t *nodeByPreorder = (uint32_t *)malloc(sizeof(uint32_t) * tree->nodeCount);
+    for (uint32_t v = 0; v < tree->nodeCount; v++) {
+        nodeByPreorder[tree->preorder[v]] = v;
+    }
+    BasicBlock **stack = (BasicBlock **)malloc(sizeof(BasicBlock *) * forest->idCount);
+    int32_t *visited = (int32_t *)malloc(sizeof(int32_t) * forest->idCount);
+    for (int i = 0; i < forest->idCount; i++) {
+        visited[i] = LOOP_NONE;
+    }
+    uint32_t capacity = 0;
+    for (uint32_t i = tree->nodeCount; i > 0; i--) {
+        BasicBlock *header = tree->blocks[nodeByPreorder[i - 1]];
+        bool hasBackEdge = false;
+        for (Edge *edge = header->inEdges; edge != NULL && !hasBackEdge; edge = edge->nextIn) {
+            hasBackEdge = dominates(tree, header, edge->fromBlock);
+        }
+        if (hasBackEdge) {
+            collectLoopBody(forest, tree, addLoop(forest, &capacity, header), stack, visited);
+        }
+    }
+    free(stack);
+    free(visited);
+    free(nodeByPreorder);
+    freeDominatorTree(tree);
+
+    for (uint32_t l = forest->loopCount; l > 0; l--) {
+        Loop *loop = &forest->loops[l - 1];
+        loop->depth = loop->parent == LOOP_NONE ? 1 : forest->loops[loop->parent].depth + 1;
+    }
+
+    for (BasicBlock *block = cfg->blocks; block != NULL; block = block->next) {
+        int32_t owner = forest->loopById[block->id];
+        for (int32_t l = owner; l != LOOP_NONE; l = forest->loops[l].parent) {
+            forest->loops[l].blockCount++;
+        }
+        if (owner == LOOP_NONE) {
+            continue;
+        }
+        for (Edge *edge = block->outEdges; edge != NULL; edge = edge->nextOut) {
+            // a target inside some loop is inside all loops enclosing it
+            for (int32_t l = owner; l != LOOP_NONE && !isInLoop(forest, l, edge->targetBlock); l = forest->loops[l].parent) {
+                addLoopExit(&forest->loops[l], edge->targetBlock);
+            }
+        }
+    }
+    return forest;
+}
+
+int32_t getBlockLoop(LoopForest *forest, BasicBlock *block) {
+    if (forest == NULL || block == NULL || block->id < 0 || block->id >= forest->idCount) {
+        return LOOP_NONE;
+    }
+    return forest->loopById[block->id];
+}
+
+BasicBlock* getLoopHeader(LoopForest *forest, BasicBlock *block) {
+    int32_t loop = getBlockLoop(forest, block);
+    return loop == LOOP_NONE ? NULL : forest->loops[loop].header;
+}
+
+uint32_t getLoopDepth(LoopForest *forest, BasicBlock *block) {
+    int32_t loop = getBlockLoop(forest, block);
+    return loop == LOOP_NONE ? 0 : forest->loops[loop].depth;
+}
+
+bool isLoopHeader(LoopForest *forest, BasicBlock *block) {
+    return block != NULL && getLoopHeader(forest, block) == block;
+}
+
+bool isInLoop(LoopForest *forest, int32_t loop, BasicBlock *block) {
+    for (int32_t l = getBlockLoop(forest, block); l != LOOP_NONE; l = forest->loops[l].parent) {
+        if (l == loop) {
+            return true;
+        }
+    }
+    return false;
+}
+
+BasicBlock** getLoopExits(LoopForest *forest, BasicBlock *block, uint32_t *exitCount) {
+    int32_t loop = getBlockLoop(forest, block);
+    if (loop == LOOP_NONE) {
+        *exitCount = 0;
+        return NULL;
+    }
+    *exitCount = forest->loops[loop].exitCount;
+    return forest->loops[loop].exits;
+}
+
+void printLoopForest(LoopForest *forest) {
+    printf("Loops:\n");
+    for (uint32_t l = 0; l < forest->loopCount; l++) {
+        Loop *loop = &forest->loops[l];
+        printf("  BB%d depth %u, %u blocks", loop->header->id, loop->depth, loop->blockCount);
+        if (loop->parent != LOOP_NONE) {
+            printf(", inside BB%d", forest->loops[loop->parent].header->id);
+        }
+        printf(", exits:");
+        for (uint32_t i = 0; i < loop->exitCount; i++) {
+            printf(" BB%d", loop->exits[i]->id);
+        }
+        printf("\n");
+    }
+    printf("\n");
+}
+
+void freeLoopForest(LoopForest *forest) {
+    if (forest == NULL) {
+        return;
+    }
+    for (uint32_t l = 0; l < forest->loopCount; l++) {
+        free(forest->loops[l].exits);
+    }
+    free(forest->loops);
+    free(forest->loopById);
+    free(forest);
+}
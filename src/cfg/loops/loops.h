@@ -0,0 +1,45 @@
+#pragma once
+
+#include "cfg/cfg.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define LOOP_NONE -1
+
+typedef struct Loop {
+    BasicBlock *header;
+    int32_t parent;            // enclosing loop index, LOOP_NONE for outermost loops
+    uint32_t depth;            // 1 for outermost loops
+    uint32_t blockCount;       // blocks of the loop including nested loops
+    BasicBlock **exits;        // blocks outside of the loop reached by an edge from inside
+    uint32_t exitCount;
+    uint32_t exitCapacity;
+} Loop;
+
+// Natural loops found from back edges of the dominator tree. Loops are stored
+// inner first, so an enclosing loop always has a bigger index than its children.
+typedef struct LoopForest {
+    uint32_t loopCount;
+    Loop *loops;
+    int idCount;
+    int32_t *loopById;         // block id -> innermost loop index, LOOP_NONE outside of loops
+} LoopForest;
+
+LoopForest* buildLoopForest(CFG *cfg);
+
+int32_t getBlockLoop(LoopForest *forest, BasicBlock *block);
+
+BasicBlock* getLoopHeader(LoopForest *forest, BasicBlock *block);
+
+uint32_t getLoopDepth(LoopForest *forest, BasicBlock *block);
+
+bool isLoopHeader(LoopForest *forest, BasicBlock *block);
+
+bool isInLoop(LoopForest *forest, int32_t loop, BasicBlock *block);
+
+// exits of the innermost loop containing the block
+BasicBlock** getLoopExits(LoopForest *forest, BasicBlock *block, uint32_t *exitCount);
+
+void printLoopForest(LoopForest *forest);
+
+void freeLoopForest(LoopForest *forest);
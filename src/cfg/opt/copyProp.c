@@ -0,0 +1,178 @@
+#include "copyProp.h"
+#include "cfg/dataflow/reachingDefs.h"
+#include "cfg/symbols/symbols.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define NO_COPY -1
+
+// Copies are identified by their reaching definition ids, so both problems share one bit numbering
+typedef struct CopyTable {
+    int32_t *sourceByDefinition;   // definition id -> copied variable, NO_COPY for other definitions
+    uint32_t *sourceOffsets;       // copies reading variable v are copies[sourceOffsets[v] .. sourceOffsets[v + 1])
+    uint32_t *copies;
+} CopyTable;
+
+static int32_t getCopySource(FunctionAccesses *accesses, VarAccess *access) {
+    if (access->kind != ACCESS_DEF) {
+        return NO_COPY;
+    }
+    OperationTreeNode *rhs = access->node->children[1];
+    if (rhs == NULL || strcmp(rhs->label, READ) != 0) {
+        return NO_COPY;
+    }
+    int32_t source = findLeafVariable(accesses->variables, rhs->children[0]);
+    return source == (int32_t)access->variable ? NO_COPY : source;
+}
+
+static void buildCopyTable(ReachingDefinitions *definitions, CopyTable *table) {
+    FunctionAccesses *accesses = definitions->accesses;
+    uint32_t variableCount = accesses->variables->count;
+    table->sourceByDefinition = (int32_t *)malloc(sizeof(int32_t) * (definitions->definitionCount + 1));
+    table->sourceOffsets = (uint32_t *)calloc(variableCount + 1, sizeof(uint32_t));
+    for (uint32_t d = 0; d < definitions->definitionCount; d++) {
+        Definition *definition = &definitions->definitions[d];
+        int32_t source = getCopySource(accesses, &accesses->blocks[definition->block].accesses[definition->access]);
+        table->sourceByDefinition[d] = source;
+        if (source != NO_COPY) {
+            table->sourceOffsets[source + 1]++;
+        }
+    }
+    for (uint32_t v = 0; v < variableCount; v++) {
+        table->sourceOffsets[v + 1] += table->sourceOffsets[v];
+    }
+    table->copies = (uint32_t *)malloc(sizeof(uint32_t) * (table->sourceOffsets[variableCount] + 1));
+    uint32_t *fill = (uint32_t *)malloc(sizeof(uint32_t) * (variableCount + 1));
+    memcpy(fill, table->sourceOffsets, sizeof(uint32_t) * (variableCount + 1));
+    for (uint32_t d = 0; d < definitions->definitionCount; d++) {
+        if (table->sourceByDefinition[d] != NO_COPY) {
+            table->copies[fill[table->sourceByDefinition[d]]++] = d;
+        }
+    }
+    free(fill);
+}
+
+static void freeCopyTable(CopyTable *table) {
+    free(table->sourceByDefinition);
+    free(table->sourceOffsets);
+    free(table->copies);
+}
+
+// Any write to a variable ends the copies into it and the copies out of it,
+// calls and array element writes included since they may change it as well
+static void applyCopyAccess(ReachingDefinitions *definitions, CopyTable *table, uint64_t *available, uint64_t *kill, uint32_t block, uint32_t access) {
+    VarAccess *varAccess = &definitions->accesses->blocks[block].accesses[access];
+    if (varAccess->kind == ACCESS_USE) {
+        return;
+    }
+    uint32_t variable = varAccess->variable;
+    for (uint32_t i = definitions->variableDefOffsets[variable]; i < definitions->variableDefOffsets[variable + 1]; i++) {
+        clearBit(available, definitions->variableDefs[i]);
+        if (kill != NULL) {
+            setBit(kill, definitions->variableDefs[i]);
+        }
+    }
+    for (uint32_t i = table->sourceOffsets[variable]; i < table->sourceOffsets[variable + 1]; i++) {
+        clearBit(available, table->copies[i]);
+        if (kill != NULL) {
+            setBit(kill, table->copies[i]);
+        }
+    }
+    int32_t definition = definitions->definitionByAccess[block][access];
+    if (table->sourceByDefinition[definition] != NO_COPY) {
+        setBit(available, definition);
+    }
+}
+
+// forward must problem: a copy is available where it happened on every path and nothing overwrote it since
+static DataflowResult* computeAvailableCopies(ReachingDefinitions *definitions, CopyTable *table) {
+    BlockOrder *order = definitions->accesses->order;
+    DataflowResult *result = createDataflowResult(order->blockCount, definitions->definitionCount, DATAFLOW_FORWARD, DATAFLOW_INTERSECTION);
+    for (uint32_t b = 0; b < order->blockCount; b++) {
+        uint64_t *gen = getDataflowRow(result, result->gen, b);
+        uint64_t *kill = getDataflowRow(result, result->kill, b);
+        for (uint32_t i = 0; i < definitions->accesses->blocks[b].count; i++) {
+            applyCopyAccess(definitions, table, gen, kill, b, i);
+        }
+    }
+    solveDataflow(result, order, NULL);
+    return result;
+}
+
+// the copy that is the only definition of the variable reaching the point, -1 if there is none
+static int32_t getSingleReachingCopy(ReachingDefinitions *definitions, CopyTable *table, uint64_t *reaching, uint32_t variable) {
+    int32_t single = -1;
+    for (uint32_t i = definitions->variableDefOffsets[variable]; i < definitions->variableDefOffsets[variable + 1]; i++) {
+        uint32_t definition = definitions->variableDefs[i];
+        if (!testBit(reaching, definition)) {
+            continue;
+        }
+        if (single != -1) {
+            return -1;
+        }
+        single = definition;
+    }
+    return single != -1 && table->sourceByDefinition[single] != NO_COPY ? single : -1;
+}
+
+static uint32_t propagateCopiesOnce(CFG *cfg) {
+    FunctionAccesses *accesses = collectFunctionAccesses(cfg);
+    ReachingDefinitions *definitions = computeReachingDefinitions(accesses);
+    CopyTable table;
+    buildCopyTable(definitions, &table);
+    DataflowResult *available = computeAvailableCopies(definitions, &table);
+    uint32_t words = available->wordCount;
+    uint64_t *reachingSet = (uint64_t *)malloc(sizeof(uint64_t) * (words + 1));
+    uint64_t *availableSet = (uint64_t *)malloc(sizeof(uint64_t) * (words + 1));
+
+    uint32_t rewrittenCount = 0;
+    for (uint32_t b = 0; b < accesses->order->blockCount; b++) {
+        copyBitSet(reachingSet, getDataflowRow(definitions->result, definitions->result->in, b), words);
+        copyBitSet(availableSet, getDataflowRow(available, available->in, b), words);
+        BasicBlock *block = accesses->order->blocks[b];
+        BlockAccesses *blockAccesses = &accesses->blocks[b];
+        for (uint32_t i = 0; i < blockAccesses->count; i++) {
+            VarAccess *access = &blockAccesses->accesses[i];
+            if (access->kind == ACCESS_USE && strcmp(access->node->label, READ) == 0) {
+                int32_t copy = getSingleReachingCopy(definitions, &table, reachingSet, access->variable);
+                if (copy != -1 && testBit(availableSet, copy)) {
+                    // the source's scope may have closed before the use
+                    int32_t source = table.sourceByDefinition[copy];
+                    const char *name = accesses->variables->names[source];
+                    int32_t symbol = accesses->variables->symbols[source];
+                    if (isSymbolVisible(cfg->symbols, name, symbol, block->instructions[access->instruction].scope)) {
+                        OperationTreeNode *leaf = access->node->children[0];
+                        free((void *)leaf->label);
+                        leaf->label = strdup(name);
+                        leaf->symbol = symbol;
+                        rewrittenCount++;
+                    }
+                }
+            }
+            applyReachingAccess(definitions, reachingSet, b, i);
+            applyCopyAccess(definitions, &table, availableSet, NULL, b, i);
+        }
+    }
+
+    free(reachingSet);
+    free(availableSet);
+    freeDataflowResult(available);
+    freeCopyTable(&table);
+    freeReachingDefinitions(definitions);
+    freeFunctionAccesses(accesses);
+    return rewrittenCount;
+}
+
+uint32_t propagateCopies(CFG *cfg) {
+    if (cfg == NULL || cfg->entryBlock == NULL) {
+        return 0;
+    }
+    // a rewritten read may now see an older copy, so passes repeat until nothing changes
+    uint32_t rewrittenCount = 0;
+    uint32_t rewritten = propagateCopiesOnce(cfg);
+    while (rewritten > 0) {
+        rewrittenCount += rewritten;
+        rewritten = propagateCopiesOnce(cfg);
+    }
+    return rewrittenCount;
+}
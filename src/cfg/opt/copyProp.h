@@ -0,0 +1,9 @@
+#pragma once
+
+#include "cfg/cfg.h"
+#include <stdint.h>
+
+// Replaces reads of a with b after a copy a = b when that copy is the only
+// definition of a reaching the read and neither variable is written on any
+// path in between. Returns the number of rewritten reads.
+uint32_t propagateCopies(CFG *cfg);
@@ -0,0 +1,148 @@
+#include "dse.h"
+#include "cfg/dataflow/liveness.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t countInstructions(CFG *cfg) {
+    uint32_t count = 0;
+    for (BasicBlock *block = cfg->blocks; block != NULL; block = block->next) {
+        count += block->instructionCount;
+    }
+    return count;
+}
+
+static bool containsCall(OperationTreeNode *node) {
+    if (node == NULL) {
+        return false;
+    }
+    if (strcmp(node->label, OT_CALL) == 0) {
+        return true;
+    }
+    for (uint32_t i = 0; i < node->childCount; i++) {
+        if (containsCall(node->children[i])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void removeInstruction(BasicBlock *block, int instruction) {
+    destroyOperationTreeNodeTree(block->instructions[instruction].otRoot);
+    block->instructionCount--;
+    memmove(&block->instructions[instruction], &block->instructions[instruction + 1],
+            sizeof(Instruction) * (block->instructionCount - instruction));
+}
+
+typedef enum {
+    STORE_KEPT,
+    STORE_REDUCED,             // the instruction stays without the assignment, its uses included
+    STORE_REMOVED              // the instruction is gone together with its uses
+} StoreAction;
+
+static bool isBranchCondition(BasicBlock *block, int instruction) {
+    if (instruction != block->instructionCount - 1) {
+        return false;
+    }
+    for (Edge *edge = block->outEdges; edge != NULL; edge = edge->nextOut) {
+        if (edge->type != UNCONDITIONAL_JUMP) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static StoreAction eliminateStore(BasicBlock *block, int instruction, OperationTreeNode *write, DeadStoreStats *stats) {
+    Instruction *target = &block->instructions[instruction];
+    if (containsCall(write->children[1])) {
+        if (target->otRoot != write) {
+            // dropping the initializer would need a new instruction for the call
+            stats->flaggedCount++;
+            return STORE_KEPT;
+        }
+        target->otRoot = write->children[1];
+        write->children[1] = NULL;
+        destroyOperationTreeNodeTree(write);
+        stats->keptCallCount++;
+        return STORE_REDUCED;
+    }
+    stats->removedCount++;
+    if (target->otRoot != write) {
+        // the declaration stays, only its initializer goes
+        destroyOperationTreeNodeTree(write);
+        target->otRoot->childCount = 2;
+        return STORE_REMOVED;
+    }
+    removeInstruction(block, instruction);
+    return STORE_REMOVED;
+}
+
+// Walks the block backwards from its live out set, the accesses of an instruction in reverse order
+static bool eliminateBlockStores(BasicBlock *block, BlockAccesses *accesses, uint64_t *live, DeadStoreStats *stats) {
+    bool changed = false;
+    uint32_t end = accesses->count;
+    for (int i = block->instructionCount - 1; i >= 0; i--) {
+        uint32_t start = end;
+        while (start > 0 && accesses->accesses[start - 1].instruction == (uint32_t)i) {
+            start--;
+        }
+        OperationTreeNode *write = block->instructions[i].otRoot;
+        if (write != NULL && strcmp(write->label, DECLARE) == 0 && write->childCount == 3) {
+            write = write->children[2];
+        }
+        // the value of a condition decides the branch, so it is never dead
+        bool isCondition = isBranchCondition(block, i);
+        StoreAction action = STORE_KEPT;
+        for (uint32_t a = end; a > start && action != STORE_REMOVED; a--) {
+            VarAccess *access = &accesses->accesses[a - 1];
+            if (readsVariableValue(access->kind)) {
+                setBit(live, access->variable);
+            } else if (isFullDefinition(access->kind)) {
+                if (access->kind == ACCESS_DEF && access->node == write && !isCondition && !testBit(live, access->variable)) {
+                    action = eliminateStore(block, i, write, stats);
+                    changed = changed || action != STORE_KEPT;
+                }
+                clearBit(live, access->variable);
+            }
+        }
+        end = start;
+    }
+    return changed;
+}
+
+void eliminateDeadStores(CFG *cfg, DeadStoreStats *stats) {
+    memset(stats, 0, sizeof(DeadStoreStats));
+    if (cfg == NULL) {
+        return;
+    }
+    stats->instructionsBefore = countInstructions(cfg);
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        // kept stores are met again by every pass, only the last one counts them
+        stats->flaggedCount = 0;
+        FunctionAccesses *accesses = collectFunctionAccesses(cfg);
+        DataflowResult *liveness = computeLiveness(accesses);
+        uint64_t *live = (uint64_t *)malloc(sizeof(uint64_t) * (liveness->wordCount + 1));
+        for (uint32_t b = 0; b < accesses->order->blockCount; b++) {
+            copyBitSet(live, getDataflowRow(liveness, liveness->out, b), liveness->wordCount);
+            if (eliminateBlockStores(accesses->order->blocks[b], &accesses->blocks[b], live, stats)) {
+                changed = true;
+            }
+        }
+        free(live);
+        freeDataflowResult(liveness);
+        freeFunctionAccesses(accesses);
+    }
+    stats->instructionsAfter = countInstructions(cfg);
+    if (stats->instructionsAfter != stats->instructionsBefore) {
+        cfg->callSites->stale = true;
+    }
+}
+
+void printDeadStoreStats(const char *functionName, DeadStoreStats *stats) {
+    printf("Dead stores of function %s: %u instructions before, %u after", functionName,
+           stats->instructionsBefore, stats->instructionsAfter);
+    printf(", %u removed, %u reduced to calls, %u kept for calls\n",
+           stats->removedCount, stats->keptCallCount, stats->flaggedCount);
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "cfg/cfg.h"
+#include <stdint.h>
+
+typedef struct DeadStoreStats {
+    uint32_t instructionsBefore;
+    uint32_t instructionsAfter;
+    uint32_t removedCount;     // dead assignments dropped completely
+    uint32_t keptCallCount;    // dead assignments reduced to the call on their right side
+    uint32_t flaggedCount;     // dead initializations left in place because of a call
+} DeadStoreStats;
+
+// Removes assignments to variables that are not live afterwards. Liveness is
+// recomputed until nothing changes, so chains of dead copies go away as well.
+void eliminateDeadStores(CFG *cfg, DeadStoreStats *stats);
+
+void printDeadStoreStats(const char *functionName, DeadStoreStats *stats);
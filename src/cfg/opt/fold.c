@@ -0,0 +1,236 @@
+#include "fold.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t getConstantRank(ConstantKind kind) {
+    switch (kind) {
+        case CONST_UINT:
+            return 1;
+        case CONST_LONG:
+            return 2;
+        case CONST_ULONG:
+            return 3;
+        default:
+            return 0;
+    }
+}
+
+static bool isSignedConstant(ConstantKind kind) {
+    return kind == CONST_INT || kind == CONST_LONG || kind == CONST_BOOL;
+}
+
+// wraps the value to the width of its kind
+static uint64_t normalizeConstant(ConstantKind kind, uint64_t bits) {
+    switch (kind) {
+        case CONST_INT:
+            return (uint64_t)(int64_t)(int32_t)(uint32_t)bits;
+        case CONST_UINT:
+            return bits & UINT32_MAX;
+        case CONST_BOOL:
+            return bits != 0;
+        default:
+            return bits;
+    }
+}
+
+bool getLiteralConstant(OperationTreeNode *node, ConstantValue *value) {
+    if (node == NULL || strcmp(node->label, LIT_READ) != 0) {
+        return false;
+    }
+    LiteralValue *literal = &node->literal;
+    if (literal->kind == LITERAL_BOOL) {
+        value->kind = CONST_BOOL;
+        value->bits = literal->boolean;
+        return true;
+    }
+    if (literal->kind != LITERAL_INTEGER) {
+        return false;
+    }
+    if (literal->width == 32) {
+        value->kind = literal->isSigned ? CONST_INT : CONST_UINT;
+    } else {
+        value->kind = literal->isSigned ? CONST_LONG : CONST_ULONG;
+    }
+    value->bits = literal->integer;
+    return true;
+}
+
+bool convertConstant(ConstantValue *value, const char *typeName, bool custom) {
+    ConstantKind kind;
+    if (custom) {
+        return false;
+    } else if (strcmp(typeName, "int") == 0) {
+        kind = CONST_INT;
+    } else if (strcmp(typeName, "uint") == 0) {
+        kind = CONST_UINT;
+    } else if (strcmp(typeName, "long") == 0) {
+        kind = CONST_LONG;
+    } else if (strcmp(typeName, "ulong") == 0) {
+        kind = CONST_ULONG;
+    } else if (strcmp(typeName, "bool") == 0) {
+        kind = CONST_BOOL;
+    } else {
+        return false;
+    }
+    value->kind = kind;
+    value->bits = normalizeConstant(kind, value->bits);
+    return true;
+}
+
+bool evaluateUnaryConstant(const char *op, ConstantValue *operand, ConstantValue *result) {
+    if (strcmp(op, NOT) == 0) {
+        result->kind = CONST_BOOL;
+        result->bits = operand->bits == 0;
+        return true;
+    }
+    if (strcmp(op, NEG) == 0) {
+        result->kind = operand->kind == CONST_BOOL ? CONST_INT : operand->kind;
+        result->bits = normalizeConstant(result->kind, (uint64_t)0 - operand->bits);
+        return true;
+    }
+    return false;
+}
+
+bool evaluateBinaryConstant(const char *op, ConstantValue *left, ConstantValue *right, ConstantValue *result, bool *divisionByZero) {
+    *divisionByZero = false;
+    // usual arithmetic conversions, bool takes part as int
+    ConstantKind kind = getConstantRank(left->kind) >= getConstantRank(right->kind) ? left->kind : right->kind;
+    if (kind == CONST_BOOL) {
+        kind = CONST_INT;
+    }
+    uint64_t a = normalizeConstant(kind, left->bits);
+    uint64_t b = normalizeConstant(kind, right->bits);
+    uint64_t bits;
+
+    if (strcmp(op, PLUS) == 0) {
+        bits = a + b;
+    } else if (strcmp(op, MINUS) == 0) {
+        bits = a - b;
+    } else if (strcmp(op, MUL) == 0) {
+        bits = a * b;
+    } else if (strcmp(op, DIV) == 0 || strcmp(op, MOD) == 0) {
+        if (b == 0) {
+            *divisionByZero = true;
+            return false;
+        }
+        bool isDiv = strcmp(op, DIV) == 0;
+        if (!isSignedConstant(kind)) {
+            bits = isDiv ? a / b : a % b;
+        } else if ((int64_t)a == INT64_MIN && (int64_t)b == -1) {
+            // overflows in 64 bits, wraps to the minimum like the 32 bit case below
+            bits = isDiv ? a : 0;
+        } else {
+            bits = (uint64_t)(isDiv ? (int64_t)a / (int64_t)b : (int64_t)a % (int64_t)b);
+        }
+    } else if (strcmp(op, OT_SHL) == 0 || strcmp(op, OT_SHR) == 0) {
+        // the left operand alone decides the type, the count is taken modulo the width
+        kind = left->kind == CONST_BOOL ? CONST_INT : left->kind;
+        a = normalizeConstant(kind, left->bits);
+        uint32_t width = kind == CONST_INT || kind == CONST_UINT ? 32 : 64;
+        uint32_t count = (uint32_t)(right->bits & (width - 1));
+        if (strcmp(op, OT_SHL) == 0) {
+            bits = a << count;
+        } else if (isSignedConstant(kind)) {
+            bits = (uint64_t)((int64_t)a >> count);
+        } else {
+            bits = a >> count;
+        }
+    } else if (strcmp(op, OT_AND) == 0) {
+        bits = a & b;
+    } else {
+        return false;
+    }
+
+    result->kind = kind;
+    result->bits = normalizeConstant(kind, bits);
+    return true;
+}
+
+OperationTreeNode* newConstantOperationTreeNode(ConstantValue *value, uint32_t line, uint32_t pos) {
+    char text[32];
+    const char *type = DEC;
+    if (value->kind == CONST_BOOL) {
+        type = BOOL;
+        snprintf(text, sizeof(text), "%s", value->bits ? "true" : "false");
+    } else if (isSignedConstant(value->kind)) {
+        snprintf(text, sizeof(text), "%" PRId64, (int64_t)value->bits);
+    } else {
+        snprintf(text, sizeof(text), "%" PRIu64, value->bits);
+    }
+    OperationTreeNode *litReadNode = newOperationTreeNode(LIT_READ, 2, line, pos, true);
+    litReadNode->children[0] = newOperationTreeNode(type, 0, line, pos, true);
+    litReadNode->children[1] = newOperationTreeNode(text, 0, line, pos, true);
+    if (value->kind == CONST_BOOL) {
+        litReadNode->literal.kind = LITERAL_BOOL;
+        litReadNode->literal.boolean = value->bits != 0;
+    } else {
+        litReadNode->literal.kind = LITERAL_INTEGER;
+        litReadNode->literal.width = value->kind == CONST_INT || value->kind == CONST_UINT ? 32 : 64;
+        litReadNode->literal.isSigned = isSignedConstant(value->kind);
+        litReadNode->literal.integer = value->bits;
+    }
+    return litReadNode;
+}
+
+// Folds bottom-up, so a whole constant subtree collapses into one literal.
+// Returns the node to put in place of the given one.
+OperationTreeNode* foldOperationTree(OperationTreeNode *node, Program *program, const char *fileName, uint32_t *foldedCount) {
+    if (node == NULL || strcmp(node->label, LIT_READ) == 0) {
+        return node;
+    }
+    for (uint32_t i = 0; i < node->childCount; i++) {
+        node->children[i] = foldOperationTree(node->children[i], program, fileName, foldedCount);
+    }
+
+    ConstantValue result;
+    if (isUnaryOp(node->label) && node->childCount == 1) {
+        ConstantValue operand;
+        if (!getLiteralConstant(node->children[0], &operand) || !evaluateUnaryConstant(node->label, &operand, &result)) {
+            return node;
+        }
+    } else if (isBinaryOp(node->label) && node->childCount == 2) {
+        ConstantValue left;
+        ConstantValue right;
+        bool divisionByZero;
+        if (!getLiteralConstant(node->children[0], &left) || !getLiteralConstant(node->children[1], &right)) {
+            return node;
+        }
+        if (!evaluateBinaryConstant(node->label, &left, &right, &result, &divisionByZero)) {
+            if (divisionByZero) {
+                char buffer[1024];
+                snprintf(buffer, sizeof(buffer),
+                         "Division by zero warning. Constant expression divides by zero at %s:%d:%d",
+                         fileName, node->line, node->pos + 1);
+                addProgramWarning(program, createProgramWarningInfo(buffer));
+            }
+            return node;
+        }
+    } else {
+        return node;
+    }
+
+    OperationTreeNode *folded = newConstantOperationTreeNode(&result, node->line, node->pos);
+    destroyOperationTreeNodeTree(node);
+    (*foldedCount)++;
+    return folded;
+}
+
+uint32_t foldProgramConstants(Program *program) {
+    uint32_t foldedCount = 0;
+    FunctionInfo *func = program->functions;
+    while (func != NULL) {
+        if (func->cfg != NULL) {
+            BasicBlock *block = func->cfg->blocks;
+            while (block != NULL) {
+                for (int i = 0; i < block->instructionCount; i++) {
+                    block->instructions[i].otRoot = foldOperationTree(block->instructions[i].otRoot, program, func->fileName, &foldedCount);
+                }
+                block = block->next;
+            }
+        }
+        func = func->next;
+    }
+    return foldedCount;
+}
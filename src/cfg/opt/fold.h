@@ -0,0 +1,34 @@
+#pragma once
+
+#include "cfg/cfg.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum {
+    CONST_INT,                 // 32 bit signed
+    CONST_UINT,                // 32 bit unsigned
+    CONST_LONG,                // 64 bit signed
+    CONST_ULONG,               // 64 bit unsigned
+    CONST_BOOL
+} ConstantKind;
+
+typedef struct ConstantValue {
+    ConstantKind kind;
+    uint64_t bits;             // sign extended for signed kinds
+} ConstantValue;
+
+bool getLiteralConstant(OperationTreeNode *node, ConstantValue *value);
+
+// converts the value to the kind of a built-in integer or bool type, false for other types
+bool convertConstant(ConstantValue *value, const char *typeName, bool custom);
+
+bool evaluateUnaryConstant(const char *op, ConstantValue *operand, ConstantValue *result);
+
+// false if the operation can't be folded, divisionByZero is set for a constant zero divisor
+bool evaluateBinaryConstant(const char *op, ConstantValue *left, ConstantValue *right, ConstantValue *result, bool *divisionByZero);
+
+OperationTreeNode* newConstantOperationTreeNode(ConstantValue *value, uint32_t line, uint32_t pos);
+
+OperationTreeNode* foldOperationTree(OperationTreeNode *node, Program *program, const char *fileName, uint32_t *foldedCount);
+
+uint32_t foldProgramConstants(Program *program);
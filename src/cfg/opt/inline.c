@@ -0,0 +1,364 @@
+#include "inline.h"
+#include "cfg/cg/scc.h"
+#include "cfg/loops/loops.h"
+#include "cfg/symbols/symbols.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct InlineContext {
+    Program *program;
+    CallGraph *cg;
+    bool *recursive;           // indexed by call graph node
+    uint32_t siteCount;        // inlined calls of the current caller, used in renamed locals
+} InlineContext;
+
+static FunctionInfo* findFunctionInfo(Program *program, const char *name) {
+    for (FunctionInfo *func = program->functions; func != NULL; func = func->next) {
+        if (strcmp(func->functionName, name) == 0) {
+            return func;
+        }
+    }
+    return NULL;
+}
+
+static uint32_t countInstructions(CFG *cfg) {
+    uint32_t count = 0;
+    for (BasicBlock *block = cfg->blocks; block != NULL; block = block->next) {
+        count += block->instructionCount;
+    }
+    return count;
+}
+
+static uint32_t countArguments(FunctionInfo *func) {
+    uint32_t count = 0;
+    for (ArgumentInfo *arg = func->arguments; arg != NULL; arg = arg->next) {
+        count++;
+    }
+    return count;
+}
+
+static bool isInlinableCall(OperationTreeNode *node) {
+    return node != NULL && strcmp(node->label, OT_CALL) == 0 && node->children[0]->childCount == 0;
+}
+
+// the slot holding a call that can be replaced by a read of its result, NULL if there is none
+static OperationTreeNode** findInlineSite(BasicBlock *block, int instruction, bool *valueUsed) {
+    OperationTreeNode **root = &block->instructions[instruction].otRoot;
+    *valueUsed = true;
+    if (*root == NULL) {
+        return NULL;
+    }
+    if (isInlinableCall(*root)) {
+        *valueUsed = isConditionBlock(block) && instruction == block->instructionCount - 1;
+        return root;
+    }
+    OperationTreeNode *node = *root;
+    if (strcmp(node->label, RETURN) == 0 && node->childCount == 1 && isInlinableCall(node->children[0])) {
+        return &node->children[0];
+    }
+    if (strcmp(node->label, DECLARE) == 0 && node->childCount == 3) {
+        node = node->children[2];
+    }
+    if (strcmp(node->label, WRITE) == 0 && node->children[0]->childCount == 0 && isInlinableCall(node->children[1])) {
+        return &node->children[1];
+    }
+    return NULL;
+}
+
+static FunctionInfo* getInlineCallee(InlineContext *ctx, OperationTreeNode *call, bool valueUsed) {
+    const char *name = call->children[0]->label;
+    int32_t node = findFunction(ctx->cg, name);
+    if (node == CG_NO_NODE || ctx->recursive[node]) {
+        return NULL;
+    }
+    FunctionInfo *callee = findFunctionInfo(ctx->program, name);
+    if (callee == NULL || callee->cfg == NULL || countArguments(callee) != call->childCount - 1) {
+        return NULL;
+    }
+    if (valueUsed && callee->returnType == ctx->program->types->voidType) {
+        return NULL;
+    }
+    if (countInstructions(callee->cfg) > INLINE_SIZE_LIMIT) {
+        return NULL;
+    }
+    return callee;
+}
+
+static OperationTreeNode* newNameLeaf(const char *prefix, const char *name, OperationTreeNode *origin) {
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer), "%s.%s", prefix, name);
+    return newOperationTreeNode(buffer, 0, origin->line, origin->pos, true);
+}
+
+// the callee's declarations are appended to the caller's table, offset apart
+static void renameLeaf(OperationTreeNode *leaf, const char *prefix, uint32_t offset) {
+    OperationTreeNode *renamed = newNameLeaf(prefix, leaf->label, leaf);
+    free((void *)leaf->label);
+    leaf->label = renamed->label;
+    free(renamed->children);
+    free(renamed);
+    if (leaf->symbol != -1) {
+        leaf->symbol += offset;
+    }
+}
+
+static void renameLocals(OperationTreeNode *node, const char *prefix, uint32_t offset) {
+    if (node == NULL || strcmp(node->label, LIT_READ) == 0 || strcmp(node->label, WITH_TYPE) == 0) {
+        return;
+    }
+    uint32_t first = 0;
+    if (strcmp(node->label, DECLARE) == 0) {
+        renameLeaf(node->children[1], prefix, offset);
+        first = 2;
+    } else if (strcmp(node->label, READ) == 0 || strcmp(node->label, WRITE) == 0 || strcmp(node->label, INDEX) == 0) {
+        if (node->children[0]->childCount == 0) {
+            renameLeaf(node->children[0], prefix, offset);
+            first = 1;
+        }
+    } else if (strcmp(node->label, OT_CALL) == 0) {
+        first = 1;
+    }
+    for (uint32_t i = first; i < node->childCount; i++) {
+        renameLocals(node->children[i], prefix, offset);
+    }
+}
+
+// the callee's outermost scope becomes the scope of the call
+static int32_t getInlinedScope(int32_t scope, int32_t callScope, uint32_t scopeBase) {
+    if (scope == -1) {
+        return -1;
+    }
+    return scope == 0 ? callScope : scope - 1 + (int32_t)scopeBase;
+}
+
+static OperationTreeNode* newDeclaration(uint32_t type, OperationTreeNode *name, OperationTreeNode *value) {
+    OperationTreeNode *declare = newOperationTreeNode(DECLARE, value != NULL ? 3 : 2, name->line, name->pos, true);
+    declare->children[0] = newWithTypeNode(type, name->line, name->pos);
+    declare->children[1] = name;
+    if (value != NULL) {
+        declare->children[2] = newOperationTreeNode(WRITE, 2, name->line, name->pos, true);
+        declare->children[2]->children[0] = cloneOperationTree(name);
+        declare->children[2]->children[1] = value;
+    }
+    return declare;
+}
+
+// the callee's return becomes an assignment of the result, or just the expression if nobody reads it
+static void bindReturnValue(Instruction *instruction, OperationTreeNode *result) {
+    OperationTreeNode *ret = instruction->otRoot;
+    if (ret == NULL || strcmp(ret->label, RETURN) != 0) {
+        return;
+    }
+    OperationTreeNode *value = ret->children[0];
+    ret->children[0] = NULL;
+    destroyOperationTreeNodeTree(ret);
+    if (result == NULL) {
+        instruction->otRoot = value;
+        return;
+    }
+    OperationTreeNode *write = newOperationTreeNode(WRITE, 2, value->line, value->pos, true);
+    write->children[0] = cloneOperationTree(result);
+    write->children[1] = value;
+    instruction->otRoot = write;
+    instruction->text = ASSIGN;
+}
+
+static void inlineCall(InlineContext *ctx, CFG *cfg, BasicBlock *block, int instruction, OperationTreeNode **slot, bool valueUsed, FunctionInfo *callee) {
+    char prefix[128];
+    snprintf(prefix, sizeof(prefix), "%s.%u", callee->functionName, ++ctx->siteCount);
+    OperationTreeNode *call = *slot;
+    int32_t callScope = block->instructions[instruction].scope;
+    uint32_t scopeBase;
+    uint32_t offset = appendSymbolTable(cfg->symbols, callee->cfg->symbols, prefix, callScope, &scopeBase);
+    OperationTreeNode *result = valueUsed ? newNameLeaf(prefix, "result", call) : NULL;
+    if (result != NULL) {
+        OperationTreeNode *read = newOperationTreeNode(READ, 1, call->line, call->pos, true);
+        read->children[0] = cloneOperationTree(result);
+        *slot = read;
+    } else {
+        *slot = NULL;
+    }
+
+    uint32_t calleeBlockCount = 0;
+    for (BasicBlock *b = callee->cfg->blocks; b != NULL; b = b->next) {
+        calleeBlockCount++;
+    }
+    int nextId = getMaxBlockId(cfg) + 1;
+    char name[256];
+    snprintf(name, sizeof(name), "After %s", callee->functionName);
+    BasicBlock *after = createBasicBlock(nextId + (int)calleeBlockCount, block->type, name);
+
+    // everything from the call on continues after the callee, a dropped call statement is left out
+    for (int i = instruction; i < block->instructionCount; i++) {
+        if (block->instructions[i].otRoot == NULL) {
+            continue;
+        }
+        addInstruction(after, block->instructions[i].text, block->instructions[i].otRoot);
+        after->instructions[after->instructionCount - 1].movedFrom = block->instructions[i].movedFrom;
+        after->instructions[after->instructionCount - 1].scope = block->instructions[i].scope;
+    }
+    block->instructionCount = instruction;
+    after->outEdges = block->outEdges;
+    for (Edge *edge = after->outEdges; edge != NULL; edge = edge->nextOut) {
+        edge->fromBlock = after;
+    }
+    after->isBreak = block->isBreak;
+    block->outEdges = NULL;
+    block->isBreak = false;
+    block->type = UNCONDITIONAL;
+
+    if (result != NULL) {
+        addInstruction(block, VAR, newDeclaration(callee->returnType, cloneOperationTree(result), NULL));
+        block->instructions[block->instructionCount - 1].scope = callScope;
+    }
+    // arguments are kept last first, the bindings evaluate them in call order
+    uint32_t argumentCount = call->childCount - 1;
+    ArgumentInfo **arguments = (ArgumentInfo **)malloc(sizeof(ArgumentInfo *) * (argumentCount + 1));
+    uint32_t argument = argumentCount;
+    for (ArgumentInfo *arg = callee->arguments; arg != NULL; arg = arg->next) {
+        arguments[--argument] = arg;
+    }
+    for (argument = 0; argument < argumentCount; argument++) {
+        OperationTreeNode *value = call->children[argument + 1];
+        call->children[argument + 1] = NULL;
+        // the renamed uses keep the callee's declaration, the binding has to match them
+        OperationTreeNode *name = newNameLeaf(prefix, arguments[argument]->name, value);
+        name->symbol = arguments[argument]->symbol != -1 ? arguments[argument]->symbol + (int32_t)offset : -1;
+        addInstruction(block, VAR, newDeclaration(arguments[argument]->type, name, value));
+        block->instructions[block->instructionCount - 1].scope = callScope;
+    }
+    free(arguments);
+    destroyOperationTreeNodeTree(call);
+
+    BasicBlock **originals = (BasicBlock **)malloc(sizeof(BasicBlock *) * calleeBlockCount);
+    BasicBlock **copies = (BasicBlock **)malloc(sizeof(BasicBlock *) * calleeBlockCount);
+    uint32_t count = 0;
+    for (BasicBlock *b = callee->cfg->blocks; b != NULL; b = b->next) {
+        snprintf(name, sizeof(name), "%s: %s", callee->functionName, b->name);
+        BasicBlock *copy = createBasicBlock(nextId++, b->type == TERMINAL ? UNCONDITIONAL : b->type, name);
+        for (int i = 0; i < b->instructionCount; i++) {
+            OperationTreeNode *root = cloneOperationTree(b->instructions[i].otRoot);
+            renameLocals(root, prefix, offset);
+            addInstruction(copy, b->instructions[i].text, root);
+            copy->instructions[i].movedFrom = b->instructions[i].movedFrom;
+            copy->instructions[i].scope = getInlinedScope(b->instructions[i].scope, callScope, scopeBase);
+            bindReturnValue(&copy->instructions[i], result);
+        }
+        copy->isEmpty = b->isEmpty;
+        originals[count] = b;
+        copies[count++] = copy;
+    }
+
+    // addEdge prepends, adding in reverse keeps the callee's edge order
+    Edge **edges = (Edge **)malloc(sizeof(Edge *) * INITIAL_CAPACITY);
+    uint32_t edgeCapacity = INITIAL_CAPACITY;
+    for (uint32_t b = 0; b < count; b++) {
+        uint32_t edgeCount = 0;
+        for (Edge *edge = originals[b]->outEdges; edge != NULL; edge = edge->nextOut) {
+            if (edgeCount == edgeCapacity) {
+                edgeCapacity *= 2;
+                edges = (Edge **)realloc(edges, sizeof(Edge *) * edgeCapacity);
+            }
+            edges[edgeCount++] = edge;
+        }
+        while (edgeCount > 0) {
+            Edge *edge = edges[--edgeCount];
+            uint32_t target = 0;
+            while (originals[target] != edge->targetBlock) {
+                target++;
+            }
+            addEdge(copies[b], copies[target], edge->type, edge->condition);
+        }
+        if (originals[b]->type == TERMINAL) {
+            addEdge(copies[b], after, UNCONDITIONAL_JUMP, NULL);
+        }
+        copies[b]->isBreak = originals[b]->isBreak;
+        if (originals[b] == callee->cfg->entryBlock) {
+            addEdge(block, copies[b], UNCONDITIONAL_JUMP, NULL);
+        }
+    }
+
+    BasicBlock *tail = block->next;
+    BasicBlock *last = block;
+    for (uint32_t b = 0; b < count; b++) {
+        last->next = copies[b];
+        last = copies[b];
+    }
+    last->next = after;
+    after->next = tail;
+
+    if (result != NULL) {
+        destroyOperationTreeNodeTree(result);
+    }
+    free(edges);
+    free(copies);
+    free(originals);
+}
+
+static uint32_t inlineIntoFunction(InlineContext *ctx, FunctionInfo *caller) {
+    CFG *cfg = caller->cfg;
+    if (cfg == NULL) {
+        return 0;
+    }
+    ctx->siteCount = 0;
+    uint32_t size = countInstructions(cfg);
+    uint32_t inlinedCount = 0;
+    for (BasicBlock *block = cfg->blocks; block != NULL && size <= INLINE_CALLER_LIMIT; block = block->next) {
+        // argument bindings added at the call position can hold the next call, so the index isn't skipped
+        for (int i = 0; i < block->instructionCount && size <= INLINE_CALLER_LIMIT; i++) {
+            bool valueUsed;
+            OperationTreeNode **slot = findInlineSite(block, i, &valueUsed);
+            if (slot == NULL) {
+                continue;
+            }
+            FunctionInfo *callee = getInlineCallee(ctx, *slot, valueUsed);
+            if (callee == NULL) {
+                continue;
+            }
+            size += countInstructions(callee->cfg) + countArguments(callee) + 1;
+            inlineCall(ctx, cfg, block, i, slot, valueUsed, callee);
+            inlinedCount++;
+            i--;
+        }
+    }
+    if (inlinedCount > 0) {
+        freeLoopForest(cfg->loops);
+        cfg->loops = buildLoopForest(cfg);
+        cfg->callSites->stale = true;
+    }
+    return inlinedCount;
+}
+
+uint32_t inlineProgramCalls(Program *program) {
+    // a CFG with errors may be incomplete
+    if (program->errors != NULL) {
+        return 0;
+    }
+    CallGraph *cg = createCallGraph();
+    traverseProgramAndBuildCallGraph(program, cg, false);
+    CallGraphSCC *scc = computeCallGraphSCC(cg);
+    InlineContext ctx;
+    ctx.program = program;
+    ctx.cg = cg;
+    uint32_t nodeCount = cg->functionCount;
+    ctx.recursive = (bool *)malloc(sizeof(bool) * (nodeCount + 1));
+    for (uint32_t n = 0; n < nodeCount; n++) {
+        ctx.recursive[n] = scc->recursive[scc->componentOf[n]];
+    }
+
+    // callees come before their callers, so what gets copied is already inlined into
+    uint32_t inlinedCount = 0;
+    for (uint32_t m = 0; m < nodeCount; m++) {
+        uint32_t node = scc->members[m];
+        FunctionInfo *caller = findFunctionInfo(program, cg->functions[node].functionName);
+        if (caller != NULL && cg->succOffsets[node] != cg->succOffsets[node + 1]) {
+            inlinedCount += inlineIntoFunction(&ctx, caller);
+        }
+    }
+
+    free(ctx.recursive);
+    freeCallGraphSCC(scc);
+    freeCallGraph(cg);
+    return inlinedCount;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "cfg/cfg.h"
+#include <stdint.h>
+
+// callees with more instructions are never inlined
+#define INLINE_SIZE_LIMIT 12
+// a caller stops receiving callees once it grows past this many instructions
+#define INLINE_CALLER_LIMIT 256
+
+// Splices small callee CFGs into their callers, walking the call graph bottom-up
+// so a callee is already inlined into when it is copied. Only calls that are a
+// whole statement, the right side of an assignment or declaration, a return value
+// or a branch condition are replaced. Callee locals are renamed to
+// <callee>.<site>.<name>, arguments are bound by declarations typed from
+// ArgumentInfo and the result goes through <callee>.<site>.result.
+// Functions on a call graph cycle are never inlined. Returns the number of
+// inlined calls.
+uint32_t inlineProgramCalls(Program *program);
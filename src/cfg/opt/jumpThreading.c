@@ -0,0 +1,281 @@
+#include "jumpThreading.h"
+#include "cfg/dataflow/access.h"
+#include "cfg/dom/dom.h"
+#include "cfg/loops/loops.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct ThreadingContext {
+    FunctionAccesses *accesses;
+    DominatorTree *tree;
+    bool *inRegion;            // indexed like accesses->order->blocks
+    uint32_t *stack;
+    int32_t variables[8];      // variables read by the condition being checked
+    uint32_t variableCount;
+} ThreadingContext;
+
+// reads, literals and operators only, so evaluating it again gives the same value
+static bool isPureCondition(OperationTreeNode *node) {
+    if (strcmp(node->label, LIT_READ) == 0) {
+        return true;
+    } else if (strcmp(node->label, READ) == 0) {
+        return node->children[0]->childCount == 0;
+    } else if ((isBinaryOp(node->label) && node->childCount == 2) || (isUnaryOp(node->label) && node->childCount == 1)) {
+        for (uint32_t i = 0; i < node->childCount; i++) {
+            if (!isPureCondition(node->children[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+static bool isSameTree(OperationTreeNode *a, OperationTreeNode *b) {
+    if (strcmp(a->label, b->label) != 0 || a->childCount != b->childCount) {
+        return false;
+    }
+    for (uint32_t i = 0; i < a->childCount; i++) {
+        if (!isSameTree(a->children[i], b->children[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static OperationTreeNode* getCondition(BasicBlock *block) {
+    if (!isConditionBlock(block) || block->instructionCount == 0) {
+        return NULL;
+    }
+    OperationTreeNode *condition = block->instructions[block->instructionCount - 1].otRoot;
+    return condition != NULL && isPureCondition(condition) ? condition : NULL;
+}
+
+// strips negations, negated tells whether an odd number of them was removed
+static OperationTreeNode* stripNegation(OperationTreeNode *node, bool *negated) {
+    *negated = false;
+    while (strcmp(node->label, NOT) == 0) {
+        *negated = !*negated;
+        node = node->children[0];
+    }
+    return node;
+}
+
+static bool collectConditionVariables(ThreadingContext *ctx, OperationTreeNode *node) {
+    if (strcmp(node->label, LIT_READ) == 0) {
+        return true;
+    } else if (strcmp(node->label, READ) == 0) {
+        int32_t variable = findLeafVariable(ctx->accesses->variables, node->children[0]);
+        if (ctx->variableCount == sizeof(ctx->variables) / sizeof(ctx->variables[0])) {
+            return false;
+        }
+        ctx->variables[ctx->variableCount++] = variable;
+        return true;
+    }
+    for (uint32_t i = 0; i < node->childCount; i++) {
+        if (!collectConditionVariables(ctx, node->children[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool isConditionVariable(ThreadingContext *ctx, uint32_t variable) {
+    for (uint32_t i = 0; i < ctx->variableCount; i++) {
+        if (ctx->variables[i] == (int32_t)variable) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// every path from the start of the region block to the branch, walked backwards from the branch
+static bool isWrittenBetween(ThreadingContext *ctx, BasicBlock *start, BasicBlock *branch) {
+    BlockOrder *order = ctx->accesses->order;
+    memset(ctx->inRegion, 0, sizeof(bool) * order->blockCount);
+    uint32_t stackSize = 0;
+    uint32_t first = (uint32_t)getBlockOrderIndex(order, branch);
+    uint32_t last = (uint32_t)getBlockOrderIndex(order, start);
+    ctx->inRegion[first] = true;
+    ctx->stack[stackSize++] = first;
+    while (stackSize > 0) {
+        uint32_t b = ctx->stack[--stackSize];
+        BlockAccesses *accesses = &ctx->accesses->blocks[b];
+        for (uint32_t i = 0; i < accesses->count; i++) {
+            if (accesses->accesses[i].kind != ACCESS_USE && isConditionVariable(ctx, accesses->accesses[i].variable)) {
+                return true;
+            }
+        }
+        if (b == last) {
+            continue;
+        }
+        for (uint32_t p = order->predOffsets[b]; p < order->predOffsets[b + 1]; p++) {
+            uint32_t pred = order->preds[p];
+            if (!ctx->inRegion[pred]) {
+                ctx->inRegion[pred] = true;
+                ctx->stack[stackSize++] = pred;
+            }
+        }
+    }
+    return false;
+}
+
+// looks for a dominating branch on the same condition whose edge into the region of the block decides it
+static bool findKnownOutcome(ThreadingContext *ctx, BasicBlock *block, OperationTreeNode *condition, bool *outcome) {
+    bool negated;
+    OperationTreeNode *core = stripNegation(condition, &negated);
+    ctx->variableCount = 0;
+    if (!collectConditionVariables(ctx, core)) {
+        return false;
+    }
+    for (BasicBlock *dominator = getImmediateDominator(ctx->tree, block); dominator != NULL;
+         dominator = getImmediateDominator(ctx->tree, dominator)) {
+        OperationTreeNode *dominatorCondition = getCondition(dominator);
+        if (dominatorCondition == NULL) {
+            continue;
+        }
+        bool dominatorNegated;
+        if (!isSameTree(core, stripNegation(dominatorCondition, &dominatorNegated))) {
+            continue;
+        }
+        for (Edge *edge = dominator->outEdges; edge != NULL; edge = edge->nextOut) {
+            BasicBlock *target = edge->targetBlock;
+            // an earlier fold of this pass may have left the target without edges
+            if (edge->type == UNCONDITIONAL_JUMP || target->inEdges == NULL || target->inEdges->nextIn != NULL ||
+                !dominates(ctx->tree, target, block)) {
+                continue;
+            }
+            if (isWrittenBetween(ctx, target, block)) {
+                return false;
+            }
+            bool value = (edge->type == TRUE_CONDITION) != dominatorNegated;
+            *outcome = value != negated;
+            return true;
+        }
+    }
+    return false;
+}
+
+static uint32_t foldKnownBranches(CFG *cfg) {
+    ThreadingContext ctx;
+    ctx.accesses = collectFunctionAccesses(cfg);
+    ctx.tree = buildDominatorTree(cfg);
+    BlockOrder *order = ctx.accesses->order;
+    ctx.inRegion = (bool *)malloc(sizeof(bool) * (order->blockCount + 1));
+    ctx.stack = (uint32_t *)malloc(sizeof(uint32_t) * (order->blockCount + 1));
+
+    // removing edges only takes paths away, so what was found on the old graph still holds
+    uint32_t foldedCount = 0;
+    for (uint32_t b = 0; b < order->blockCount; b++) {
+        BasicBlock *block = order->blocks[b];
+        OperationTreeNode *condition = getCondition(block);
+        bool outcome;
+        if (condition == NULL || !findKnownOutcome(&ctx, block, condition, &outcome)) {
+            continue;
+        }
+        EdgeType dead = outcome ? FALSE_CONDITION : TRUE_CONDITION;
+        Edge *edge = block->outEdges;
+        while (edge != NULL) {
+            Edge *next = edge->nextOut;
+            if (edge->type == dead) {
+                removeEdge(edge);
+            } else {
+                edge->type = UNCONDITIONAL_JUMP;
+            }
+            edge = next;
+        }
+        destroyOperationTreeNodeTree(condition);
+        block->instructionCount--;
+        block->type = UNCONDITIONAL;
+        foldedCount++;
+    }
+
+    free(ctx.stack);
+    free(ctx.inRegion);
+    freeDominatorTree(ctx.tree);
+    freeFunctionAccesses(ctx.accesses);
+    return foldedCount;
+}
+
+static uint32_t removeUnreachableBlocks(CFG *cfg) {
+    BlockOrder *order = buildBlockOrder(cfg);
+    uint32_t removedCount = 0;
+    BasicBlock *block = cfg->blocks;
+    while (block != NULL) {
+        BasicBlock *next = block->next;
+        if (block->type != TERMINAL && getBlockOrderIndex(order, block) == -1) {
+            removeBasicBlock(cfg, block);
+            removedCount++;
+        }
+        block = next;
+    }
+    freeBlockOrder(order);
+    return removedCount;
+}
+
+static bool hasEdgeTo(BasicBlock *from, BasicBlock *target) {
+    for (Edge *edge = from->outEdges; edge != NULL; edge = edge->nextOut) {
+        if (edge->targetBlock == target) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static uint32_t bypassEmptyBlocks(CFG *cfg, uint32_t *removedCount) {
+    uint32_t threadedCount = 0;
+    BasicBlock *block = cfg->blocks;
+    while (block != NULL) {
+        BasicBlock *next = block->next;
+        if (block == cfg->entryBlock || block->type != UNCONDITIONAL || block->instructionCount != 0 ||
+            block->outEdges == NULL || block->outEdges->nextOut != NULL || block->outEdges->targetBlock == block) {
+            block = next;
+            continue;
+        }
+        BasicBlock *target = block->outEdges->targetBlock;
+        Edge *edge = block->inEdges;
+        while (edge != NULL) {
+            Edge *nextIn = edge->nextIn;
+            // a branch with both edges into the same block is left as it is
+            if (!hasEdgeTo(edge->fromBlock, target)) {
+                retargetEdge(edge, target);
+                threadedCount++;
+            }
+            edge = nextIn;
+        }
+        if (block->inEdges == NULL) {
+            removeBasicBlock(cfg, block);
+            (*removedCount)++;
+        }
+        block = next;
+    }
+    return threadedCount;
+}
+
+void threadJumps(CFG *cfg, JumpThreadingStats *stats) {
+    stats->foldedBranches = 0;
+    stats->threadedEdges = 0;
+    stats->removedBlocks = 0;
+    if (cfg == NULL) {
+        return;
+    }
+    bool changed = true;
+    while (changed) {
+        uint32_t folded = foldKnownBranches(cfg);
+        stats->removedBlocks += removeUnreachableBlocks(cfg);
+        uint32_t threaded = bypassEmptyBlocks(cfg, &stats->removedBlocks);
+        stats->foldedBranches += folded;
+        stats->threadedEdges += threaded;
+        changed = folded > 0 || threaded > 0;
+    }
+    if (stats->foldedBranches > 0 || stats->threadedEdges > 0 || stats->removedBlocks > 0) {
+        freeLoopForest(cfg->loops);
+        cfg->loops = buildLoopForest(cfg);
+    }
+}
+
+void printJumpThreadingStats(const char *functionName, JumpThreadingStats *stats) {
+    printf("Jump threading in %s: folded %u branches, threaded %u edges, removed %u blocks\n",
+           functionName, stats->foldedBranches, stats->threadedEdges, stats->removedBlocks);
+}
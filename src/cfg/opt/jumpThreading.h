@@ -0,0 +1,18 @@
+#pragma once
+
+#include "cfg/cfg.h"
+#include <stdint.h>
+
+typedef struct JumpThreadingStats {
+    uint32_t foldedBranches;   // conditions whose outcome was known from a dominating branch
+    uint32_t threadedEdges;    // edges moved past empty pass-through blocks
+    uint32_t removedBlocks;    // pass-through blocks and blocks left unreachable
+} JumpThreadingStats;
+
+// Removes a branch when a dominating block already tested the same side-effect
+// free condition and none of its variables is written on the way, then sends
+// edges entering empty blocks with a single successor straight to that successor.
+// Both steps repeat until the graph stops changing.
+void threadJumps(CFG *cfg, JumpThreadingStats *stats);
+
+void printJumpThreadingStats(const char *functionName, JumpThreadingStats *stats);
@@ -0,0 +1,287 @@
+#include "licm.h"
+#include "fold.h"
+#include "cfg/dataflow/liveness.h"
+#include "cfg/dom/dom.h"
+#include "cfg/loops/loops.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct LoopAnalysis {
+    FunctionAccesses *accesses;
+    DataflowResult *liveness;
+    DominatorTree *tree;
+} LoopAnalysis;
+
+typedef struct LoopContext {
+    CFG *cfg;
+    LoopAnalysis *analysis;
+    int32_t loop;
+    uint32_t *defCounts;       // definitions of every variable inside the loop
+    BasicBlock **exiting;      // loop blocks with an edge leaving the loop, breaks included
+    uint32_t exitingCount;
+    BasicBlock *preheader;
+} LoopContext;
+
+static void buildLoopAnalysis(CFG *cfg, LoopAnalysis *analysis) {
+    analysis->accesses = collectFunctionAccesses(cfg);
+    analysis->liveness = computeLiveness(analysis->accesses);
+    analysis->tree = buildDominatorTree(cfg);
+}
+
+static void freeLoopAnalysis(LoopAnalysis *analysis) {
+    freeDominatorTree(analysis->tree);
+    freeDataflowResult(analysis->liveness);
+    freeFunctionAccesses(analysis->accesses);
+}
+
+static bool isNonZeroLiteral(OperationTreeNode *node) {
+    ConstantValue value;
+    return getLiteralConstant(node, &value) && value.bits != 0;
+}
+
+static bool isDefinedInLoop(LoopContext *ctx, OperationTreeNode *leaf) {
+    int32_t variable = findLeafVariable(ctx->analysis->accesses->variables, leaf);
+    return variable != -1 && ctx->defCounts[variable] > 0;
+}
+
+// speculative is cleared for expressions that may fail when evaluated on a path that didn't evaluate them
+static bool isInvariantExpression(LoopContext *ctx, OperationTreeNode *node, bool *speculative) {
+    if (strcmp(node->label, LIT_READ) == 0) {
+        return true;
+    } else if (strcmp(node->label, READ) == 0) {
+        return !isDefinedInLoop(ctx, node->children[0]);
+    } else if (strcmp(node->label, INDEX) == 0) {
+        *speculative = false;
+        if (node->children[0]->childCount == 0) {
+            if (isDefinedInLoop(ctx, node->children[0])) {
+                return false;
+            }
+        } else if (!isInvariantExpression(ctx, node->children[0], speculative)) {
+            return false;
+        }
+        for (uint32_t i = 1; i < node->childCount; i++) {
+            if (!isInvariantExpression(ctx, node->children[i], speculative)) {
+                return false;
+            }
+        }
+        return true;
+    } else if ((isBinaryOp(node->label) && node->childCount == 2) || (isUnaryOp(node->label) && node->childCount == 1)) {
+        if ((strcmp(node->label, DIV) == 0 || strcmp(node->label, MOD) == 0) && !isNonZeroLiteral(node->children[1])) {
+            *speculative = false;
+        }
+        for (uint32_t i = 0; i < node->childCount; i++) {
+            if (!isInvariantExpression(ctx, node->children[i], speculative)) {
+                return false;
+            }
+        }
+        return true;
+    }
+    // calls may have side effects, anything else is not an expression we can move
+    return false;
+}
+
+// the write of a plain or initialized declaration assignment, NULL for other instructions
+static OperationTreeNode* getAssignment(OperationTreeNode *root) {
+    if (root == NULL) {
+        return NULL;
+    }
+    if (strcmp(root->label, DECLARE) == 0 && root->childCount == 3) {
+        root = root->children[2];
+    }
+    if (strcmp(root->label, WRITE) == 0 && root->children[0]->childCount == 0 && root->children[1] != NULL) {
+        return root;
+    }
+    return NULL;
+}
+
+static bool dominatesExits(LoopContext *ctx, BasicBlock *block) {
+    for (uint32_t i = 0; i < ctx->exitingCount; i++) {
+        if (!dominates(ctx->analysis->tree, block, ctx->exiting[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool isLiveOnExit(LoopContext *ctx, OperationTreeNode *leaf) {
+    Loop *loop = &ctx->cfg->loops->loops[ctx->loop];
+    for (uint32_t i = 0; i < loop->exitCount; i++) {
+        if (isVariableLiveIn(ctx->analysis->accesses, ctx->analysis->liveness, loop->exits[i], leaf)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool isBranchCondition(BasicBlock *block, int instruction) {
+    if (instruction != block->instructionCount - 1) {
+        return false;
+    }
+    for (Edge *edge = block->outEdges; edge != NULL; edge = edge->nextOut) {
+        if (edge->type != UNCONDITIONAL_JUMP) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool canHoist(LoopContext *ctx, BasicBlock *block, int instruction) {
+    if (isBranchCondition(block, instruction)) {
+        return false;
+    }
+    OperationTreeNode *write = getAssignment(block->instructions[instruction].otRoot);
+    if (write == NULL) {
+        return false;
+    }
+    OperationTreeNode *target = write->children[0];
+    int32_t variable = findLeafVariable(ctx->analysis->accesses->variables, target);
+    // the only definition in the loop, and no iteration reads a value coming from before it
+    if (variable == -1 || ctx->defCounts[variable] != 1) {
+        return false;
+    }
+    BasicBlock *header = ctx->cfg->loops->loops[ctx->loop].header;
+    if (isVariableLiveIn(ctx->analysis->accesses, ctx->analysis->liveness, header, target)) {
+        return false;
+    }
+    bool speculative = true;
+    if (!isInvariantExpression(ctx, write->children[1], &speculative)) {
+        return false;
+    }
+    // a block that doesn't run on every way out of the loop, e.g. before a break,
+    // can only give up its instruction if nobody sees the value after the loop
+    if (dominatesExits(ctx, block)) {
+        return true;
+    }
+    return speculative && !isLiveOnExit(ctx, target);
+}
+
+static BasicBlock* createPreheader(LoopContext *ctx) {
+    CFG *cfg = ctx->cfg;
+    BasicBlock *header = cfg->loops->loops[ctx->loop].header;
+    BasicBlock *preheader = createBasicBlock(getMaxBlockId(cfg) + 1, UNCONDITIONAL, "Preheader");
+    Edge *edge = header->inEdges;
+    while (edge != NULL) {
+        Edge *next = edge->nextIn;
+        if (!isInLoop(cfg->loops, ctx->loop, edge->fromBlock)) {
+            retargetEdge(edge, preheader);
+        }
+        edge = next;
+    }
+    addEdge(preheader, header, UNCONDITIONAL_JUMP, NULL);
+
+    BasicBlock **link = &cfg->blocks;
+    while (*link != header) {
+        link = &(*link)->next;
+    }
+    preheader->next = header;
+    *link = preheader;
+    if (cfg->entryBlock == header) {
+        cfg->entryBlock = preheader;
+    }
+    return preheader;
+}
+
+static void moveInstruction(LoopContext *ctx, BasicBlock *block, int instruction) {
+    if (ctx->preheader == NULL) {
+        ctx->preheader = createPreheader(ctx);
+    }
+    Instruction moved = block->instructions[instruction];
+    addInstruction(ctx->preheader, moved.text, moved.otRoot);
+    ctx->preheader->instructions[ctx->preheader->instructionCount - 1].movedFrom =
+        moved.movedFrom != -1 ? moved.movedFrom : block->id;
+    ctx->preheader->instructions[ctx->preheader->instructionCount - 1].scope = moved.scope;
+    block->instructionCount--;
+    memmove(&block->instructions[instruction], &block->instructions[instruction + 1],
+            sizeof(Instruction) * (block->instructionCount - instruction));
+    ctx->cfg->callSites->stale = true;
+}
+
+static uint32_t hoistLoop(CFG *cfg, LoopAnalysis *analysis, int32_t loop) {
+    LoopContext ctx;
+    ctx.cfg = cfg;
+    ctx.analysis = analysis;
+    ctx.loop = loop;
+    ctx.preheader = NULL;
+    BlockOrder *order = analysis->accesses->order;
+    ctx.defCounts = (uint32_t *)calloc(analysis->accesses->variables->count + 1, sizeof(uint32_t));
+    ctx.exiting = (BasicBlock **)malloc(sizeof(BasicBlock *) * (order->blockCount + 1));
+    ctx.exitingCount = 0;
+    for (uint32_t b = 0; b < order->blockCount; b++) {
+        BasicBlock *block = order->blocks[b];
+        if (!isInLoop(cfg->loops, loop, block)) {
+            continue;
+        }
+        BlockAccesses *accesses = &analysis->accesses->blocks[b];
+        for (uint32_t i = 0; i < accesses->count; i++) {
+            if (accesses->accesses[i].kind != ACCESS_USE) {
+                ctx.defCounts[accesses->accesses[i].variable]++;
+            }
+        }
+        for (Edge *edge = block->outEdges; edge != NULL; edge = edge->nextOut) {
+            if (!isInLoop(cfg->loops, loop, edge->targetBlock)) {
+                ctx.exiting[ctx.exitingCount++] = block;
+                break;
+            }
+        }
+    }
+
+    // reverse postorder keeps every moved instruction after the ones it reads
+    uint32_t movedCount = 0;
+    for (uint32_t b = 0; b < order->blockCount; b++) {
+        BasicBlock *block = order->blocks[b];
+        if (!isInLoop(cfg->loops, loop, block)) {
+            continue;
+        }
+        int i = 0;
+        while (i < block->instructionCount) {
+            if (!canHoist(&ctx, block, i)) {
+                i++;
+                continue;
+            }
+            OperationTreeNode *write = getAssignment(block->instructions[i].otRoot);
+            ctx.defCounts[findLeafVariable(analysis->accesses->variables, write->children[0])] = 0;
+            moveInstruction(&ctx, block, i);
+            movedCount++;
+        }
+    }
+    free(ctx.defCounts);
+    free(ctx.exiting);
+    return movedCount;
+}
+
+uint32_t hoistLoopInvariants(CFG *cfg, uint32_t *preheaderCount) {
+    *preheaderCount = 0;
+    if (cfg == NULL || cfg->loops == NULL || cfg->loops->loopCount == 0) {
+        return 0;
+    }
+    // loop indexes change when the forest is rebuilt, headers don't
+    uint32_t loopCount = cfg->loops->loopCount;
+    BasicBlock **headers = (BasicBlock **)malloc(sizeof(BasicBlock *) * loopCount);
+    for (uint32_t l = 0; l < loopCount; l++) {
+        headers[l] = cfg->loops->loops[l].header;
+    }
+
+    LoopAnalysis analysis;
+    buildLoopAnalysis(cfg, &analysis);
+    uint32_t movedCount = 0;
+    for (uint32_t l = 0; l < loopCount; l++) {
+        int32_t loop = getBlockLoop(cfg->loops, headers[l]);
+        if (loop == LOOP_NONE || cfg->loops->loops[loop].header != headers[l]) {
+            continue;
+        }
+        uint32_t moved = hoistLoop(cfg, &analysis, loop);
+        if (moved == 0) {
+            continue;
+        }
+        movedCount += moved;
+        (*preheaderCount)++;
+        // the new preheader belongs to the enclosing loops
+        freeLoopAnalysis(&analysis);
+        freeLoopForest(cfg->loops);
+        cfg->loops = buildLoopForest(cfg);
+        buildLoopAnalysis(cfg, &analysis);
+    }
+    freeLoopAnalysis(&analysis);
+    free(headers);
+    return movedCount;
+}
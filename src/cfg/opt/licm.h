@@ -0,0 +1,10 @@
+#pragma once
+
+#include "cfg/cfg.h"
+#include <stdint.h>
+
+// Hoists assignments whose operands are not written inside the loop into a
+// preheader created in front of the loop header. Loops are visited inner first,
+// so an invariant can move through several levels. Moved instructions keep the
+// id of their old block in movedFrom. Returns the number of moved instructions.
+uint32_t hoistLoopInvariants(CFG *cfg, uint32_t *preheaderCount);
@@ -0,0 +1,444 @@
+#include "sccp.h"
+#include "cfg/loops/loops.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct SCCPContext {
+    SCCPResult *result;
+    SSAForm *ssa;
+    BlockOrder *order;
+    AccessMap *accessMap;
+    uint32_t *predEdges;       // edge of every pred entry, parallel to order->preds
+    uint32_t *edgeWorklist;    // every edge becomes executable once, so it is queued at most once
+    uint32_t edgeHead;
+    uint32_t edgeTail;
+    uint32_t *valueWorklist;   // a value is lowered at most twice
+    uint32_t valueCount;
+    uint32_t valueCapacity;
+    uint32_t block;            // block of the instruction being evaluated
+} SCCPContext;
+
+static LatticeValue latticeTop() {
+    LatticeValue value;
+    value.level = LATTICE_TOP;
+    value.constant.kind = CONST_INT;
+    value.constant.bits = 0;
+    return value;
+}
+
+static LatticeValue latticeBottom() {
+    LatticeValue value = latticeTop();
+    value.level = LATTICE_BOTTOM;
+    return value;
+}
+
+static LatticeValue latticeConstant(ConstantValue *constant) {
+    LatticeValue value;
+    value.level = LATTICE_CONSTANT;
+    value.constant = *constant;
+    return value;
+}
+
+static bool isSameLattice(LatticeValue *a, LatticeValue *b) {
+    if (a->level != b->level) {
+        return false;
+    }
+    return a->level != LATTICE_CONSTANT || (a->constant.kind == b->constant.kind && a->constant.bits == b->constant.bits);
+}
+
+static LatticeValue meetLattice(LatticeValue a, LatticeValue b) {
+    if (a.level == LATTICE_TOP) {
+        return b;
+    }
+    if (b.level == LATTICE_TOP) {
+        return a;
+    }
+    return isSameLattice(&a, &b) ? a : latticeBottom();
+}
+
+static void markEdge(SCCPContext *ctx, uint32_t edge) {
+    if (ctx->result->executableEdges[edge]) {
+        return;
+    }
+    ctx->result->executableEdges[edge] = true;
+    ctx->edgeWorklist[ctx->edgeTail++] = edge;
+}
+
+static void lowerValue(SCCPContext *ctx, uint32_t value, LatticeValue lattice) {
+    LatticeValue *current = &ctx->result->values[value];
+    LatticeValue lowered = meetLattice(*current, lattice);
+    if (isSameLattice(current, &lowered)) {
+        return;
+    }
+    *current = lowered;
+    if (ctx->valueCount >= ctx->valueCapacity) {
+        ctx->valueCapacity = ctx->valueCapacity == 0 ? INITIAL_CAPACITY : ctx->valueCapacity * 2;
+        ctx->valueWorklist = (uint32_t *)realloc(ctx->valueWorklist, sizeof(uint32_t) * ctx->valueCapacity);
+    }
+    ctx->valueWorklist[ctx->valueCount++] = value;
+}
+
+// full definitions take the value of the right side, everything else the node defines is unknown
+static void defineNode(SCCPContext *ctx, OperationTreeNode *node, LatticeValue lattice) {
+    int32_t access = findNodeAccess(ctx->accessMap, node);
+    if (access == -1) {
+        return;
+    }
+    BlockAccesses *accesses = &ctx->ssa->accesses->blocks[ctx->block];
+    BlockSSA *blockSSA = &ctx->ssa->blocks[ctx->block];
+    for (uint32_t i = access; i < accesses->count && accesses->accesses[i].node == node; i++) {
+        if (accesses->accesses[i].kind == ACCESS_USE) {
+            continue;
+        }
+        lowerValue(ctx, blockSSA->accessValues[i], accesses->accesses[i].kind == ACCESS_DEF ? lattice : latticeBottom());
+    }
+}
+
+static LatticeValue evaluateNode(SCCPContext *ctx, OperationTreeNode *node);
+
+static void evaluateChildren(SCCPContext *ctx, OperationTreeNode *node, uint32_t from) {
+    for (uint32_t i = from; i < node->childCount; i++) {
+        evaluateNode(ctx, node->children[i]);
+    }
+}
+
+static LatticeValue evaluateOperator(SCCPContext *ctx, OperationTreeNode *node) {
+    LatticeValue operands[2];
+    for (uint32_t i = 0; i < node->childCount; i++) {
+        operands[i] = evaluateNode(ctx, node->children[i]);
+    }
+    for (uint32_t i = 0; i < node->childCount; i++) {
+        if (operands[i].level == LATTICE_BOTTOM) {
+            return latticeBottom();
+        }
+    }
+    for (uint32_t i = 0; i < node->childCount; i++) {
+        if (operands[i].level == LATTICE_TOP) {
+            return latticeTop();
+        }
+    }
+    ConstantValue result;
+    bool divisionByZero;
+    bool evaluated = node->childCount == 1
+        ? evaluateUnaryConstant(node->label, &operands[0].constant, &result)
+        : evaluateBinaryConstant(node->label, &operands[0].constant, &operands[1].constant, &result, &divisionByZero);
+    return evaluated ? latticeConstant(&result) : latticeBottom();
+}
+
+// Follows the evaluation order of collectOperationTreeAccesses
+static LatticeValue evaluateNode(SCCPContext *ctx, OperationTreeNode *node) {
+    if (node == NULL) {
+        return latticeBottom();
+    }
+
+    if (strcmp(node->label, LIT_READ) == 0) {
+        ConstantValue constant;
+        return getLiteralConstant(node, &constant) ? latticeConstant(&constant) : latticeBottom();
+    } else if (strcmp(node->label, READ) == 0) {
+        int32_t access = findNodeAccess(ctx->accessMap, node);
+        if (access == -1) {
+            return latticeBottom();
+        }
+        return ctx->result->values[ctx->ssa->blocks[ctx->block].accessValues[access]];
+    } else if (strcmp(node->label, WITH_TYPE) == 0) {
+        return latticeBottom();
+    } else if (strcmp(node->label, WRITE) == 0) {
+        OperationTreeNode *target = node->children[0];
+        LatticeValue value = evaluateNode(ctx, node->children[1]);
+        if (target->childCount == 0) {
+            defineNode(ctx, node, value);
+        } else if (strcmp(target->label, INDEX) == 0 && target->children[0]->childCount == 0) {
+            evaluateChildren(ctx, target, 1);
+            defineNode(ctx, node, latticeBottom());
+        } else {
+            evaluateNode(ctx, target);
+        }
+        return value;
+    } else if (strcmp(node->label, DECLARE) == 0) {
+        if (node->childCount == 3) {
+            return evaluateNode(ctx, node->children[2]);
+        }
+        defineNode(ctx, node, latticeBottom());
+        return latticeBottom();
+    } else if (strcmp(node->label, OT_CALL) == 0) {
+        evaluateChildren(ctx, node, node->children[0]->childCount == 0 ? 1 : 0);
+        defineNode(ctx, node, latticeBottom());
+        return latticeBottom();
+    } else if (strcmp(node->label, INDEX) == 0) {
+        evaluateChildren(ctx, node, node->children[0]->childCount == 0 ? 1 : 0);
+        return latticeBottom();
+    } else if ((isBinaryOp(node->label) && node->childCount == 2) || (isUnaryOp(node->label) && node->childCount == 1)) {
+        return evaluateOperator(ctx, node);
+    }
+    evaluateChildren(ctx, node, 0);
+    return latticeBottom();
+}
+
+static bool isBranchBlock(SCCPResult *result, BlockOrder *order, uint32_t block) {
+    for (uint32_t e = order->succOffsets[block]; e < order->succOffsets[block + 1]; e++) {
+        if (result->edges[e]->type != UNCONDITIONAL_JUMP) {
+            return order->blocks[block]->instructionCount > 0;
+        }
+    }
+    return false;
+}
+
+static void evaluateInstruction(SCCPContext *ctx, uint32_t block, int instruction) {
+    BasicBlock *basicBlock = ctx->order->blocks[block];
+    ctx->block = block;
+    LatticeValue condition = evaluateNode(ctx, basicBlock->instructions[instruction].otRoot);
+    if (instruction != basicBlock->instructionCount - 1 || !isBranchBlock(ctx->result, ctx->order, block) ||
+        condition.level == LATTICE_TOP) {
+        return;
+    }
+    for (uint32_t e = ctx->order->succOffsets[block]; e < ctx->order->succOffsets[block + 1]; e++) {
+        EdgeType type = ctx->result->edges[e]->type;
+        if (condition.level == LATTICE_BOTTOM || type == UNCONDITIONAL_JUMP ||
+            (type == TRUE_CONDITION) == (condition.constant.bits != 0)) {
+            markEdge(ctx, e);
+        }
+    }
+}
+
+static void evaluatePhi(SCCPContext *ctx, uint32_t block, PhiNode *phi) {
+    LatticeValue value = latticeTop();
+    uint32_t first = ctx->order->predOffsets[block];
+    for (uint32_t i = 0; i < phi->operandCount; i++) {
+        if (ctx->result->executableEdges[ctx->predEdges[first + i]]) {
+            value = meetLattice(value, ctx->result->values[phi->operands[i]]);
+        }
+    }
+    lowerValue(ctx, phi->value, value);
+}
+
+static void visitBlock(SCCPContext *ctx, uint32_t block) {
+    BlockSSA *blockSSA = &ctx->ssa->blocks[block];
+    for (uint32_t p = 0; p < blockSSA->phiCount; p++) {
+        evaluatePhi(ctx, block, &blockSSA->phis[p]);
+    }
+    // instructions depend only on values, they are revisited through the uses of changed values
+    if (ctx->result->executableBlocks[block]) {
+        return;
+    }
+    ctx->result->executableBlocks[block] = true;
+    BasicBlock *basicBlock = ctx->order->blocks[block];
+    for (int i = 0; i < basicBlock->instructionCount; i++) {
+        evaluateInstruction(ctx, block, i);
+    }
+    if (!isBranchBlock(ctx->result, ctx->order, block)) {
+        for (uint32_t e = ctx->order->succOffsets[block]; e < ctx->order->succOffsets[block + 1]; e++) {
+            markEdge(ctx, e);
+        }
+    }
+}
+
+static void visitUses(SCCPContext *ctx, uint32_t value) {
+    for (uint32_t u = ctx->ssa->useOffsets[value]; u < ctx->ssa->useOffsets[value + 1]; u++) {
+        SSAUse *use = &ctx->ssa->uses[u];
+        if (!ctx->result->executableBlocks[use->block]) {
+            continue;
+        }
+        if (use->kind == SSA_USE_PHI) {
+            evaluatePhi(ctx, use->block, &ctx->ssa->blocks[use->block].phis[use->index]);
+        } else {
+            evaluateInstruction(ctx, use->block, ctx->ssa->accesses->blocks[use->block].accesses[use->index].instruction);
+        }
+    }
+}
+
+SCCPResult* runSCCP(CFG *cfg) {
+    SSAForm *ssa = buildSSA(cfg);
+    if (ssa == NULL) {
+        return NULL;
+    }
+    BlockOrder *order = ssa->accesses->order;
+    uint32_t edgeCount = order->succOffsets[order->blockCount];
+    SCCPResult *result = (SCCPResult *)malloc(sizeof(SCCPResult));
+    result->ssa = ssa;
+    result->values = (LatticeValue *)malloc(sizeof(LatticeValue) * (ssa->valueCount + 1));
+    result->edges = (Edge **)malloc(sizeof(Edge *) * (edgeCount + 1));
+    result->executableEdges = (bool *)calloc(edgeCount + 1, sizeof(bool));
+    result->executableBlocks = (bool *)calloc(order->blockCount + 1, sizeof(bool));
+    // arguments and variables read before any assignment are unknown on entry
+    for (uint32_t v = 0; v < ssa->valueCount; v++) {
+        result->values[v] = v < ssa->accesses->variables->count ? latticeBottom() : latticeTop();
+    }
+
+    SCCPContext ctx;
+    memset(&ctx, 0, sizeof(SCCPContext));
+    ctx.result = result;
+    ctx.ssa = ssa;
+    ctx.order = order;
+    ctx.accessMap = buildAccessMap(ssa->accesses);
+    ctx.edgeWorklist = (uint32_t *)malloc(sizeof(uint32_t) * (edgeCount + 1));
+    ctx.predEdges = (uint32_t *)malloc(sizeof(uint32_t) * (edgeCount + 1));
+    // same fill order as the pred lists of the BlockOrder, so phi operand i belongs to predEdges[offset + i]
+    uint32_t *predFill = (uint32_t *)malloc(sizeof(uint32_t) * (order->blockCount + 1));
+    memcpy(predFill, order->predOffsets, sizeof(uint32_t) * (order->blockCount + 1));
+    for (uint32_t b = 0; b < order->blockCount; b++) {
+        uint32_t e = order->succOffsets[b];
+        for (Edge *edge = order->blocks[b]->outEdges; edge != NULL; edge = edge->nextOut) {
+            result->edges[e] = edge;
+            ctx.predEdges[predFill[order->succs[e]]++] = e;
+            e++;
+        }
+    }
+    free(predFill);
+
+    if (order->blockCount > 0) {
+        visitBlock(&ctx, 0);
+    }
+    while (ctx.edgeHead < ctx.edgeTail || ctx.valueCount > 0) {
+        if (ctx.edgeHead < ctx.edgeTail) {
+            visitBlock(&ctx, order->succs[ctx.edgeWorklist[ctx.edgeHead++]]);
+        } else {
+            visitUses(&ctx, ctx.valueWorklist[--ctx.valueCount]);
+        }
+    }
+
+    free(ctx.edgeWorklist);
+    free(ctx.predEdges);
+    free(ctx.valueWorklist);
+    freeAccessMap(ctx.accessMap);
+    return result;
+}
+
+void printSCCP(SCCPResult *result) {
+    SSAForm *ssa = result->ssa;
+    BlockOrder *order = ssa->accesses->order;
+    char name[256];
+    printf("Constant values:\n");
+    for (uint32_t v = ssa->accesses->variables->count; v < ssa->valueCount; v++) {
+        LatticeValue *value = &result->values[v];
+        if (value->level != LATTICE_CONSTANT) {
+            continue;
+        }
+        formatSSAValue(ssa, v, name, sizeof(name));
+        if (value->constant.kind == CONST_BOOL) {
+            printf("  %s = %s\n", name, value->constant.bits ? "true" : "false");
+        } else if (value->constant.kind == CONST_INT || value->constant.kind == CONST_LONG) {
+            printf("  %s = %" PRId64 "\n", name, (int64_t)value->constant.bits);
+        } else {
+            printf("  %s = %" PRIu64 "\n", name, value->constant.bits);
+        }
+    }
+    printf("Never taken edges:\n");
+    for (uint32_t e = 0; e < order->succOffsets[order->blockCount]; e++) {
+        if (!result->executableEdges[e]) {
+            printf("  BB%d -> BB%d\n", result->edges[e]->fromBlock->id, result->edges[e]->targetBlock->id);
+        }
+    }
+    printf("Never executed blocks:");
+    for (uint32_t b = 0; b < order->blockCount; b++) {
+        if (!result->executableBlocks[b]) {
+            printf(" BB%d", order->blocks[b]->id);
+        }
+    }
+    printf("\n\n");
+}
+
+static OperationTreeNode* replaceReads(SCCPResult *result, AccessMap *map, uint32_t block, OperationTreeNode *node, uint32_t *replacedCount) {
+    if (node == NULL) {
+        return NULL;
+    }
+    if (strcmp(node->label, READ) == 0 && node->childCount == 1 && node->children[0]->childCount == 0) {
+        int32_t access = findNodeAccess(map, node);
+        if (access == -1) {
+            return node;
+        }
+        LatticeValue *value = &result->values[result->ssa->blocks[block].accessValues[access]];
+        if (value->level != LATTICE_CONSTANT) {
+            return node;
+        }
+        OperationTreeNode *literal = newConstantOperationTreeNode(&value->constant, node->line, node->pos);
+        destroyOperationTreeNodeTree(node);
+        (*replacedCount)++;
+        return literal;
+    }
+    for (uint32_t i = 0; i < node->childCount; i++) {
+        node->children[i] = replaceReads(result, map, block, node->children[i], replacedCount);
+    }
+    return node;
+}
+
+uint32_t replaceConstantReads(SCCPResult *result) {
+    FunctionAccesses *accesses = result->ssa->accesses;
+    AccessMap *map = buildAccessMap(accesses);
+    uint32_t replacedCount = 0;
+    for (uint32_t b = 0; b < accesses->order->blockCount; b++) {
+        if (!result->executableBlocks[b]) {
+            continue;
+        }
+        BasicBlock *block = accesses->order->blocks[b];
+        for (int i = 0; i < block->instructionCount; i++) {
+            block->instructions[i].otRoot = replaceReads(result, map, b, block->instructions[i].otRoot, &replacedCount);
+        }
+    }
+    freeAccessMap(map);
+    return replacedCount;
+}
+
+static uint32_t countEdges(CFG *cfg) {
+    uint32_t count = 0;
+    for (BasicBlock *block = cfg->blocks; block != NULL; block = block->next) {
+        for (Edge *edge = block->outEdges; edge != NULL; edge = edge->nextOut) {
+            count++;
+        }
+    }
+    return count;
+}
+
+uint32_t pruneDeadBranches(CFG *cfg, SCCPResult *result, uint32_t *removedEdgeCount) {
+    BlockOrder *order = result->ssa->accesses->order;
+    uint32_t edgeCount = countEdges(cfg);
+    for (uint32_t b = 0; b < order->blockCount; b++) {
+        if (!result->executableBlocks[b]) {
+            continue;
+        }
+        for (uint32_t e = order->succOffsets[b]; e < order->succOffsets[b + 1]; e++) {
+            if (!result->executableEdges[e]) {
+                removeEdge(result->edges[e]);
+            }
+        }
+        // the condition is kept as a plain instruction, it may have side effects
+        BasicBlock *block = order->blocks[b];
+        if (isConditionBlock(block) && block->outEdges->nextOut == NULL) {
+            block->type = UNCONDITIONAL;
+            block->outEdges->type = UNCONDITIONAL_JUMP;
+        }
+    }
+
+    // blocks unreachable before the pass go as well, the terminal block is kept even if nothing reaches it
+    uint32_t removedBlockCount = 0;
+    BasicBlock *block = cfg->blocks;
+    while (block != NULL) {
+        BasicBlock *next = block->next;
+        int32_t index = getBlockOrderIndex(order, block);
+        if (block->type != TERMINAL && (index == -1 || !result->executableBlocks[index])) {
+            removeBasicBlock(cfg, block);
+            removedBlockCount++;
+        }
+        block = next;
+    }
+    *removedEdgeCount = edgeCount - countEdges(cfg);
+
+    if (removedBlockCount > 0 || *removedEdgeCount > 0) {
+        freeLoopForest(cfg->loops);
+        cfg->loops = buildLoopForest(cfg);
+    }
+    return removedBlockCount;
+}
+
+void freeSCCPResult(SCCPResult *result) {
+    if (result == NULL) {
+        return;
+    }
+    free(result->values);
+    free(result->edges);
+    free(result->executableEdges);
+    free(result->executableBlocks);
+    freeSSA(result->ssa);
+    free(result);
+}
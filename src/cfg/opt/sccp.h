@@ -0,0 +1,41 @@
+#pragma once
+
+#include "cfg/cfg.h"
+#include "cfg/ssa/ssa.h"
+#include "fold.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum {
+    LATTICE_TOP,               // no executable definition seen yet
+    LATTICE_CONSTANT,
+    LATTICE_BOTTOM             // not a constant
+} LatticeLevel;
+
+typedef struct LatticeValue {
+    LatticeLevel level;
+    ConstantValue constant;
+} LatticeValue;
+
+typedef struct SCCPResult {
+    SSAForm *ssa;
+    LatticeValue *values;      // per SSA value
+    Edge **edges;              // indexed like ssa->accesses->order->succs
+    bool *executableEdges;
+    bool *executableBlocks;    // indexed like ssa->accesses->order->blocks
+} SCCPResult;
+
+// Wegman-Zadeck sparse conditional constant propagation over the SSA side table
+SCCPResult* runSCCP(CFG *cfg);
+
+void printSCCP(SCCPResult *result);
+
+// replaces reads of constant values in executable blocks with literals, the result is
+// stale afterwards except for pruneDeadBranches. Returns the number of replaced reads.
+uint32_t replaceConstantReads(SCCPResult *result);
+
+// removes edges that are never taken and blocks that are never executed,
+// the result describes the old graph afterwards and has to be freed only
+uint32_t pruneDeadBranches(CFG *cfg, SCCPResult *result, uint32_t *removedEdgeCount);
+
+void freeSCCPResult(SCCPResult *result);
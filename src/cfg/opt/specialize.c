@@ -0,0 +1,454 @@
+#include "specialize.h"
+#include "sccp.h"
+#include "cfg/loops/loops.h"
+#include "cfg/symbols/symbols.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct SpecializeContext {
+    Program *program;
+    SpecializationReport *report;
+    CallGraph *names;          // function name -> node, not frozen
+    FunctionInfo **functions;  // indexed by node
+    uint32_t functionCapacity;
+    FunctionInfo **worklist;   // functions whose calls are still to be specialized, copies are added as they are made
+    uint32_t worklistCount;
+    uint32_t worklistCapacity;
+} SpecializeContext;
+
+static uint32_t countInstructions(CFG *cfg) {
+    uint32_t count = 0;
+    for (BasicBlock *block = cfg->blocks; block != NULL; block = block->next) {
+        count += block->instructionCount;
+    }
+    return count;
+}
+
+// the list is in reverse declaration order
+static ArgumentInfo** getDeclaredArguments(FunctionInfo *func, uint32_t *count) {
+    *count = 0;
+    for (ArgumentInfo *arg = func->arguments; arg != NULL; arg = arg->next) {
+        (*count)++;
+    }
+    ArgumentInfo **arguments = (ArgumentInfo **)malloc(sizeof(ArgumentInfo *) * (*count + 1));
+    uint32_t position = *count;
+    for (ArgumentInfo *arg = func->arguments; arg != NULL; arg = arg->next) {
+        arguments[--position] = arg;
+    }
+    return arguments;
+}
+
+static void addFunction(SpecializeContext *ctx, FunctionInfo *func) {
+    uint32_t node = addFunctionToCallGraph(ctx->names, func->functionName);
+    if (node >= ctx->functionCapacity) {
+        ctx->functionCapacity = ctx->functionCapacity == 0 ? INITIAL_CAPACITY : ctx->functionCapacity * 2;
+        ctx->functions = (FunctionInfo **)realloc(ctx->functions, sizeof(FunctionInfo *) * ctx->functionCapacity);
+    }
+    ctx->functions[node] = func;
+    if (ctx->worklistCount >= ctx->worklistCapacity) {
+        ctx->worklistCapacity = ctx->worklistCapacity == 0 ? INITIAL_CAPACITY : ctx->worklistCapacity * 2;
+        ctx->worklist = (FunctionInfo **)realloc(ctx->worklist, sizeof(FunctionInfo *) * ctx->worklistCapacity);
+    }
+    ctx->worklist[ctx->worklistCount++] = func;
+}
+
+static bool readsVariable(OperationTreeNode *node, const char *name) {
+    if (node == NULL) {
+        return false;
+    }
+    if (strcmp(node->label, READ) == 0 && node->childCount == 1 && node->children[0]->childCount == 0) {
+        return strcmp(node->children[0]->label, name) == 0;
+    }
+    for (uint32_t i = 0; i < node->childCount; i++) {
+        if (readsVariable(node->children[i], name)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// only arguments some branch condition reads are worth a copy
+static bool branchesOnArgument(CFG *cfg, const char *name) {
+    for (BasicBlock *block = cfg->blocks; block != NULL; block = block->next) {
+        if (isConditionBlock(block) && block->instructionCount > 0 &&
+            readsVariable(block->instructions[block->instructionCount - 1].otRoot, name)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static CFG* cloneCFG(CFG *cfg) {
+    CFG *copy = createCFG();
+    uint32_t blockCount = 0;
+    for (BasicBlock *b = cfg->blocks; b != NULL; b = b->next) {
+        blockCount++;
+    }
+    BasicBlock **originals = (BasicBlock **)malloc(sizeof(BasicBlock *) * (blockCount + 1));
+    BasicBlock **copies = (BasicBlock **)malloc(sizeof(BasicBlock *) * (blockCount + 1));
+    BasicBlock **last = &copy->blocks;
+    uint32_t count = 0;
+    for (BasicBlock *b = cfg->blocks; b != NULL; b = b->next) {
+        BasicBlock *block = createBasicBlock(b->id, b->type, b->name);
+        for (int i = 0; i < b->instructionCount; i++) {
+            addInstruction(block, b->instructions[i].text, cloneOperationTree(b->instructions[i].otRoot));
+            block->instructions[i].movedFrom = b->instructions[i].movedFrom;
+            block->instructions[i].scope = b->instructions[i].scope;
+        }
+        block->isEmpty = b->isEmpty;
+        if (b == cfg->entryBlock) {
+            copy->entryBlock = block;
+        }
+        *last = block;
+        last = &block->next;
+        originals[count] = b;
+        copies[count++] = block;
+    }
+
+    // addEdge prepends, adding in reverse keeps the edge order
+    Edge **edges = (Edge **)malloc(sizeof(Edge *) * INITIAL_CAPACITY);
+    uint32_t edgeCapacity = INITIAL_CAPACITY;
+    for (uint32_t b = 0; b < count; b++) {
+        uint32_t edgeCount = 0;
+        for (Edge *edge = originals[b]->outEdges; edge != NULL; edge = edge->nextOut) {
+            if (edgeCount == edgeCapacity) {
+                edgeCapacity *= 2;
+                edges = (Edge **)realloc(edges, sizeof(Edge *) * edgeCapacity);
+            }
+            edges[edgeCount++] = edge;
+        }
+        while (edgeCount > 0) {
+            Edge *edge = edges[--edgeCount];
+            uint32_t target = 0;
+            while (originals[target] != edge->targetBlock) {
+                target++;
+            }
+            addEdge(copies[b], copies[target], edge->type, edge->condition);
+        }
+        copies[b]->isBreak = originals[b]->isBreak;
+    }
+    free(edges);
+    free(copies);
+    free(originals);
+
+    // both tables start with the arguments' scope, so the copies keep their declarations and scopes
+    uint32_t scopeBase;
+    appendSymbolTable(copy->symbols, cfg->symbols, NULL, 0, &scopeBase);
+
+    copy->loops = buildLoopForest(copy);
+    copy->callSites->stale = true;
+    return copy;
+}
+
+static OperationTreeNode* newConstantDeclaration(ArgumentInfo *argument, ConstantValue *value) {
+    OperationTreeNode *declare = newOperationTreeNode(DECLARE, 3, argument->line, argument->pos, true);
+    declare->children[0] = newWithTypeNode(argument->type, argument->line, argument->pos);
+    declare->children[1] = newOperationTreeNode(argument->name, 0, argument->line, argument->pos, true);
+    declare->children[1]->symbol = argument->symbol;
+    declare->children[2] = newOperationTreeNode(WRITE, 2, argument->line, argument->pos, true);
+    declare->children[2]->children[0] = cloneOperationTree(declare->children[1]);
+    declare->children[2]->children[1] = newConstantOperationTreeNode(value, argument->line, argument->pos);
+    return declare;
+}
+
+// constant arguments become declarations ahead of the body, in a block of their own if the entry is a loop header
+static void bindConstantArguments(FunctionInfo *function, ArgumentInfo **arguments, uint32_t argumentCount, bool *isConstant, ConstantValue *constants) {
+    CFG *cfg = function->cfg;
+    BasicBlock *entry = cfg->entryBlock;
+    if (entry->inEdges != NULL) {
+        BasicBlock *block = createBasicBlock(getMaxBlockId(cfg) + 1, UNCONDITIONAL, "Specialized arguments");
+        addEdge(block, entry, UNCONDITIONAL_JUMP, NULL);
+        addBasicBlock(cfg, block);
+        cfg->entryBlock = block;
+        entry = block;
+    }
+    int bodyCount = entry->instructionCount;
+    for (uint32_t i = 0; i < argumentCount; i++) {
+        if (isConstant[i]) {
+            addInstruction(entry, VAR, newConstantDeclaration(arguments[i], &constants[i]));
+            entry->instructions[entry->instructionCount - 1].scope = 0; // the arguments' scope
+        }
+    }
+    int boundCount = entry->instructionCount - bodyCount;
+    Instruction *body = (Instruction *)malloc(sizeof(Instruction) * (bodyCount + 1));
+    memcpy(body, entry->instructions, sizeof(Instruction) * bodyCount);
+    memmove(entry->instructions, entry->instructions + bodyCount, sizeof(Instruction) * boundCount);
+    memcpy(entry->instructions + boundCount, body, sizeof(Instruction) * bodyCount);
+    free(body);
+}
+
+// lets SCCP decide the branches on the constants and folds what becomes constant
+static void simplifySpecialization(Program *program, FunctionInfo *function) {
+    CFG *cfg = function->cfg;
+    SCCPResult *result = runSCCP(cfg);
+    if (result != NULL) {
+        replaceConstantReads(result);
+        uint32_t removedEdgeCount;
+        pruneDeadBranches(cfg, result, &removedEdgeCount);
+        freeSCCPResult(result);
+    }
+    uint32_t foldedCount = 0;
+    for (BasicBlock *block = cfg->blocks; block != NULL; block = block->next) {
+        for (int i = 0; i < block->instructionCount; i++) {
+            block->instructions[i].otRoot = foldOperationTree(block->instructions[i].otRoot, program, function->fileName, &foldedCount);
+        }
+    }
+    cfg->callSites->stale = true;
+}
+
+static bool isSameConstant(ConstantValue *a, ConstantValue *b) {
+    return a->kind == b->kind && a->bits == b->bits;
+}
+
+static Specialization* findSpecialization(SpecializationReport *report, FunctionInfo *callee, bool *isConstant, ConstantValue *constants) {
+    for (uint32_t s = 0; s < report->count; s++) {
+        Specialization *specialization = &report->specializations[s];
+        if (specialization->callee != callee) {
+            continue;
+        }
+        bool same = true;
+        for (uint32_t i = 0; i < specialization->argumentCount && same; i++) {
+            same = specialization->isConstant[i] == isConstant[i] &&
+                   (!isConstant[i] || isSameConstant(&specialization->constants[i], &constants[i]));
+        }
+        if (same) {
+            return specialization;
+        }
+    }
+    return NULL;
+}
+
+static uint32_t countVersions(SpecializationReport *report, FunctionInfo *callee) {
+    uint32_t count = 0;
+    for (uint32_t s = 0; s < report->count; s++) {
+        if (report->specializations[s].callee == callee) {
+            count++;
+        }
+    }
+    return count;
+}
+
+// NULL if the simplified copy doesn't fit what is left of the budget
+static Specialization* createSpecialization(SpecializeContext *ctx, FunctionInfo *callee, ArgumentInfo **arguments, uint32_t argumentCount,
+                                            bool *isConstant, ConstantValue *constants) {
+    char name[256];
+    snprintf(name, sizeof(name), "%s.spec%u", callee->functionName, countVersions(ctx->report, callee) + 1);
+    FunctionInfo *function = createFunctionInfo(callee->fileName, name, callee->returnType, callee->line, callee->pos);
+    // addArgument prepends, so declaration order keeps the list reversed like the parser's
+    for (uint32_t i = 0; i < argumentCount; i++) {
+        if (!isConstant[i]) {
+            ArgumentInfo *argument = createArgumentInfo(arguments[i]->type, arguments[i]->name, arguments[i]->line, arguments[i]->pos);
+            argument->symbol = arguments[i]->symbol;
+            addArgument(function, argument);
+        }
+    }
+    function->cfg = cloneCFG(callee->cfg);
+    bindConstantArguments(function, arguments, argumentCount, isConstant, constants);
+    simplifySpecialization(ctx->program, function);
+    // the copy is charged what is left of it, bound declarations included
+    uint32_t size = countInstructions(function->cfg);
+    if (ctx->report->budgetUsed + size > SPECIALIZE_BUDGET) {
+        freeFunctionInfo(function);
+        return NULL;
+    }
+    function->next = callee->next;
+    callee->next = function;
+    addFunction(ctx, function);
+
+    SpecializationReport *report = ctx->report;
+    if (report->count >= report->capacity) {
+        report->capacity = report->capacity == 0 ? INITIAL_CAPACITY : report->capacity * 2;
+        report->specializations = (Specialization *)realloc(report->specializations, sizeof(Specialization) * report->capacity);
+    }
+    Specialization *specialization = &report->specializations[report->count++];
+    specialization->callee = callee;
+    specialization->function = function;
+    specialization->argumentCount = argumentCount;
+    specialization->isConstant = (bool *)malloc(sizeof(bool) * (argumentCount + 1));
+    specialization->constants = (ConstantValue *)malloc(sizeof(ConstantValue) * (argumentCount + 1));
+    memcpy(specialization->isConstant, isConstant, sizeof(bool) * argumentCount);
+    memcpy(specialization->constants, constants, sizeof(ConstantValue) * argumentCount);
+    specialization->size = size;
+    specialization->siteCount = 0;
+    report->budgetUsed += specialization->size;
+    return specialization;
+}
+
+// the call drops its constant arguments and calls the copy
+static void rewriteCall(OperationTreeNode *call, Specialization *specialization) {
+    OperationTreeNode **children = (OperationTreeNode **)malloc(sizeof(OperationTreeNode *) * call->childCount);
+    uint32_t childCount = 0;
+    children[childCount++] = call->children[0];
+    for (uint32_t i = 0; i < specialization->argumentCount; i++) {
+        if (specialization->isConstant[i]) {
+            destroyOperationTreeNodeTree(call->children[i + 1]);
+        } else {
+            children[childCount++] = call->children[i + 1];
+        }
+    }
+    free(call->children);
+    call->children = children;
+    call->childCount = childCount;
+    free((void *)children[0]->label);
+    children[0]->label = strdup(specialization->function->functionName);
+    specialization->siteCount++;
+}
+
+// returns true if the call was rewritten
+static bool specializeCall(SpecializeContext *ctx, OperationTreeNode *call) {
+    if (call->children[0]->childCount != 0) {
+        return false;
+    }
+    int32_t node = findFunction(ctx->names, call->children[0]->label);
+    if (node == CG_NO_NODE) {
+        return false;
+    }
+    FunctionInfo *callee = ctx->functions[node];
+    uint32_t calleeSize = countInstructions(callee->cfg);
+    if (calleeSize > SPECIALIZE_SIZE_LIMIT) {
+        return false;
+    }
+    uint32_t argumentCount;
+    ArgumentInfo **arguments = getDeclaredArguments(callee, &argumentCount);
+    if (argumentCount != call->childCount - 1) {
+        free(arguments);
+        return false;
+    }
+    bool *isConstant = (bool *)malloc(sizeof(bool) * (argumentCount + 1));
+    ConstantValue *constants = (ConstantValue *)malloc(sizeof(ConstantValue) * (argumentCount + 1));
+    bool anyConstant = false;
+    for (uint32_t i = 0; i < argumentCount; i++) {
+        const TypeEntry *type = getType(ctx->program->types, arguments[i]->type);
+        // the copy binds the literal as the parameter's type, so equal values of other widths share it
+        isConstant[i] = !type->isArray && getLiteralConstant(call->children[i + 1], &constants[i]) &&
+                        convertConstant(&constants[i], type->name, type->custom) &&
+                        branchesOnArgument(callee->cfg, arguments[i]->name);
+        anyConstant = anyConstant || isConstant[i];
+    }
+
+    Specialization *specialization = NULL;
+    if (anyConstant) {
+        specialization = findSpecialization(ctx->report, callee, isConstant, constants);
+        if (specialization == NULL && countVersions(ctx->report, callee) < SPECIALIZE_VERSION_LIMIT) {
+            specialization = createSpecialization(ctx, callee, arguments, argumentCount, isConstant, constants);
+        }
+        if (specialization == NULL) {
+            ctx->report->skippedCount++;
+        }
+    }
+    if (specialization != NULL) {
+        rewriteCall(call, specialization);
+    }
+    free(isConstant);
+    free(constants);
+    free(arguments);
+    return specialization != NULL;
+}
+
+static uint32_t specializeTreeCalls(SpecializeContext *ctx, OperationTreeNode *node) {
+    if (node == NULL) {
+        return 0;
+    }
+    uint32_t rewrittenCount = 0;
+    // a variable named like the call label is a leaf
+    if (strcmp(node->label, OT_CALL) == 0 && node->childCount >= 1 && specializeCall(ctx, node)) {
+        rewrittenCount++;
+    }
+    for (uint32_t i = 0; i < node->childCount; i++) {
+        rewrittenCount += specializeTreeCalls(ctx, node->children[i]);
+    }
+    return rewrittenCount;
+}
+
+SpecializationReport* specializeProgramCalls(Program *program) {
+    SpecializationReport *report = (SpecializationReport *)malloc(sizeof(SpecializationReport));
+    report->specializations = NULL;
+    report->count = 0;
+    report->capacity = 0;
+    report->budgetUsed = 0;
+    report->skippedCount = 0;
+    // a CFG with errors may be incomplete
+    if (program->errors != NULL) {
+        return report;
+    }
+
+    SpecializeContext ctx;
+    memset(&ctx, 0, sizeof(SpecializeContext));
+    ctx.program = program;
+    ctx.report = report;
+    ctx.names = createCallGraph();
+    for (FunctionInfo *func = program->functions; func != NULL; func = func->next) {
+        if (func->cfg != NULL) {
+            addFunction(&ctx, func);
+        }
+    }
+    // copies land on the worklist too, their calls may have become constant
+    for (uint32_t w = 0; w < ctx.worklistCount; w++) {
+        FunctionInfo *caller = ctx.worklist[w];
+        uint32_t rewrittenCount = 0;
+        for (BasicBlock *block = caller->cfg->blocks; block != NULL; block = block->next) {
+            for (int i = 0; i < block->instructionCount; i++) {
+                rewrittenCount += specializeTreeCalls(&ctx, block->instructions[i].otRoot);
+            }
+        }
+        if (rewrittenCount > 0) {
+            caller->cfg->callSites->stale = true;
+        }
+    }
+
+    free(ctx.functions);
+    free(ctx.worklist);
+    freeCallGraph(ctx.names);
+    return report;
+}
+
+static void printConstant(ConstantValue *value) {
+    if (value->kind == CONST_BOOL) {
+        printf("%s", value->bits ? "true" : "false");
+    } else if (value->kind == CONST_INT || value->kind == CONST_LONG) {
+        printf("%" PRId64, (int64_t)value->bits);
+    } else {
+        printf("%" PRIu64, value->bits);
+    }
+}
+
+void printSpecializationReport(SpecializationReport *report) {
+    uint32_t siteCount = 0;
+    for (uint32_t s = 0; s < report->count; s++) {
+        siteCount += report->specializations[s].siteCount;
+    }
+    printf("Specialized %u calls with %u copies, %u of %u instructions of budget used\n",
+           siteCount, report->count, report->budgetUsed, SPECIALIZE_BUDGET);
+    for (uint32_t s = 0; s < report->count; s++) {
+        Specialization *specialization = &report->specializations[s];
+        printf("  %s = %s(", specialization->function->functionName, specialization->callee->functionName);
+        for (uint32_t i = 0; i < specialization->argumentCount; i++) {
+            if (i > 0) {
+                printf(", ");
+            }
+            if (specialization->isConstant[i]) {
+                printConstant(&specialization->constants[i]);
+            } else {
+                printf("_");
+            }
+        }
+        printf("): %u instructions, %u calls\n", specialization->size, specialization->siteCount);
+    }
+    if (report->skippedCount > 0) {
+        printf("Skipped %u calls over the budget or the version limit\n", report->skippedCount);
+    }
+}
+
+void freeSpecializationReport(SpecializationReport *report) {
+    if (report == NULL) {
+        return;
+    }
+    for (uint32_t s = 0; s < report->count; s++) {
+        free(report->specializations[s].isConstant);
+        free(report->specializations[s].constants);
+    }
+    free(report->specializations);
+    free(report);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "cfg/cfg.h"
+#include "fold.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// callees with more instructions are never specialized
+#define SPECIALIZE_SIZE_LIMIT 64
+// instructions all specialized copies of a program may add up to
+#define SPECIALIZE_BUDGET 512
+// copies made of one function
+#define SPECIALIZE_VERSION_LIMIT 4
+
+typedef struct Specialization {
+    FunctionInfo *callee;      // the function that was copied
+    FunctionInfo *function;    // the copy, named <callee>.spec<n>
+    uint32_t argumentCount;    // of the callee
+    bool *isConstant;          // per argument in declaration order
+    ConstantValue *constants;  // values of the constant arguments
+    uint32_t size;             // instructions left after folding
+    uint32_t siteCount;        // calls rewritten to the copy
+} Specialization;
+
+typedef struct SpecializationReport {
+    Specialization *specializations;
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t budgetUsed;
+    uint32_t skippedCount;     // calls left alone because of the budget or the version limit
+} SpecializationReport;
+
+// Copies callees for the literal arguments of a call where the callee branches on the
+// argument, binds them as declarations of the copy and lets SCCP and folding remove what
+// they decide. Copies are cached by callee and constants, so equal calls share one, and
+// calls inside copies are specialized as well. The call drops the constant arguments and
+// calls the copy, which is added to the program after its callee.
+SpecializationReport* specializeProgramCalls(Program *program);
+
+void printSpecializationReport(SpecializationReport *report);
+
+void freeSpecializationReport(SpecializationReport *report);
@@ -0,0 +1,255 @@
+#include "strength.h"
+#include "fold.h"
+#include "cfg/dataflow/access.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef enum {
+    SIGNEDNESS_UNKNOWN,        // not declared in the function, or declared with different types
+    SIGNEDNESS_SIGNED,
+    SIGNEDNESS_UNSIGNED
+} Signedness;
+
+typedef struct VariableTypes {
+    VariableTable *names;
+    Signedness *signedness;    // indexed like names, element type for arrays
+    uint32_t capacity;
+    TypeTable *typeTable;      // where the declared type ids point
+} VariableTypes;
+
+static Signedness getTypeSignedness(TypeTable *typeTable, uint32_t type) {
+    if (type == TYPE_NONE) {
+        return SIGNEDNESS_UNKNOWN;
+    }
+    const TypeEntry *entry = getType(typeTable, type);
+    if (entry->custom) {
+        return SIGNEDNESS_UNKNOWN;
+    }
+    const char *typeName = entry->name;
+    if (strcmp(typeName, "byte") == 0 || strcmp(typeName, "uint") == 0 || strcmp(typeName, "ulong") == 0) {
+        return SIGNEDNESS_UNSIGNED;
+    }
+    if (strcmp(typeName, "int") == 0 || strcmp(typeName, "long") == 0) {
+        return SIGNEDNESS_SIGNED;
+    }
+    return SIGNEDNESS_UNKNOWN;
+}
+
+static void declareVariable(VariableTypes *types, const char *name, Signedness signedness) {
+    uint32_t countBefore = types->names->count;
+    uint32_t variable = internVariable(types->names, name);
+    if (variable >= types->capacity) {
+        types->capacity = types->capacity == 0 ? INITIAL_CAPACITY : types->capacity * 2;
+        while (types->capacity <= variable) {
+            types->capacity *= 2;
+        }
+        types->signedness = (Signedness *)realloc(types->signedness, sizeof(Signedness) * types->capacity);
+    }
+    if (variable >= countBefore) {
+        types->signedness[variable] = signedness;
+    } else if (types->signedness[variable] != signedness) {
+        types->signedness[variable] = SIGNEDNESS_UNKNOWN;
+    }
+}
+
+static void collectDeclarations(VariableTypes *types, OperationTreeNode *node) {
+    if (node == NULL) {
+        return;
+    }
+    if (strcmp(node->label, DECLARE) == 0 && node->childCount >= 2) {
+        declareVariable(types, node->children[1]->label, getTypeSignedness(types->typeTable, node->children[0]->typeId));
+    }
+    for (uint32_t i = 0; i < node->childCount; i++) {
+        collectDeclarations(types, node->children[i]);
+    }
+}
+
+static Signedness getVariableSignedness(VariableTypes *types, const char *name) {
+    int32_t variable = findVariable(types->names, name);
+    return variable == -1 ? SIGNEDNESS_UNKNOWN : types->signedness[variable];
+}
+
+// true only when every value the expression is made of is unsigned
+static bool isUnsignedExpression(VariableTypes *types, OperationTreeNode *node) {
+    if (strcmp(node->label, LIT_READ) == 0) {
+        return node->literal.kind == LITERAL_INTEGER && !node->literal.isSigned;
+    } else if (strcmp(node->label, READ) == 0) {
+        return getVariableSignedness(types, node->children[0]->label) == SIGNEDNESS_UNSIGNED;
+    } else if (strcmp(node->label, INDEX) == 0) {
+        return node->children[0]->childCount == 0 &&
+               getVariableSignedness(types, node->children[0]->label) == SIGNEDNESS_UNSIGNED;
+    } else if (strcmp(node->label, OT_SHL) == 0 || strcmp(node->label, OT_SHR) == 0) {
+        return isUnsignedExpression(types, node->children[0]);
+    } else if (isBinaryOp(node->label) && node->childCount == 2) {
+        return isUnsignedExpression(types, node->children[0]) && isUnsignedExpression(types, node->children[1]);
+    }
+    return false;
+}
+
+// true only when every value the expression is made of is an integer, shifts of strings or bools are wrong
+static bool isIntegerExpression(VariableTypes *types, OperationTreeNode *node) {
+    if (strcmp(node->label, LIT_READ) == 0) {
+        return node->literal.kind == LITERAL_INTEGER;
+    } else if (strcmp(node->label, READ) == 0) {
+        return getVariableSignedness(types, node->children[0]->label) != SIGNEDNESS_UNKNOWN;
+    } else if (strcmp(node->label, INDEX) == 0) {
+        return node->children[0]->childCount == 0 &&
+               getVariableSignedness(types, node->children[0]->label) != SIGNEDNESS_UNKNOWN;
+    } else if (strcmp(node->label, NEG) == 0 && node->childCount == 1) {
+        return isIntegerExpression(types, node->children[0]);
+    } else if (isBinaryOp(node->label) && node->childCount == 2) {
+        return isIntegerExpression(types, node->children[0]) && isIntegerExpression(types, node->children[1]);
+    }
+    return false;
+}
+
+// exponent of a positive power of two literal that fits its type, -1 otherwise
+static int32_t getPowerOfTwo(OperationTreeNode *node, ConstantValue *value) {
+    if (!getLiteralConstant(node, value) || value->kind == CONST_BOOL || value->bits == 0) {
+        return -1;
+    }
+    uint32_t width = value->kind == CONST_INT || value->kind == CONST_UINT ? 32 : 64;
+    if ((value->bits & (value->bits - 1)) != 0) {
+        return -1;
+    }
+    int32_t exponent = __builtin_ctzll(value->bits);
+    return exponent < (int32_t)width - 1 || (exponent == (int32_t)width - 1 && (value->kind == CONST_UINT || value->kind == CONST_ULONG)) ? exponent : -1;
+}
+
+static OperationTreeNode* newBinaryNode(const char *op, OperationTreeNode *left, OperationTreeNode *right, OperationTreeNode *origin) {
+    OperationTreeNode *node = newOperationTreeNode(op, 2, origin->line, origin->pos, true);
+    node->children[0] = left;
+    node->children[1] = right;
+    return node;
+}
+
+static OperationTreeNode* newShift(const char *op, OperationTreeNode *operand, uint32_t count, OperationTreeNode *origin) {
+    if (count == 0) {
+        return operand;
+    }
+    ConstantValue value = { CONST_INT, count };
+    return newBinaryNode(op, operand, newConstantOperationTreeNode(&value, origin->line, origin->pos), origin);
+}
+
+// x * c for c = 2^a + 2^b or c = 2^a - 2^b, the operand is a plain read so it can be evaluated twice
+static OperationTreeNode* reduceSmallMultiplication(OperationTreeNode *node, OperationTreeNode *operand, ConstantValue *value) {
+    if (strcmp(operand->label, READ) != 0 || value->kind == CONST_BOOL || value->bits > SHIFT_ADD_LIMIT || value->bits < 3) {
+        return NULL;
+    }
+    uint64_t c = value->bits;
+    uint32_t low = __builtin_ctzll(c);
+    uint64_t rest = c - ((uint64_t)1 << low);
+    const char *op = PLUS;
+    uint32_t high;
+    if ((rest & (rest - 1)) == 0) {
+        high = __builtin_ctzll(rest);
+    } else {
+        uint64_t sum = c + ((uint64_t)1 << low);
+        if ((sum & (sum - 1)) != 0) {
+            return NULL;
+        }
+        op = MINUS;
+        high = __builtin_ctzll(sum);
+    }
+    OperationTreeNode *left = newShift(OT_SHL, cloneOperationTree(operand), high, node);
+    OperationTreeNode *right = newShift(OT_SHL, cloneOperationTree(operand), low, node);
+    return newBinaryNode(op, left, right, node);
+}
+
+static OperationTreeNode* reduceNode(VariableTypes *types, OperationTreeNode *node) {
+    ConstantValue value;
+    int32_t exponent;
+    if (strcmp(node->label, MUL) == 0) {
+        for (uint32_t side = 0; side < 2; side++) {
+            OperationTreeNode *operand = node->children[1 - side];
+            if (strcmp(operand->label, LIT_READ) == 0 || !isIntegerExpression(types, operand)) {
+                continue;
+            }
+            exponent = getPowerOfTwo(node->children[side], &value);
+            if (exponent > 0) {
+                node->children[1 - side] = NULL;
+                return newShift(OT_SHL, operand, exponent, node);
+            }
+            if (getLiteralConstant(node->children[side], &value)) {
+                OperationTreeNode *reduced = reduceSmallMultiplication(node, operand, &value);
+                if (reduced != NULL) {
+                    return reduced;
+                }
+            }
+        }
+        return NULL;
+    }
+    bool isDiv = strcmp(node->label, DIV) == 0;
+    if (!isDiv && strcmp(node->label, MOD) != 0) {
+        return NULL;
+    }
+    // rounding of signed division and the sign of signed remainder don't match shifts and masks
+    exponent = getPowerOfTwo(node->children[1], &value);
+    if (exponent < 0 || !isUnsignedExpression(types, node->children[0])) {
+        return NULL;
+    }
+    OperationTreeNode *operand = node->children[0];
+    node->children[0] = NULL;
+    if (isDiv) {
+        return exponent == 0 ? operand : newShift(OT_SHR, operand, exponent, node);
+    }
+    value.bits -= 1;
+    return newBinaryNode(OT_AND, operand, newConstantOperationTreeNode(&value, node->line, node->pos), node);
+}
+
+// bottom-up, returns the node to put in place of the given one
+static OperationTreeNode* reduceOperationTree(VariableTypes *types, OperationTreeNode *node, uint32_t *reducedCount) {
+    if (node == NULL) {
+        return NULL;
+    }
+    for (uint32_t i = 0; i < node->childCount; i++) {
+        node->children[i] = reduceOperationTree(types, node->children[i], reducedCount);
+    }
+    if (node->childCount != 2 || (strcmp(node->label, MUL) != 0 && strcmp(node->label, DIV) != 0 && strcmp(node->label, MOD) != 0)) {
+        return node;
+    }
+    OperationTreeNode *reduced = reduceNode(types, node);
+    if (reduced == NULL) {
+        return node;
+    }
+    destroyOperationTreeNodeTree(node);
+    (*reducedCount)++;
+    return reduced;
+}
+
+uint32_t reduceFunctionStrength(Program *program, FunctionInfo *func) {
+    if (func->cfg == NULL) {
+        return 0;
+    }
+    VariableTypes types;
+    types.names = createVariableTable();
+    types.signedness = NULL;
+    types.capacity = 0;
+    types.typeTable = program->types;
+    for (ArgumentInfo *arg = func->arguments; arg != NULL; arg = arg->next) {
+        declareVariable(&types, arg->name, getTypeSignedness(types.typeTable, arg->type));
+    }
+    for (BasicBlock *block = func->cfg->blocks; block != NULL; block = block->next) {
+        for (int i = 0; i < block->instructionCount; i++) {
+            collectDeclarations(&types, block->instructions[i].otRoot);
+        }
+    }
+
+    uint32_t reducedCount = 0;
+    for (BasicBlock *block = func->cfg->blocks; block != NULL; block = block->next) {
+        for (int i = 0; i < block->instructionCount; i++) {
+            block->instructions[i].otRoot = reduceOperationTree(&types, block->instructions[i].otRoot, &reducedCount);
+        }
+    }
+    free(types.signedness);
+    freeVariableTable(types.names);
+    return reducedCount;
+}
+
+uint32_t reduceProgramStrength(Program *program) {
+    uint32_t reducedCount = 0;
+    for (FunctionInfo *func = program->functions; func != NULL; func = func->next) {
+        reducedCount += reduceFunctionStrength(program, func);
+    }
+    return reducedCount;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "cfg/cfg.h"
+#include <stdint.h>
+
+// multiplications by bigger constants stay multiplications even if they split into two shifts
+#define SHIFT_ADD_LIMIT 64
+
+// Rewrites multiplication by a power of two into a left shift, and unsigned
+// division and modulo by a power of two into a right shift and a mask.
+// Multiplying a variable by a small constant with two set bits, or by a
+// difference of two powers of two, becomes a sum or difference of shifts.
+uint32_t reduceFunctionStrength(Program *program, FunctionInfo *func);
+
+uint32_t reduceProgramStrength(Program *program);
@@ -0,0 +1,484 @@
+#include "valueNumbering.h"
+#include "cfg/hash.h"
+#include "cfg/symbols/symbols.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct ExpressionEntry {
+    const char *op;
+    uint32_t operandStart;     // operand value numbers are operands[operandStart .. operandStart + operandCount)
+    uint32_t operandCount;
+    LiteralKind literalKind;
+    uint64_t literalBits;
+    uint32_t hash;
+    uint32_t valueNumber;
+    BasicBlock *block;
+    int instruction;
+    int32_t holderVariable;
+    uint32_t holderValue;      // SSA value of the holder right after it was assigned
+    int32_t next;              // next entry in the bucket chain
+} ExpressionEntry;
+
+typedef struct NumberingContext {
+    ValueNumbering *numbering;
+    SSAForm *ssa;
+    ExpressionEntry *entries;  // stack, entries of inner dominator tree scopes are on top
+    uint32_t entryCount;
+    uint32_t entryCapacity;
+    uint32_t *operands;
+    uint32_t operandCount;
+    uint32_t operandCapacity;
+    int32_t *buckets;
+    uint32_t bucketCount;
+    uint32_t *current;         // SSA value of every variable at the current point
+    uint32_t *logVariables;    // replaced values of current, restored when a scope is left
+    uint32_t *logValues;
+    uint32_t logCount;
+    uint32_t logCapacity;
+    uint32_t blockIndex;
+    BasicBlock *block;
+    int instruction;
+    AccessMap *accessMap;
+    SymbolTable *symbols;      // a holder is only reused where its declaration is in scope
+    int32_t lastEntry;         // entry of the last numbered expression, -1 for other nodes
+} NumberingContext;
+
+static uint32_t newValueNumber(NumberingContext *ctx) {
+    return ctx->numbering->valueNumberCount++;
+}
+
+static void setCurrentValue(NumberingContext *ctx, uint32_t variable, uint32_t value) {
+    if (ctx->logCount >= ctx->logCapacity) {
+        ctx->logCapacity = ctx->logCapacity == 0 ? INITIAL_CAPACITY : ctx->logCapacity * 2;
+        ctx->logVariables = (uint32_t *)realloc(ctx->logVariables, sizeof(uint32_t) * ctx->logCapacity);
+        ctx->logValues = (uint32_t *)realloc(ctx->logValues, sizeof(uint32_t) * ctx->logCapacity);
+    }
+    ctx->logVariables[ctx->logCount] = variable;
+    ctx->logValues[ctx->logCount] = ctx->current[variable];
+    ctx->logCount++;
+    ctx->current[variable] = value;
+}
+
+// applies the definitions made by the node to the current values, returns the first defined SSA value
+static int32_t applyDefinitions(NumberingContext *ctx, OperationTreeNode *node, uint32_t valueNumber) {
+    int32_t access = findNodeAccess(ctx->accessMap, node);
+    if (access == -1) {
+        return -1;
+    }
+    BlockAccesses *accesses = &ctx->ssa->accesses->blocks[ctx->blockIndex];
+    BlockSSA *blockSSA = &ctx->ssa->blocks[ctx->blockIndex];
+    int32_t first = -1;
+    for (uint32_t i = access; i < accesses->count && accesses->accesses[i].node == node; i++) {
+        if (accesses->accesses[i].kind == ACCESS_USE) {
+            continue;
+        }
+        uint32_t value = blockSSA->accessValues[i];
+        ctx->numbering->ssaValueNumbers[value] = valueNumber != VN_NONE && accesses->accesses[i].kind == ACCESS_DEF ? valueNumber : newValueNumber(ctx);
+        setCurrentValue(ctx, accesses->accesses[i].variable, value);
+        if (first == -1) {
+            first = value;
+        }
+    }
+    return first;
+}
+
+static uint32_t getUsedValueNumber(NumberingContext *ctx, OperationTreeNode *node) {
+    int32_t access = findNodeAccess(ctx->accessMap, node);
+    if (access == -1) {
+        return newValueNumber(ctx);
+    }
+    uint32_t value = ctx->ssa->blocks[ctx->blockIndex].accessValues[access];
+    if (ctx->numbering->ssaValueNumbers[value] == VN_NONE) {
+        ctx->numbering->ssaValueNumbers[value] = newValueNumber(ctx);
+    }
+    return ctx->numbering->ssaValueNumbers[value];
+}
+
+static bool isCommutative(const char *op) {
+    return strcmp(op, PLUS) == 0 || strcmp(op, MUL) == 0 || strcmp(op, OT_AND) == 0;
+}
+
+static uint32_t hashExpression(ExpressionEntry *entry, uint32_t *operands) {
+    uint32_t hash = hashCombine(hashString(entry->op), entry->literalKind);
+    hash = hashCombine(hash, (uint32_t)entry->literalBits);
+    hash = hashCombine(hash, (uint32_t)(entry->literalBits >> 32));
+    for (uint32_t i = 0; i < entry->operandCount; i++) {
+        hash = hashCombine(hash, operands[i]);
+    }
+    return hash;
+}
+
+static int32_t findExpression(NumberingContext *ctx, ExpressionEntry *key, uint32_t *operands) {
+    int32_t index = ctx->buckets[key->hash & (ctx->bucketCount - 1)];
+    while (index != -1) {
+        ExpressionEntry *entry = &ctx->entries[index];
+        if (entry->hash == key->hash && entry->operandCount == key->operandCount &&
+            entry->literalKind == key->literalKind && entry->literalBits == key->literalBits &&
+            strcmp(entry->op, key->op) == 0) {
+            uint32_t i = 0;
+            while (i < key->operandCount && ctx->operands[entry->operandStart + i] == operands[i]) {
+                i++;
+            }
+            if (i == key->operandCount) {
+                return index;
+            }
+        }
+        index = entry->next;
+    }
+    return -1;
+}
+
+static int32_t addExpression(NumberingContext *ctx, ExpressionEntry *key, uint32_t *operands) {
+    if (ctx->entryCount >= ctx->entryCapacity) {
+        ctx->entryCapacity = ctx->entryCapacity == 0 ? INITIAL_CAPACITY : ctx->entryCapacity * 2;
+        ctx->entries = (ExpressionEntry *)realloc(ctx->entries, sizeof(ExpressionEntry) * ctx->entryCapacity);
+    }
+    while (ctx->operandCount + key->operandCount > ctx->operandCapacity) {
+        ctx->operandCapacity = ctx->operandCapacity == 0 ? INITIAL_CAPACITY : ctx->operandCapacity * 2;
+        ctx->operands = (uint32_t *)realloc(ctx->operands, sizeof(uint32_t) * ctx->operandCapacity);
+    }
+    int32_t index = ctx->entryCount++;
+    ExpressionEntry *entry = &ctx->entries[index];
+    *entry = *key;
+    entry->operandStart = ctx->operandCount;
+    for (uint32_t i = 0; i < key->operandCount; i++) {
+        ctx->operands[ctx->operandCount++] = operands[i];
+    }
+    entry->valueNumber = newValueNumber(ctx);
+    entry->block = ctx->block;
+    entry->instruction = ctx->instruction;
+    entry->holderVariable = -1;
+    entry->holderValue = 0;
+    uint32_t bucket = key->hash & (ctx->bucketCount - 1);
+    entry->next = ctx->buckets[bucket];
+    ctx->buckets[bucket] = index;
+    return index;
+}
+
+// entries are always removed in reverse order, so each one is the head of its chain
+static void popExpressions(NumberingContext *ctx, uint32_t entryCount) {
+    while (ctx->entryCount > entryCount) {
+        ExpressionEntry *entry = &ctx->entries[--ctx->entryCount];
+        ctx->buckets[entry->hash & (ctx->bucketCount - 1)] = entry->next;
+        ctx->operandCount = entry->operandStart;
+    }
+}
+
+static void addRedundancy(NumberingContext *ctx, OperationTreeNode **slot, ExpressionEntry *entry, uint32_t mark) {
+    ValueNumbering *numbering = ctx->numbering;
+    const char *holder = NULL;
+    int32_t holderSymbol = -1;
+    VariableTable *variables = ctx->ssa->accesses->variables;
+    if (entry->holderVariable != -1 && ctx->current[entry->holderVariable] == entry->holderValue &&
+        isSymbolVisible(ctx->symbols, variables->names[entry->holderVariable], variables->symbols[entry->holderVariable],
+                        ctx->block->instructions[ctx->instruction].scope)) {
+        holder = variables->names[entry->holderVariable];
+        holderSymbol = variables->symbols[entry->holderVariable];
+        // the outer expression is replaced as a whole, nested ones go away with it
+        numbering->redundancyCount = mark;
+    }
+    if (numbering->redundancyCount >= numbering->redundancyCapacity) {
+        numbering->redundancyCapacity = numbering->redundancyCapacity == 0 ? INITIAL_CAPACITY : numbering->redundancyCapacity * 2;
+        numbering->redundancies = (Redundancy *)realloc(numbering->redundancies, sizeof(Redundancy) * numbering->redundancyCapacity);
+    }
+    Redundancy *redundancy = &numbering->redundancies[numbering->redundancyCount++];
+    redundancy->block = ctx->block;
+    redundancy->instruction = ctx->instruction;
+    redundancy->node = *slot;
+    redundancy->slot = slot;
+    redundancy->availableBlock = entry->block;
+    redundancy->availableInstruction = entry->instruction;
+    redundancy->holder = holder;
+    redundancy->holderSymbol = holderSymbol;
+}
+
+static uint32_t numberNode(NumberingContext *ctx, OperationTreeNode **slot);
+
+static uint32_t numberExpression(NumberingContext *ctx, OperationTreeNode **slot, uint32_t *operands, uint32_t operandCount, uint32_t mark) {
+    OperationTreeNode *node = *slot;
+    ExpressionEntry key;
+    memset(&key, 0, sizeof(ExpressionEntry));
+    key.op = node->label;
+    key.operandCount = operandCount;
+    key.literalKind = LITERAL_NONE;
+    if (operandCount == 2 && isCommutative(node->label) && operands[0] > operands[1]) {
+        uint32_t tmp = operands[0];
+        operands[0] = operands[1];
+        operands[1] = tmp;
+    }
+    key.hash = hashExpression(&key, operands);
+    int32_t found = findExpression(ctx, &key, operands);
+    if (found != -1) {
+        addRedundancy(ctx, slot, &ctx->entries[found], mark);
+    } else {
+        found = addExpression(ctx, &key, operands);
+    }
+    ctx->lastEntry = found;
+    return ctx->entries[found].valueNumber;
+}
+
+static uint32_t numberLiteral(NumberingContext *ctx, OperationTreeNode *node) {
+    ExpressionEntry key;
+    memset(&key, 0, sizeof(ExpressionEntry));
+    key.op = LIT_READ;
+    key.literalKind = node->literal.kind;
+    switch (node->literal.kind) {
+        case LITERAL_INTEGER:
+            key.literalBits = node->literal.integer;
+            break;
+        case LITERAL_BOOL:
+            key.literalBits = node->literal.boolean;
+            break;
+        case LITERAL_CHAR:
+            key.literalBits = (uint8_t)node->literal.symbol;
+            break;
+        case LITERAL_STRING:
+            key.literalBits = node->literal.string.id;
+            break;
+        default:
+            return newValueNumber(ctx);
+    }
+    key.hash = hashExpression(&key, NULL);
+    int32_t found = findExpression(ctx, &key, NULL);
+    if (found == -1) {
+        found = addExpression(ctx, &key, NULL);
+    }
+    return ctx->entries[found].valueNumber;
+}
+
+static uint32_t numberChildren(NumberingContext *ctx, OperationTreeNode *node, uint32_t from) {
+    for (uint32_t i = from; i < node->childCount; i++) {
+        numberNode(ctx, &node->children[i]);
+    }
+    ctx->lastEntry = -1;
+    return newValueNumber(ctx);
+}
+
+// Mirrors the evaluation order of collectOperationTreeAccesses, so uses see the
+// values defined before them in the same instruction
+static uint32_t numberNode(NumberingContext *ctx, OperationTreeNode **slot) {
+    OperationTreeNode *node = *slot;
+    ctx->lastEntry = -1;
+    if (node == NULL) {
+        return VN_NONE;
+    }
+    uint32_t mark = ctx->numbering->redundancyCount;
+
+    if (strcmp(node->label, LIT_READ) == 0) {
+        return numberLiteral(ctx, node);
+    } else if (strcmp(node->label, READ) == 0) {
+        return getUsedValueNumber(ctx, node);
+    } else if (strcmp(node->label, WITH_TYPE) == 0) {
+        return VN_NONE;
+    } else if (strcmp(node->label, WRITE) == 0) {
+        OperationTreeNode *target = node->children[0];
+        uint32_t valueNumber = numberNode(ctx, &node->children[1]);
+        int32_t rhsEntry = ctx->lastEntry;
+        if (target->childCount == 0) {
+            int32_t value = applyDefinitions(ctx, node, valueNumber);
+            ExpressionEntry *entry = rhsEntry != -1 ? &ctx->entries[rhsEntry] : NULL;
+            // an older holder is kept as long as it still has the value
+            if (entry != NULL && value != -1 &&
+                (entry->holderVariable == -1 || ctx->current[entry->holderVariable] != entry->holderValue)) {
+                entry->holderVariable = ctx->ssa->values[value].variable;
+                entry->holderValue = value;
+            }
+        } else if (strcmp(target->label, INDEX) == 0 && target->children[0]->childCount == 0) {
+            numberChildren(ctx, target, 1);
+            applyDefinitions(ctx, node, VN_NONE);
+        } else {
+            numberNode(ctx, &node->children[0]);
+        }
+        ctx->lastEntry = -1;
+        return valueNumber;
+    } else if (strcmp(node->label, DECLARE) == 0) {
+        if (node->childCount == 3) {
+            return numberNode(ctx, &node->children[2]);
+        }
+        applyDefinitions(ctx, node, VN_NONE);
+        return VN_NONE;
+    } else if (strcmp(node->label, OT_CALL) == 0) {
+        numberChildren(ctx, node, node->children[0]->childCount == 0 ? 1 : 0);
+        applyDefinitions(ctx, node, VN_NONE);
+        return newValueNumber(ctx);
+    } else if (strcmp(node->label, INDEX) == 0 || ((isBinaryOp(node->label) || isUnaryOp(node->label)) && node->childCount > 0)) {
+        uint32_t *operands = (uint32_t *)malloc(sizeof(uint32_t) * node->childCount);
+        for (uint32_t i = 0; i < node->childCount; i++) {
+            if (i == 0 && strcmp(node->label, INDEX) == 0 && node->children[0]->childCount == 0) {
+                operands[0] = getUsedValueNumber(ctx, node);
+            } else {
+                operands[i] = numberNode(ctx, &node->children[i]);
+            }
+        }
+        uint32_t valueNumber = numberExpression(ctx, slot, operands, node->childCount, mark);
+        free(operands);
+        return valueNumber;
+    }
+    return numberChildren(ctx, node, 0);
+}
+
+static void numberPhis(NumberingContext *ctx) {
+    BlockSSA *blockSSA = &ctx->ssa->blocks[ctx->blockIndex];
+    uint32_t *valueNumbers = ctx->numbering->ssaValueNumbers;
+    for (uint32_t p = 0; p < blockSSA->phiCount; p++) {
+        PhiNode *phi = &blockSSA->phis[p];
+        // operands coming over back edges are not numbered yet, such phis get a new number
+        uint32_t valueNumber = phi->operandCount > 0 ? valueNumbers[phi->operands[0]] : VN_NONE;
+        for (uint32_t o = 1; o < phi->operandCount && valueNumber != VN_NONE; o++) {
+            if (valueNumbers[phi->operands[o]] != valueNumber) {
+                valueNumber = VN_NONE;
+            }
+        }
+        valueNumbers[phi->value] = valueNumber != VN_NONE ? valueNumber : newValueNumber(ctx);
+        setCurrentValue(ctx, phi->variable, phi->value);
+    }
+}
+
+static void numberBlock(NumberingContext *ctx, BasicBlock *block) {
+    ctx->block = block;
+    ctx->blockIndex = getBlockOrderIndex(ctx->ssa->accesses->order, block);
+    numberPhis(ctx);
+    for (int i = 0; i < block->instructionCount; i++) {
+        ctx->instruction = i;
+        numberNode(ctx, &block->instructions[i].otRoot);
+    }
+}
+
+ValueNumbering* numberValues(CFG *cfg, bool overDominators) {
+    SSAForm *ssa = buildSSA(cfg);
+    if (ssa == NULL) {
+        return NULL;
+    }
+    ValueNumbering *numbering = (ValueNumbering *)malloc(sizeof(ValueNumbering));
+    numbering->ssa = ssa;
+    numbering->overDominators = overDominators;
+    numbering->ssaValueNumbers = (uint32_t *)malloc(sizeof(uint32_t) * (ssa->valueCount + 1));
+    numbering->valueNumberCount = 0;
+    numbering->redundancies = NULL;
+    numbering->redundancyCount = 0;
+    numbering->redundancyCapacity = 0;
+    for (uint32_t v = 0; v < ssa->valueCount; v++) {
+        numbering->ssaValueNumbers[v] = VN_NONE;
+    }
+
+    NumberingContext ctx;
+    memset(&ctx, 0, sizeof(NumberingContext));
+    ctx.numbering = numbering;
+    ctx.ssa = ssa;
+    ctx.accessMap = buildAccessMap(ssa->accesses);
+    ctx.symbols = cfg->symbols;
+    uint32_t variableCount = ssa->accesses->variables->count;
+    ctx.current = (uint32_t *)malloc(sizeof(uint32_t) * (variableCount + 1));
+    for (uint32_t v = 0; v < variableCount; v++) {
+        ctx.current[v] = v;
+        numbering->ssaValueNumbers[v] = numbering->valueNumberCount++;
+    }
+    ctx.bucketCount = 64;
+    while (ctx.bucketCount < ssa->accesses->order->blockCount * 8) {
+        ctx.bucketCount *= 2;
+    }
+    ctx.buckets = (int32_t *)malloc(sizeof(int32_t) * ctx.bucketCount);
+    for (uint32_t i = 0; i < ctx.bucketCount; i++) {
+        ctx.buckets[i] = -1;
+    }
+
+    // expressions of a block stay visible in the blocks it dominates,
+    // the scope of a node is dropped once its subtree is done
+    DominatorTree *tree = ssa->domTree;
+    uint32_t *stackNode = (uint32_t *)malloc(sizeof(uint32_t) * (tree->nodeCount + 1));
+    uint32_t *stackChild = (uint32_t *)malloc(sizeof(uint32_t) * (tree->nodeCount + 1));
+    uint32_t *stackEntries = (uint32_t *)malloc(sizeof(uint32_t) * (tree->nodeCount + 1));
+    uint32_t *stackLog = (uint32_t *)malloc(sizeof(uint32_t) * (tree->nodeCount + 1));
+    int32_t root = getDominatorTreeIndex(tree, cfg->entryBlock);
+    uint32_t stackSize = 1;
+    stackNode[0] = root;
+    stackChild[0] = tree->childOffsets[root];
+    stackEntries[0] = ctx.entryCount;
+    stackLog[0] = ctx.logCount;
+    numberBlock(&ctx, tree->blocks[root]);
+    if (!overDominators) {
+        popExpressions(&ctx, stackEntries[0]);
+    }
+
+    while (stackSize > 0) {
+        uint32_t node = stackNode[stackSize - 1];
+        if (stackChild[stackSize - 1] == tree->childOffsets[node + 1]) {
+            popExpressions(&ctx, stackEntries[stackSize - 1]);
+            while (ctx.logCount > stackLog[stackSize - 1]) {
+                ctx.logCount--;
+                ctx.current[ctx.logVariables[ctx.logCount]] = ctx.logValues[ctx.logCount];
+            }
+            stackSize--;
+            continue;
+        }
+        uint32_t child = tree->children[stackChild[stackSize - 1]++];
+        stackNode[stackSize] = child;
+        stackChild[stackSize] = tree->childOffsets[child];
+        stackEntries[stackSize] = ctx.entryCount;
+        stackLog[stackSize] = ctx.logCount;
+        stackSize++;
+        numberBlock(&ctx, tree->blocks[child]);
+        if (!overDominators) {
+            popExpressions(&ctx, stackEntries[stackSize - 1]);
+        }
+    }
+
+    free(stackNode);
+    free(stackChild);
+    free(stackEntries);
+    free(stackLog);
+    free(ctx.entries);
+    free(ctx.operands);
+    free(ctx.buckets);
+    free(ctx.current);
+    free(ctx.logVariables);
+    free(ctx.logValues);
+    freeAccessMap(ctx.accessMap);
+    return numbering;
+}
+
+void printRedundancies(ValueNumbering *numbering) {
+    char expression[256];
+    printf("Redundant expressions (%u):\n", numbering->redundancyCount);
+    for (uint32_t i = 0; i < numbering->redundancyCount; i++) {
+        Redundancy *redundancy = &numbering->redundancies[i];
+        formatOperationTree(redundancy->node, expression, sizeof(expression));
+        printf("  BB%d:%d %s is computed in BB%d:%d", redundancy->block->id, redundancy->instruction,
+               expression, redundancy->availableBlock->id, redundancy->availableInstruction);
+        if (redundancy->holder != NULL) {
+            printf(", held by %s", redundancy->holder);
+        }
+        printf("\n");
+    }
+    printf("\n");
+}
+
+uint32_t rewriteRedundancies(ValueNumbering *numbering) {
+    uint32_t rewritten = 0;
+    for (uint32_t i = 0; i < numbering->redundancyCount; i++) {
+        Redundancy *redundancy = &numbering->redundancies[i];
+        if (redundancy->holder == NULL) {
+            continue;
+        }
+        OperationTreeNode *node = redundancy->node;
+        OperationTreeNode *readNode = newOperationTreeNode(READ, 1, node->line, node->pos, true);
+        readNode->children[0] = newOperationTreeNode(redundancy->holder, 0, node->line, node->pos, true);
+        readNode->children[0]->symbol = redundancy->holderSymbol;
+        *redundancy->slot = readNode;
+        destroyOperationTreeNodeTree(node);
+        redundancy->node = readNode;
+        rewritten++;
+    }
+    return rewritten;
+}
+
+void freeValueNumbering(ValueNumbering *numbering) {
+    if (numbering == NULL) {
+        return;
+    }
+    free(numbering->ssaValueNumbers);
+    free(numbering->redundancies);
+    freeSSA(numbering->ssa);
+    free(numbering);
+}
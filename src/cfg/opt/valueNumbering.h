@@ -0,0 +1,38 @@
+#pragma once
+
+#include "cfg/cfg.h"
+#include "cfg/ssa/ssa.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define VN_NONE UINT32_MAX
+
+typedef struct Redundancy {
+    BasicBlock *block;
+    int instruction;
+    OperationTreeNode *node;
+    OperationTreeNode **slot;  // where the node hangs, used by the rewrite
+    BasicBlock *availableBlock; // first computation of the same value
+    int availableInstruction;
+    const char *holder;        // variable still holding the value, NULL if it can't be reused
+    int32_t holderSymbol;      // declaration of the holder in the function's symbol table
+} Redundancy;
+
+typedef struct ValueNumbering {
+    SSAForm *ssa;
+    bool overDominators;       // false limits the search to a single block
+    uint32_t *ssaValueNumbers; // value number of every SSA value
+    uint32_t valueNumberCount;
+    Redundancy *redundancies;
+    uint32_t redundancyCount;
+    uint32_t redundancyCapacity;
+} ValueNumbering;
+
+ValueNumbering* numberValues(CFG *cfg, bool overDominators);
+
+void printRedundancies(ValueNumbering *numbering);
+
+// replaces redundant expressions held by a variable with a read of it, the numbering is stale afterwards
+uint32_t rewriteRedundancies(ValueNumbering *numbering);
+
+void freeValueNumbering(ValueNumbering *numbering);
@@ -1,7 +1,10 @@
 #include "ot.h"
 #include "../tokens.h"
 #include <stdint.h>
+#include <stdio.h>
 #include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
 #include <string.h>
 
 OperationTreeNode *newOperationTreeNode(const char *label, uint32_t childCount, uint32_t line, uint32_t pos, bool isImaginary) {
@@ -12,6 +15,9 @@ OperationTreeNode *newOperationTreeNode(const char *label, uint32_t childCount,
   node->line = line;
   node->pos = pos;
   node->isImaginary = isImaginary;
+  node->literal.kind = LITERAL_NONE;
+  node->typeId = TYPE_NONE;
+  node->symbol = -1;
   return node;
 }
 
@@ -27,12 +33,29 @@ void destroyOperationTreeNodeTree(OperationTreeNode *root) {
   free(root);
 }
 
+OperationTreeNode *cloneOperationTree(OperationTreeNode *root) {
+  if (root == NULL) {
+    return NULL;
+  }
+  OperationTreeNode *node = newOperationTreeNode(root->label, root->childCount, root->line, root->pos, root->isImaginary);
+  node->literal = root->literal;
+  node->typeId = root->typeId;
+  node->symbol = root->symbol;
+  for (uint32_t i = 0; i < root->childCount; i++) {
+    node->children[i] = cloneOperationTree(root->children[i]);
+  }
+  return node;
+}
+
 bool isBinaryOp(const char *label) {
   return strcmp(label, PLUS) == 0 |
           strcmp(label, MINUS) == 0 |
           strcmp(label, MUL) == 0 |
           strcmp(label, DIV) == 0 |
-          strcmp(label, MOD) == 0;
+          strcmp(label, MOD) == 0 |
+          strcmp(label, OT_SHL) == 0 |
+          strcmp(label, OT_SHR) == 0 |
+          strcmp(label, OT_AND) == 0;
 }
 
 bool isUnaryOp(const char *label) {
@@ -49,6 +72,114 @@ bool isLiteral(const char *label) {
           strcmp(label, DEC) == 0;
 }
 
+static void setIntegerLiteral(LiteralValue *value, uint64_t integer, uint8_t width, bool isSigned) {
+  value->kind = LITERAL_INTEGER;
+  value->width = width;
+  value->isSigned = isSigned;
+  value->integer = integer;
+}
+
+static char decodeEscape(char escaped) {
+  switch (escaped) {
+    case 'n':
+      return '\n';
+    case 't':
+      return '\t';
+    case 'r':
+      return '\r';
+    case '0':
+      return '\0';
+    default:
+      return escaped;
+  }
+}
+
+// Integer literals get the first of int, uint, long, ulong that holds the value,
+// decimal ones skip uint like in C
+bool parseLiteralValue(const char *type, const char *text, StringPool *strings, LiteralValue *value) {
+  value->kind = LITERAL_NONE;
+  if (strcmp(type, BOOL) == 0) {
+    value->kind = LITERAL_BOOL;
+    value->boolean = strcmp(text, "true") == 0;
+    return true;
+  }
+  if (strcmp(type, SYMB) == 0) {
+    value->kind = LITERAL_CHAR;
+    value->symbol = text[0] == '\'' ? text[1] : text[0];
+    return true;
+  }
+  if (strcmp(type, STR) == 0) {
+    if (strings == NULL) {
+      return false;
+    }
+    size_t length = strlen(text);
+    if (length >= 2 && text[0] == '"') {
+      text++;
+      length -= 2;
+    }
+    char *decoded = (char *)malloc(length + 1);
+    uint32_t decodedLength = 0;
+    for (size_t i = 0; i < length; i++) {
+      if (text[i] == '\\' && i + 1 < length) {
+        decoded[decodedLength++] = decodeEscape(text[++i]);
+      } else {
+        decoded[decodedLength++] = text[i];
+      }
+    }
+    value->kind = LITERAL_STRING;
+    value->string.id = internString(strings, decoded, decodedLength);
+    value->string.data = getPooledString(strings, value->string.id, &value->string.length);
+    free(decoded);
+    return true;
+  }
+
+  bool negative = false;
+  int base = 10;
+  if (strcmp(type, DEC) == 0) {
+    // folded constants may be negative
+    if (text[0] == '-') {
+      negative = true;
+      text++;
+    }
+  } else if (strcmp(type, HEX) == 0) {
+    base = 16;
+  } else if (strcmp(type, BITS) == 0) {
+    base = 2;
+    text += 2;
+  } else {
+    return false;
+  }
+
+  errno = 0;
+  char *end = NULL;
+  unsigned long long parsed = strtoull(text, &end, base);
+  if (errno == ERANGE || end == text || *end != '\0') {
+    return false;
+  }
+  if (negative) {
+    if (parsed > (uint64_t)INT64_MAX + 1) {
+      return false;
+    }
+    setIntegerLiteral(value, (uint64_t)0 - parsed, parsed <= (uint64_t)INT32_MAX + 1 ? 32 : 64, true);
+  } else if (parsed <= INT32_MAX) {
+    setIntegerLiteral(value, parsed, 32, true);
+  } else if (base != 10 && parsed <= UINT32_MAX) {
+    setIntegerLiteral(value, parsed, 32, false);
+  } else if (parsed <= INT64_MAX) {
+    setIntegerLiteral(value, parsed, 64, true);
+  } else {
+    setIntegerLiteral(value, parsed, 64, false);
+  }
+  return true;
+}
+
+// only calls by plain name end up in the call graph
+static void recordCallSite(OperationTreeErrorContainer *container, OperationTreeNode *callNode) {
+  if (container->calls != NULL && callNode->children[0]->childCount == 0) {
+    addCallSite(container->calls, callNode->children[0]->label, callNode->line, callNode->pos);
+  }
+}
+
 OperationTreeNode *buildExprOperationTreeFromAstNode(MyAstNode* root, bool isLvalue, bool isFunctionName, OperationTreeErrorContainer *container, const char* filename) {
   if (strcmp(root->label, ASSIGN) == 0) {
     //left - EXPR
@@ -70,6 +201,7 @@ OperationTreeNode *buildExprOperationTreeFromAstNode(MyAstNode* root, bool isLva
       OperationTreeNode *funcNameNode = buildExprOperationTreeFromAstNode(root->children[1], false, true, container, filename);
       OperationTreeNode *callNode = newOperationTreeNode(OT_CALL, 1 + root->children[0]->childCount, funcNameNode->line, funcNameNode->pos, funcNameNode->isImaginary);
       callNode->children[0] = funcNameNode;
+      recordCallSite(container, callNode);
       for (uint32_t i = 0; i < root->children[0]->childCount; i++) {
         OperationTreeNode *argNode = buildExprOperationTreeFromAstNode(root->children[0]->children[i], false, false, container, filename);
         callNode->children[1 + i] = argNode;
@@ -91,6 +223,7 @@ OperationTreeNode *buildExprOperationTreeFromAstNode(MyAstNode* root, bool isLva
       OperationTreeNode *funcNameNode = buildExprOperationTreeFromAstNode(root->children[0], false, true, container, filename);
       OperationTreeNode *callNode = newOperationTreeNode(OT_CALL, 1, funcNameNode->line, funcNameNode->pos, funcNameNode->isImaginary);
       callNode->children[0] = funcNameNode;
+      recordCallSite(container, callNode);
       if (isLvalue) {
         char buffer[1024];
         snprintf(buffer, sizeof(buffer),
@@ -231,101 +364,47 @@ OperationTreeNode *buildExprOperationTreeFromAstNode(MyAstNode* root, bool isLva
     OperationTreeNode *litReadNode = newOperationTreeNode(LIT_READ, 2, root->children[0]->line, root->children[0]->pos, true);
     litReadNode->children[0] = literalTypeNode;
     litReadNode->children[1] = literalValueNode;
+    parseLiteralValue(literalTypeNode->label, literalValueNode->label, container->strings, &litReadNode->literal);
     return litReadNode;
   } else {
     return NULL;
   }      
 }
 
-OperationTreeNode *buildTyperefHelper(OperationTreeErrorContainer *container, TypeInfo* varType, const char* filename) {
-  OperationTreeNode *withTypeNode = newOperationTreeNode(WITH_TYPE, varType->isArray ? 3 : 2, 0, 0, true);
-  if (varType->isArray) {
-    withTypeNode->children[0] = newOperationTreeNode(varType->typeName, 0, varType->line, varType->pos, false);
-    withTypeNode->children[1] = newOperationTreeNode(varType->custom ? CUSTOM : BUILTIN, 0, varType->line, varType->pos, false);
-
-    if (varType->next != NULL) {
-      withTypeNode->children[2] = newOperationTreeNode(OT_ARRAY, 2, varType->line, varType->pos, false);
-      char buffer[12];
-      snprintf(buffer, sizeof(buffer), "%u", varType->arrayDim);
-      withTypeNode->children[2]->children[0] = newOperationTreeNode(buffer, 0, varType->line, varType->pos, false); 
-
-      withTypeNode->children[2]->children[1] = buildTyperefHelper(container, varType->next, filename);
-
-    } else {
-      withTypeNode->children[2] = newOperationTreeNode(OT_ARRAY, 1, varType->line, varType->pos, false);
-      char buffer[12];
-      snprintf(buffer, sizeof(buffer), "%u", varType->arrayDim);
-      withTypeNode->children[2]->children[0] = newOperationTreeNode(buffer, 0, varType->line, varType->pos, false);
-    }
-  } else {
-    withTypeNode->children[0] = newOperationTreeNode(varType->typeName, 0, varType->line, varType->pos, false);
-    withTypeNode->children[1] = newOperationTreeNode(varType->custom ? CUSTOM : BUILTIN, 0, varType->line, varType->pos, false);
-  }
+OperationTreeNode *newWithTypeNode(uint32_t type, uint32_t line, uint32_t pos) {
+  OperationTreeNode *withTypeNode = newOperationTreeNode(WITH_TYPE, 0, line, pos, true);
+  withTypeNode->typeId = type;
   return withTypeNode;
 }
 
-OperationTreeNode *buildVarDeclareHelper(MyAstNode* id, MyAstNode* init, OperationTreeErrorContainer *container, TypeInfo* varType, const char* filename) {
+OperationTreeNode *buildVarDeclareHelper(MyAstNode* id, MyAstNode* init, OperationTreeErrorContainer *container, uint32_t varType, MyAstNode* typeRef, const char* filename) {
   OperationTreeNode *declareNode;
-  OperationTreeNode *withTypeNode = newOperationTreeNode(WITH_TYPE, varType->isArray ? 3 : 2, 0, 0, true);
-  if (varType->isArray) {
-    OperationTreeNode *varNameNode = newOperationTreeNode(id->children[0]->label, 0, id->children[0]->line, id->children[0]->pos, false);
-    withTypeNode->children[0] = newOperationTreeNode(varType->typeName, 0, varType->line, varType->pos, false);
-    withTypeNode->children[1] = newOperationTreeNode(varType->custom ? CUSTOM : BUILTIN, 0, varType->line, varType->pos, false);
-
-    if (varType->next != NULL) {
-      withTypeNode->children[2] = newOperationTreeNode(OT_ARRAY, 2, varType->line, varType->pos, false);
-      char buffer[12];
-      snprintf(buffer, sizeof(buffer), "%u", varType->arrayDim);
-      withTypeNode->children[2]->children[0] = newOperationTreeNode(buffer, 0, varType->line, varType->pos, false); 
-
-      withTypeNode->children[2]->children[1] = buildTyperefHelper(container, varType->next, filename);
-
-    } else {
-      withTypeNode->children[2] = newOperationTreeNode(OT_ARRAY, 1, varType->line, varType->pos, false);
-      char buffer[12];
-      snprintf(buffer, sizeof(buffer), "%u", varType->arrayDim);
-      withTypeNode->children[2]->children[0] = newOperationTreeNode(buffer, 0, varType->line, varType->pos, false);
-    }
-    assert(strcmp(init->children[0]->label, id->children[0]->label) == 0);
-    OperationTreeNode *varInitExprNode;
-    if (init->childCount == 2) {
-      varInitExprNode = buildExprOperationTreeFromAstNode(init->children[1], false, false, container, filename);
-      OperationTreeNode *helperNode = newOperationTreeNode(WRITE, 2, id->children[0]->line, id->children[0]->pos, false);
-      helperNode->children[0] = newOperationTreeNode(id->children[0]->label, 0, id->children[0]->line, id->children[0]->pos, false);
-      helperNode->children[1] = varInitExprNode;
-      declareNode = newOperationTreeNode(DECLARE, 3, 0, 0, true);
-      declareNode->children[0] = withTypeNode;
-      declareNode->children[1] = varNameNode;
-      declareNode->children[2] = helperNode;
-    } else {
-      declareNode = newOperationTreeNode(DECLARE, 2, 0, 0, true);
-      declareNode->children[0] = withTypeNode;
-      declareNode->children[1] = varNameNode;
-    }
+  MyAstNode* typeName = typeRef->children[0]->children[0];
+  OperationTreeNode *withTypeNode = newWithTypeNode(varType, typeName->line, typeName->pos);
+  OperationTreeNode *varNameNode = newOperationTreeNode(id->children[0]->label, 0, id->children[0]->line, id->children[0]->pos, false);
+  // array declarations have always been placed at 0:0, diagnostics citing them depend on it
+  bool isArray = typeRef->childCount > 1;
+  uint32_t line = isArray ? 0 : id->children[0]->line;
+  uint32_t pos = isArray ? 0 : id->children[0]->pos;
+  assert(strcmp(init->children[0]->label, id->children[0]->label) == 0);
+  if (init->childCount == 2) {
+    OperationTreeNode *varInitExprNode = buildExprOperationTreeFromAstNode(init->children[1], false, false, container, filename);
+    OperationTreeNode *helperNode = newOperationTreeNode(WRITE, 2, id->children[0]->line, id->children[0]->pos, false);
+    helperNode->children[0] = newOperationTreeNode(id->children[0]->label, 0, id->children[0]->line, id->children[0]->pos, false);
+    helperNode->children[1] = varInitExprNode;
+    declareNode = newOperationTreeNode(DECLARE, 3, line, pos, true);
+    declareNode->children[0] = withTypeNode;
+    declareNode->children[1] = varNameNode;
+    declareNode->children[2] = helperNode;
   } else {
-    OperationTreeNode *varNameNode = newOperationTreeNode(id->children[0]->label, 0, id->children[0]->line, id->children[0]->pos, false);
-    withTypeNode->children[0] = newOperationTreeNode(varType->typeName, 0, varType->line, varType->pos, false);
-    withTypeNode->children[1] = newOperationTreeNode(varType->custom ? CUSTOM : BUILTIN, 0, varType->line, varType->pos, false);
-    OperationTreeNode *varInitExprNode;
-    if (init->childCount == 2) {
-      varInitExprNode = buildExprOperationTreeFromAstNode(init->children[1], false, false, container, filename);
-      OperationTreeNode *helperNode = newOperationTreeNode(WRITE, 2, id->children[0]->line, id->children[0]->pos, false);
-      helperNode->children[0] = newOperationTreeNode(id->children[0]->label, 0, id->children[0]->line, id->children[0]->pos, false);
-      helperNode->children[1] = varInitExprNode;
-      declareNode = newOperationTreeNode(DECLARE, 3, id->children[0]->line, id->children[0]->pos, true);
-      declareNode->children[0] = withTypeNode;
-      declareNode->children[1] = varNameNode;
-      declareNode->children[2] = helperNode;
-    } else {
-      declareNode = newOperationTreeNode(DECLARE, 2, id->children[0]->line, id->children[0]->pos, true);
-      declareNode->children[0] = withTypeNode;
-      declareNode->children[1] = varNameNode;
-    }
+    declareNode = newOperationTreeNode(DECLARE, 2, line, pos, true);
+    declareNode->children[0] = withTypeNode;
+    declareNode->children[1] = varNameNode;
   }
   return declareNode;
 }
 
-OperationTreeNode *buildVarOperationTreeFromAstNode(MyAstNode* root, OperationTreeErrorContainer *container, TypeInfo* varType, const char* filename) {
+OperationTreeNode *buildVarOperationTreeFromAstNode(MyAstNode* root, OperationTreeErrorContainer *container, uint32_t varType, const char* filename) {
   assert(strcmp(root->children[0]->label, TYPEREF) == 0);
 
   uint32_t varCount = (root->childCount - 1) / 2;
@@ -333,12 +412,12 @@ OperationTreeNode *buildVarOperationTreeFromAstNode(MyAstNode* root, OperationTr
   OperationTreeNode *varNode;
   if (varCount == 1) {
     //use DECLARE node
-    varNode = buildVarDeclareHelper(root->children[1], root->children[2], container, varType, filename);
+    varNode = buildVarDeclareHelper(root->children[1], root->children[2], container, varType, root->children[0], filename);
   } else {
     //use SEQ_DECLARE with childern type DECLARE
     varNode = newOperationTreeNode(SEQ_DECLARE, varCount, 0, 0, true);
     for (uint32_t i = 0; i < varCount; i++) {
-      varNode->children[i] = buildVarDeclareHelper(root->children[i + 1], root->children[i + 1 + varCount], container, varType, filename);
+      varNode->children[i] = buildVarDeclareHelper(root->children[i + 1], root->children[i + 1 + varCount], container, varType, root->children[0], filename);
     }
   }
   return varNode;
@@ -362,6 +441,68 @@ void printOperationTree(OperationTreeNode* root) {
     printOperationTreeHelper(root, 0);
 }
 
+static void appendText(char *buffer, size_t size, size_t *length, const char *text) {
+  if (*length < size) {
+    *length += snprintf(buffer + *length, size - *length, "%s", text);
+  }
+}
+
+static void formatOperationTreeHelper(OperationTreeNode *node, char *buffer, size_t size, size_t *length) {
+  if (node == NULL) {
+    return;
+  }
+  if (node->childCount == 0) {
+    appendText(buffer, size, length, node->label);
+  } else if (strcmp(node->label, READ) == 0) {
+    formatOperationTreeHelper(node->children[0], buffer, size, length);
+  } else if (strcmp(node->label, LIT_READ) == 0) {
+    formatOperationTreeHelper(node->children[1], buffer, size, length);
+  } else if (isBinaryOp(node->label) && node->childCount == 2) {
+    appendText(buffer, size, length, "(");
+    formatOperationTreeHelper(node->children[0], buffer, size, length);
+    appendText(buffer, size, length, " ");
+    appendText(buffer, size, length, node->label);
+    appendText(buffer, size, length, " ");
+    formatOperationTreeHelper(node->children[1], buffer, size, length);
+    appendText(buffer, size, length, ")");
+  } else if (isUnaryOp(node->label)) {
+    appendText(buffer, size, length, strcmp(node->label, NEG) == 0 ? "-" : "!");
+    formatOperationTreeHelper(node->children[0], buffer, size, length);
+  } else if (strcmp(node->label, INDEX) == 0 || strcmp(node->label, OT_CALL) == 0) {
+    bool isIndex = strcmp(node->label, INDEX) == 0;
+    formatOperationTreeHelper(node->children[0], buffer, size, length);
+    appendText(buffer, size, length, isIndex ? "[" : "(");
+    for (uint32_t i = 1; i < node->childCount; i++) {
+      if (i > 1) {
+        appendText(buffer, size, length, ", ");
+      }
+      formatOperationTreeHelper(node->children[i], buffer, size, length);
+    }
+    appendText(buffer, size, length, isIndex ? "]" : ")");
+  } else if (strcmp(node->label, WRITE) == 0) {
+    formatOperationTreeHelper(node->children[0], buffer, size, length);
+    appendText(buffer, size, length, " = ");
+    formatOperationTreeHelper(node->children[1], buffer, size, length);
+  } else {
+    appendText(buffer, size, length, node->label);
+    appendText(buffer, size, length, "(");
+    for (uint32_t i = 0; i < node->childCount; i++) {
+      if (i > 0) {
+        appendText(buffer, size, length, ", ");
+      }
+      formatOperationTreeHelper(node->children[i], buffer, size, length);
+    }
+    appendText(buffer, size, length, ")");
+  }
+}
+
+// Source-like one line text of the tree for reports, truncated to the buffer size
+void formatOperationTree(OperationTreeNode *node, char *buffer, size_t size) {
+  size_t length = 0;
+  buffer[0] = '\0';
+  formatOperationTreeHelper(node, buffer, size, &length);
+}
+
 OperationTreeErrorInfo* createOperationTreeErrorInfo(const char *message) {
     OperationTreeErrorInfo *errorInfo = (OperationTreeErrorInfo*)malloc(sizeof(OperationTreeErrorInfo));
     errorInfo->message = strdup(message);
@@ -389,4 +530,43 @@ void freeOperationTreeErrors(OperationTreeErrorInfo *error) {
     free(error);
     error = nextError;
   }
-}
\ No newline at end of file
+}
+
+CallSiteList *createCallSiteList() {
+  CallSiteList *list = (CallSiteList *)malloc(sizeof(CallSiteList));
+  list->count = 0;
+  list->capacity = 4;
+  list->sites = (CallSite *)malloc(sizeof(CallSite) * list->capacity);
+  list->stale = false;
+  return list;
+}
+
+void addCallSite(CallSiteList *list, const char *callee, uint32_t line, uint32_t pos) {
+  if (list->count >= list->capacity) {
+    list->capacity *= 2;
+    list->sites = (CallSite *)realloc(list->sites, sizeof(CallSite) * list->capacity);
+  }
+  CallSite *site = &list->sites[list->count++];
+  site->callee = strdup(callee);
+  site->block = -1;
+  site->instruction = 0;
+  site->line = line;
+  site->pos = pos;
+}
+
+void clearCallSites(CallSiteList *list) {
+  for (uint32_t i = 0; i < list->count; i++) {
+    free(list->sites[i].callee);
+  }
+  list->count = 0;
+  list->stale = false;
+}
+
+void freeCallSiteList(CallSiteList *list) {
+  if (list == NULL) {
+    return;
+  }
+  clearCallSites(list);
+  free(list->sites);
+  free(list);
+}
@@ -1,7 +1,10 @@
 #pragma once
 
 #include "grammar/ast/myAst.h"
+#include "stringPool.h"
+#include "typeTable.h"
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #define LIT_READ "litRead"
@@ -17,6 +20,34 @@
 #define OT_ARRAY "array"
 #define RETURN "return"
 #define OT_BREAK "break"
+// produced by strength reduction only, the parser has no such operators
+#define OT_SHL "<<"
+#define OT_SHR ">>"
+#define OT_AND "&"
+
+typedef enum {
+  LITERAL_NONE,
+  LITERAL_INTEGER,
+  LITERAL_BOOL,
+  LITERAL_CHAR,
+  LITERAL_STRING
+} LiteralKind;
+
+typedef struct LiteralValue {
+  LiteralKind kind;
+  uint8_t width;               // 32 or 64 for integers
+  bool isSigned;
+  union {
+    uint64_t integer;          // sign extended for signed integers
+    bool boolean;
+    char symbol;
+    struct {
+      uint32_t id;             // id in the string pool
+      uint32_t length;
+      const char *data;        // decoded, owned by the string pool
+    } string;
+  };
+} LiteralValue;
 
 typedef struct OperationTreeNode {
   struct OperationTreeNode **children;
@@ -25,49 +56,74 @@ typedef struct OperationTreeNode {
   uint32_t line;
   uint32_t pos;
   bool isImaginary;
+  LiteralValue literal;        // parsed value of litRead nodes, LITERAL_NONE for other nodes
+  uint32_t typeId;             // type of withType leaves in the program type table, TYPE_NONE for other nodes
+  int32_t symbol;              // declaration a variable leaf resolves to in its function's symbol table, -1 if none
 } OperationTreeNode;
 
-typedef struct TypeInfo TypeInfo;
-
-typedef struct TypeInfo {
-    char *typeName;
-    bool custom;
-    bool isArray;
-    uint32_t arrayDim;
-    uint32_t line;
-    uint32_t pos;
-    TypeInfo *next;
-} TypeInfo;
-
 typedef struct __attribute__((packed)) OperationTreeErrorInfo {
     char *message;
     struct OperationTreeErrorInfo *next;
 } OperationTreeErrorInfo;
 
+typedef struct CallSite {
+  char *callee;
+  int block;                   // id of the block holding the call, -1 until its instruction is added
+  uint32_t instruction;        // index of the instruction in the block
+  uint32_t line;
+  uint32_t pos;
+} CallSite;
+
+typedef struct CallSiteList {
+  CallSite *sites;             // in the order the operation trees were built
+  uint32_t count;
+  uint32_t capacity;
+  bool stale;                  // a pass moved or removed instructions, blocks and indexes have to be collected again
+} CallSiteList;
+
 typedef struct OperationTreeErrorContainer {
     struct OperationTreeErrorInfo *error;
+    StringPool *strings;
+    CallSiteList *calls;       // calls built into the tree are recorded here, NULL to skip them
 } OperationTreeErrorContainer;
 
 OperationTreeNode *newOperationTreeNode(const char *label, uint32_t childCount, uint32_t line, uint32_t pos, bool isImaginary);
 
-OperationTreeNode *buildVarOperationTreeFromAstNode(MyAstNode* root, OperationTreeErrorContainer *container, TypeInfo* varType, const char* filename);
+OperationTreeNode *buildVarOperationTreeFromAstNode(MyAstNode* root, OperationTreeErrorContainer *container, uint32_t varType, const char* filename);
+
+uint32_t parseTyperef(TypeTable *types, MyAstNode* typeRef);
 
-TypeInfo* parseTyperef(MyAstNode* typeRef);
+// withType leaf of a declaration, the type is referenced by id instead of being spelled out in children
+OperationTreeNode *newWithTypeNode(uint32_t type, uint32_t line, uint32_t pos);
 
 void destroyOperationTreeNodeTree(OperationTreeNode *root);
 
+OperationTreeNode *cloneOperationTree(OperationTreeNode *root);
+
 OperationTreeNode *buildExprOperationTreeFromAstNode(MyAstNode* root, bool isLvalue, bool isFunctionName, OperationTreeErrorContainer *error, const char* filename);
 
 void printOperationTree(OperationTreeNode *root);
 
+void formatOperationTree(OperationTreeNode *node, char *buffer, size_t size);
+
 OperationTreeErrorInfo* createOperationTreeErrorInfo(const char *message);
 
 void addOperationTreeError(OperationTreeErrorContainer *container, const char *message);
 
 void freeOperationTreeErrors(OperationTreeErrorInfo *error);
 
+CallSiteList *createCallSiteList();
+
+void addCallSite(CallSiteList *list, const char *callee, uint32_t line, uint32_t pos);
+
+void clearCallSites(CallSiteList *list);
+
+void freeCallSiteList(CallSiteList *list);
+
 bool isBinaryOp(const char *label);
 
 bool isUnaryOp(const char *label);
 
-bool isLiteral(const char *label);
\ No newline at end of file
+bool isLiteral(const char *label);
+
+bool parseLiteralValue(const char *type, const char *text, StringPool *strings, LiteralValue *value);
\ No newline at end of file
@@ -0,0 +1,85 @@
+#include "stringPool.h"
+#include "../hash.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define STRING_POOL_INITIAL_CAPACITY 16
+
+StringPool *createStringPool() {
+  StringPool *pool = (StringPool *)malloc(sizeof(StringPool));
+  pool->count = 0;
+  pool->capacity = STRING_POOL_INITIAL_CAPACITY;
+  pool->strings = (char **)malloc(sizeof(char *) * pool->capacity);
+  pool->lengths = (uint32_t *)malloc(sizeof(uint32_t) * pool->capacity);
+  pool->bucketCount = STRING_POOL_INITIAL_CAPACITY * 2;
+  pool->buckets = (int32_t *)malloc(sizeof(int32_t) * pool->bucketCount);
+  for (uint32_t i = 0; i < pool->bucketCount; i++) {
+    pool->buckets[i] = -1;
+  }
+  return pool;
+}
+
+static void placeString(StringPool *pool, uint32_t id) {
+  uint32_t slot = hashBytes(pool->strings[id], pool->lengths[id]) & (pool->bucketCount - 1);
+  while (pool->buckets[slot] != -1) {
+    slot = (slot + 1) & (pool->bucketCount - 1);
+  }
+  pool->buckets[slot] = id;
+}
+
+uint32_t internString(StringPool *pool, const char *data, uint32_t length) {
+  uint32_t slot = hashBytes(data, length) & (pool->bucketCount - 1);
+  while (pool->buckets[slot] != -1) {
+    uint32_t id = pool->buckets[slot];
+    if (pool->lengths[id] == length && memcmp(pool->strings[id], data, length) == 0) {
+      return id;
+    }
+    slot = (slot + 1) & (pool->bucketCount - 1);
+  }
+
+  if (pool->count >= pool->capacity) {
+    pool->capacity *= 2;
+    pool->strings = (char **)realloc(pool->strings, sizeof(char *) * pool->capacity);
+    pool->lengths = (uint32_t *)realloc(pool->lengths, sizeof(uint32_t) * pool->capacity);
+  }
+  uint32_t id = pool->count++;
+  pool->strings[id] = (char *)malloc(length + 1);
+  memcpy(pool->strings[id], data, length);
+  pool->strings[id][length] = '\0';
+  pool->lengths[id] = length;
+
+  if (pool->count * 2 > pool->bucketCount) {
+    free(pool->buckets);
+    pool->bucketCount *= 2;
+    pool->buckets = (int32_t *)malloc(sizeof(int32_t) * pool->bucketCount);
+    for (uint32_t i = 0; i < pool->bucketCount; i++) {
+      pool->buckets[i] = -1;
+    }
+    for (uint32_t i = 0; i < pool->count; i++) {
+      placeString(pool, i);
+    }
+  } else {
+    pool->buckets[slot] = id;
+  }
+  return id;
+}
+
+const char *getPooledString(StringPool *pool, uint32_t id, uint32_t *length) {
+  if (length != NULL) {
+    *length = pool->lengths[id];
+  }
+  return pool->strings[id];
+}
+
+void freeStringPool(StringPool *pool) {
+  if (pool == NULL) {
+    return;
+  }
+  for (uint32_t i = 0; i < pool->count; i++) {
+    free(pool->strings[i]);
+  }
+  free(pool->strings);
+  free(pool->lengths);
+  free(pool->buckets);
+  free(pool);
+}
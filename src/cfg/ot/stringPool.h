@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdint.h>
+
+// Decoded string literals of the whole program, every distinct string is stored once
+typedef struct StringPool {
+  char **strings;              // NUL terminated, may also contain NUL inside
+  uint32_t *lengths;
+  uint32_t count;
+  uint32_t capacity;
+  int32_t *buckets;
+  uint32_t bucketCount;
+} StringPool;
+
+StringPool *createStringPool();
+
+uint32_t internString(StringPool *pool, const char *data, uint32_t length);
+
+const char *getPooledString(StringPool *pool, uint32_t id, uint32_t *length);
+
+void freeStringPool(StringPool *pool);
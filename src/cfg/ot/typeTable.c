@@ -0,0 +1,111 @@
+#include "typeTable.h"
+#include "../hash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TYPE_TABLE_INITIAL_CAPACITY 16
+
+static uint32_t hashType(const char *name, bool custom, bool isArray, uint32_t arrayDim, uint32_t element) {
+  uint32_t hash = hashString(name);
+  hash = hashCombine(hash, (uint32_t)custom | (uint32_t)isArray << 1);
+  hash = hashCombine(hash, arrayDim);
+  return hashCombine(hash, element);
+}
+
+static void placeType(TypeTable *table, uint32_t id) {
+  TypeEntry *type = &table->types[id];
+  uint32_t slot = hashType(type->name, type->custom, type->isArray, type->arrayDim, type->element) & (table->bucketCount - 1);
+  while (table->buckets[slot] != -1) {
+    slot = (slot + 1) & (table->bucketCount - 1);
+  }
+  table->buckets[slot] = id;
+}
+
+TypeTable *createTypeTable() {
+  TypeTable *table = (TypeTable *)malloc(sizeof(TypeTable));
+  table->count = 0;
+  table->capacity = TYPE_TABLE_INITIAL_CAPACITY;
+  table->types = (TypeEntry *)malloc(sizeof(TypeEntry) * table->capacity);
+  table->bucketCount = TYPE_TABLE_INITIAL_CAPACITY * 2;
+  table->buckets = (int32_t *)malloc(sizeof(int32_t) * table->bucketCount);
+  for (uint32_t i = 0; i < table->bucketCount; i++) {
+    table->buckets[i] = -1;
+  }
+  table->voidType = internType(table, "void", false, false, 0, TYPE_NONE);
+  return table;
+}
+
+uint32_t internType(TypeTable *table, const char *name, bool custom, bool isArray, uint32_t arrayDim, uint32_t element) {
+  uint32_t slot = hashType(name, custom, isArray, arrayDim, element) & (table->bucketCount - 1);
+  while (table->buckets[slot] != -1) {
+    TypeEntry *type = &table->types[table->buckets[slot]];
+    if (type->custom == custom && type->isArray == isArray && type->arrayDim == arrayDim &&
+        type->element == element && strcmp(type->name, name) == 0) {
+      return table->buckets[slot];
+    }
+    slot = (slot + 1) & (table->bucketCount - 1);
+  }
+
+  if (table->count >= table->capacity) {
+    table->capacity *= 2;
+    table->types = (TypeEntry *)realloc(table->types, sizeof(TypeEntry) * table->capacity);
+  }
+  uint32_t id = table->count++;
+  TypeEntry *type = &table->types[id];
+  type->name = strdup(name);
+  type->custom = custom;
+  type->isArray = isArray;
+  type->arrayDim = arrayDim;
+  type->element = element;
+
+  if (table->count * 2 > table->bucketCount) {
+    free(table->buckets);
+    table->bucketCount *= 2;
+    table->buckets = (int32_t *)malloc(sizeof(int32_t) * table->bucketCount);
+    for (uint32_t i = 0; i < table->bucketCount; i++) {
+      table->buckets[i] = -1;
+    }
+    for (uint32_t i = 0; i < table->count; i++) {
+      placeType(table, i);
+    }
+  } else {
+    table->buckets[slot] = id;
+  }
+  return id;
+}
+
+const TypeEntry *getType(TypeTable *table, uint32_t id) {
+  return &table->types[id];
+}
+
+void formatType(TypeTable *table, uint32_t id, char *buffer, size_t size) {
+  size_t length = 0;
+  buffer[0] = '\0';
+  while (id != TYPE_NONE && length < size) {
+    TypeEntry *type = &table->types[id];
+    length += snprintf(buffer + length, size - length, "%s%s", length > 0 ? " " : "", type->name);
+    if (type->isArray && length < size) {
+      length += snprintf(buffer + length, size - length, "[");
+      for (uint32_t i = 1; i < type->arrayDim && length < size; i++) {
+        length += snprintf(buffer + length, size - length, ",");
+      }
+      if (length < size) {
+        length += snprintf(buffer + length, size - length, "]");
+      }
+    }
+    id = type->element;
+  }
+}
+
+void freeTypeTable(TypeTable *table) {
+  if (table == NULL) {
+    return;
+  }
+  for (uint32_t i = 0; i < table->count; i++) {
+    free(table->types[i].name);
+  }
+  free(table->types);
+  free(table->buckets);
+  free(table);
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define TYPE_NONE UINT32_MAX
+
+typedef struct TypeEntry {
+  char *name;                  // base type name
+  bool custom;
+  bool isArray;
+  uint32_t arrayDim;
+  uint32_t element;            // id of the type following the array dimensions, TYPE_NONE if there is none
+} TypeEntry;
+
+// Types of the whole program, every distinct type is stored once and referenced by id,
+// so two types are equal exactly when their ids are
+typedef struct TypeTable {
+  TypeEntry *types;
+  uint32_t count;
+  uint32_t capacity;
+  int32_t *buckets;
+  uint32_t bucketCount;
+  uint32_t voidType;           // interned up front, the return type of functions declared without one
+} TypeTable;
+
+TypeTable *createTypeTable();
+
+uint32_t internType(TypeTable *table, const char *name, bool custom, bool isArray, uint32_t arrayDim, uint32_t element);
+
+// valid until the next type is interned
+const TypeEntry *getType(TypeTable *table, uint32_t id);
+
+// source-like text of the type, e.g. int[,] for a two dimensional array
+void formatType(TypeTable *table, uint32_t id, char *buffer, size_t size);
+
+void freeTypeTable(TypeTable *table);
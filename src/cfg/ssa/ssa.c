@@ -0,0 +1,434 @@
+#include "ssa.h"
+#include "cfg/dataflow/bitset.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t addSSAValue(SSAForm *ssa, uint32_t variable, uint32_t version, SSAValueKind kind, uint32_t block, uint32_t index) {
+    if (ssa->valueCount >= ssa->valueCapacity) {
+        ssa->valueCapacity = ssa->valueCapacity == 0 ? INITIAL_CAPACITY : ssa->valueCapacity * 2;
+        ssa->values = (SSAValue *)realloc(ssa->values, sizeof(SSAValue) * ssa->valueCapacity);
+    }
+    SSAValue *value = &ssa->values[ssa->valueCount];
+    value->variable = variable;
+    value->version = version;
+    value->kind = kind;
+    value->block = block;
+    value->index = index;
+    return ssa->valueCount++;
+}
+
+static void addPhi(BlockSSA *block, uint32_t variable, uint32_t operandCount) {
+    if (block->phiCount >= block->phiCapacity) {
+        block->phiCapacity = block->phiCapacity == 0 ? INITIAL_CAPACITY : block->phiCapacity * 2;
+        block->phis = (PhiNode *)realloc(block->phis, sizeof(PhiNode) * block->phiCapacity);
+    }
+    PhiNode *phi = &block->phis[block->phiCount++];
+    phi->variable = variable;
+    phi->value = 0;
+    phi->operandCount = operandCount;
+    phi->operands = (uint32_t *)calloc(operandCount + 1, sizeof(uint32_t));
+}
+
+// Liveness where partial definitions also read the variable, they update the old value
+static DataflowResult* computeSSALiveness(FunctionAccesses *accesses) {
+    BlockOrder *order = accesses->order;
+    DataflowResult *liveness = createDataflowResult(order->blockCount, accesses->variables->count, DATAFLOW_BACKWARD, DATAFLOW_UNION);
+    for (uint32_t b = 0; b < order->blockCount; b++) {
+        uint64_t *gen = getDataflowRow(liveness, liveness->gen, b);
+        uint64_t *kill = getDataflowRow(liveness, liveness->kill, b);
+        BlockAccesses *blockAccesses = &accesses->blocks[b];
+        for (uint32_t i = 0; i < blockAccesses->count; i++) {
+            VarAccess *access = &blockAccesses->accesses[i];
+            if (isFullDefinition(access->kind)) {
+                setBit(kill, access->variable);
+            } else if (!testBit(kill, access->variable)) {
+                setBit(gen, access->variable);
+            }
+        }
+    }
+    solveDataflow(liveness, order, NULL);
+    return liveness;
+}
+
+// Pruned SSA: phis go to the iterated dominance frontier of the definitions,
+// only where the variable is live on entry
+static void placePhis(SSAForm *ssa) {
+    FunctionAccesses *accesses = ssa->accesses;
+    BlockOrder *order = accesses->order;
+    DominatorTree *tree = ssa->domTree;
+    uint32_t blockCount = order->blockCount;
+    uint32_t variableCount = accesses->variables->count;
+
+    // blocks defining each variable, every block listed once per variable
+    uint32_t *defOffsets = (uint32_t *)calloc(variableCount + 1, sizeof(uint32_t));
+    uint32_t *defBlocks = NULL;
+    uint32_t *fill = (uint32_t *)malloc(sizeof(uint32_t) * (variableCount + 1));
+    int32_t *lastBlock = (int32_t *)malloc(sizeof(int32_t) * (variableCount + 1));
+    for (int pass = 0; pass < 2; pass++) {
+        for (uint32_t v = 0; v < variableCount; v++) {
+            lastBlock[v] = -1;
+        }
+        for (uint32_t b = 0; b < blockCount; b++) {
+            BlockAccesses *blockAccesses = &accesses->blocks[b];
+            for (uint32_t i = 0; i < blockAccesses->count; i++) {
+                VarAccess *access = &blockAccesses->accesses[i];
+                if (access->kind == ACCESS_USE || lastBlock[access->variable] == (int32_t)b) {
+                    continue;
+                }
+                lastBlock[access->variable] = b;
+                if (pass == 0) {
+                    defOffsets[access->variable + 1]++;
+                } else {
+                    defBlocks[fill[access->variable]++] = b;
+                }
+            }
+        }
+        if (pass == 0) {
+            for (uint32_t v = 0; v < variableCount; v++) {
+                defOffsets[v + 1] += defOffsets[v];
+            }
+            memcpy(fill, defOffsets, sizeof(uint32_t) * (variableCount + 1));
+            defBlocks = (uint32_t *)malloc(sizeof(uint32_t) * (defOffsets[variableCount] + 1));
+        }
+    }
+    free(lastBlock);
+    free(fill);
+
+    DominanceFrontier *frontier = computeDominanceFrontier(tree);
+    DataflowResult *liveness = computeSSALiveness(accesses);
+    int32_t *hasPhi = (int32_t *)malloc(sizeof(int32_t) * (blockCount + 1));
+    int32_t *queued = (int32_t *)malloc(sizeof(int32_t) * (blockCount + 1));
+    uint32_t *worklist = (uint32_t *)malloc(sizeof(uint32_t) * (blockCount + 1));
+    for (uint32_t b = 0; b < blockCount; b++) {
+        hasPhi[b] = -1;
+        queued[b] = -1;
+    }
+
+    for (uint32_t v = 0; v < variableCount; v++) {
+        uint32_t size = 0;
+        for (uint32_t i = defOffsets[v]; i < defOffsets[v + 1]; i++) {
+            queued[defBlocks[i]] = v;
+            worklist[size++] = defBlocks[i];
+        }
+        while (size > 0) {
+            uint32_t b = worklist[--size];
+            int32_t node = getDominatorTreeIndex(tree, order->blocks[b]);
+            for (uint32_t f = frontier->offsets[node]; f < frontier->offsets[node + 1]; f++) {
+                int32_t target = getBlockOrderIndex(order, tree->blocks[frontier->nodes[f]]);
+                if (hasPhi[target] == (int32_t)v) {
+                    continue;
+                }
+                hasPhi[target] = v;
+                if (testBit(getDataflowRow(liveness, liveness->in, target), v)) {
+                    addPhi(&ssa->blocks[target], v, order->predOffsets[target + 1] - order->predOffsets[target]);
+                }
+                if (queued[target] != (int32_t)v) {
+                    queued[target] = v;
+                    worklist[size++] = target;
+                }
+            }
+        }
+    }
+
+    free(worklist);
+    free(queued);
+    free(hasPhi);
+    freeDataflowResult(liveness);
+    freeDominanceFrontier(frontier);
+    free(defBlocks);
+    free(defOffsets);
+}
+
+typedef struct RenameLog {
+    uint32_t *variables;
+    uint32_t *values;
+    uint32_t count;
+    uint32_t capacity;
+} RenameLog;
+
+static void defineValue(RenameLog *log, uint32_t *current, uint32_t variable, uint32_t value) {
+    if (log->count >= log->capacity) {
+        log->capacity = log->capacity == 0 ? INITIAL_CAPACITY : log->capacity * 2;
+        log->variables = (uint32_t *)realloc(log->variables, sizeof(uint32_t) * log->capacity);
+        log->values = (uint32_t *)realloc(log->values, sizeof(uint32_t) * log->capacity);
+    }
+    log->variables[log->count] = variable;
+    log->values[log->count] = current[variable];
+    log->count++;
+    current[variable] = value;
+}
+
+static void renameBlock(SSAForm *ssa, uint32_t b, RenameLog *log, uint32_t *current, uint32_t *versions) {
+    BlockOrder *order = ssa->accesses->order;
+    BlockSSA *blockSSA = &ssa->blocks[b];
+    for (uint32_t p = 0; p < blockSSA->phiCount; p++) {
+        PhiNode *phi = &blockSSA->phis[p];
+        phi->value = addSSAValue(ssa, phi->variable, ++versions[phi->variable], SSA_PHI_VALUE, b, p);
+        defineValue(log, current, phi->variable, phi->value);
+    }
+
+    BlockAccesses *blockAccesses = &ssa->accesses->blocks[b];
+    for (uint32_t i = 0; i < blockAccesses->count; i++) {
+        VarAccess *access = &blockAccesses->accesses[i];
+        blockSSA->previousValues[i] = current[access->variable];
+        if (access->kind == ACCESS_USE) {
+            blockSSA->accessValues[i] = current[access->variable];
+        } else {
+            uint32_t value = addSSAValue(ssa, access->variable, ++versions[access->variable], SSA_ACCESS_VALUE, b, i);
+            blockSSA->accessValues[i] = value;
+            defineValue(log, current, access->variable, value);
+        }
+    }
+
+    for (uint32_t e = order->succOffsets[b]; e < order->succOffsets[b + 1]; e++) {
+        uint32_t succ = order->succs[e];
+        BlockSSA *succSSA = &ssa->blocks[succ];
+        for (uint32_t p = order->predOffsets[succ]; p < order->predOffsets[succ + 1]; p++) {
+            if (order->preds[p] != b) {
+                continue;
+            }
+            for (uint32_t i = 0; i < succSSA->phiCount; i++) {
+                succSSA->phis[i].operands[p - order->predOffsets[succ]] = current[succSSA->phis[i].variable];
+            }
+        }
+    }
+}
+
+// Walks the dominator tree iteratively, the log keeps replaced values so that
+// leaving a subtree restores the names visible in its parent
+static void renameVariables(SSAForm *ssa, CFG *cfg) {
+    DominatorTree *tree = ssa->domTree;
+    BlockOrder *order = ssa->accesses->order;
+    uint32_t variableCount = ssa->accesses->variables->count;
+
+    uint32_t *current = (uint32_t *)malloc(sizeof(uint32_t) * (variableCount + 1));
+    uint32_t *versions = (uint32_t *)calloc(variableCount + 1, sizeof(uint32_t));
+    for (uint32_t v = 0; v < variableCount; v++) {
+        current[v] = v;
+    }
+    RenameLog log = { NULL, NULL, 0, 0 };
+
+    uint32_t *stackNode = (uint32_t *)malloc(sizeof(uint32_t) * (tree->nodeCount + 1));
+    uint32_t *stackChild = (uint32_t *)malloc(sizeof(uint32_t) * (tree->nodeCount + 1));
+    uint32_t *stackMark = (uint32_t *)malloc(sizeof(uint32_t) * (tree->nodeCount + 1));
+    uint32_t stackSize = 0;
+
+    int32_t root = getDominatorTreeIndex(tree, cfg->entryBlock);
+    stackNode[0] = root;
+    stackChild[0] = tree->childOffsets[root];
+    stackMark[0] = log.count;
+    stackSize = 1;
+    renameBlock(ssa, getBlockOrderIndex(order, tree->blocks[root]), &log, current, versions);
+
+    while (stackSize > 0) {
+        uint32_t node = stackNode[stackSize - 1];
+        if (stackChild[stackSize - 1] == tree->childOffsets[node + 1]) {
+            while (log.count > stackMark[stackSize - 1]) {
+                log.count--;
+                current[log.variables[log.count]] = log.values[log.count];
+            }
+            stackSize--;
+            continue;
+        }
+        uint32_t child = tree->children[stackChild[stackSize - 1]++];
+        stackNode[stackSize] = child;
+        stackChild[stackSize] = tree->childOffsets[child];
+        stackMark[stackSize] = log.count;
+        stackSize++;
+        renameBlock(ssa, getBlockOrderIndex(order, tree->blocks[child]), &log, current, versions);
+    }
+
+    free(stackNode);
+    free(stackChild);
+    free(stackMark);
+    free(log.variables);
+    free(log.values);
+    free(versions);
+    free(current);
+}
+
+static void addUse(SSAForm *ssa, uint32_t *fill, uint32_t value, SSAUseKind kind, uint32_t block, uint32_t index, uint32_t operand) {
+    if (fill == NULL) {
+        ssa->useOffsets[value + 1]++;
+        return;
+    }
+    SSAUse *use = &ssa->uses[fill[value]++];
+    use->kind = kind;
+    use->block = block;
+    use->index = index;
+    use->operand = operand;
+}
+
+static void buildUseChains(SSAForm *ssa) {
+    uint32_t blockCount = ssa->accesses->order->blockCount;
+    ssa->useOffsets = (uint32_t *)calloc(ssa->valueCount + 1, sizeof(uint32_t));
+    uint32_t *fill = NULL;
+    for (int pass = 0; pass < 2; pass++) {
+        for (uint32_t b = 0; b < blockCount; b++) {
+            BlockSSA *blockSSA = &ssa->blocks[b];
+            for (uint32_t p = 0; p < blockSSA->phiCount; p++) {
+                PhiNode *phi = &blockSSA->phis[p];
+                for (uint32_t o = 0; o < phi->operandCount; o++) {
+                    addUse(ssa, fill, phi->operands[o], SSA_USE_PHI, b, p, o);
+                }
+            }
+            BlockAccesses *blockAccesses = &ssa->accesses->blocks[b];
+            for (uint32_t i = 0; i < blockAccesses->count; i++) {
+                if (blockAccesses->accesses[i].kind == ACCESS_USE) {
+                    addUse(ssa, fill, blockSSA->accessValues[i], SSA_USE_ACCESS, b, i, 0);
+                } else if (blockAccesses->accesses[i].kind == ACCESS_PARTIAL_DEF) {
+                    addUse(ssa, fill, blockSSA->previousValues[i], SSA_USE_ACCESS, b, i, 0);
+                }
+            }
+        }
+        if (pass == 0) {
+            for (uint32_t v = 0; v < ssa->valueCount; v++) {
+                ssa->useOffsets[v + 1] += ssa->useOffsets[v];
+            }
+            ssa->uses = (SSAUse *)malloc(sizeof(SSAUse) * (ssa->useOffsets[ssa->valueCount] + 1));
+            fill = (uint32_t *)malloc(sizeof(uint32_t) * (ssa->valueCount + 1));
+            memcpy(fill, ssa->useOffsets, sizeof(uint32_t) * (ssa->valueCount + 1));
+        }
+    }
+    free(fill);
+}
+
+SSAForm* buildSSA(CFG *cfg) {
+    if (cfg == NULL || cfg->entryBlock == NULL) {
+        return NULL;
+    }
+    SSAForm *ssa = (SSAForm *)malloc(sizeof(SSAForm));
+    ssa->accesses = collectFunctionAccesses(cfg);
+    ssa->domTree = buildDominatorTree(cfg);
+    ssa->values = NULL;
+    ssa->valueCount = 0;
+    ssa->valueCapacity = 0;
+    ssa->useOffsets = NULL;
+    ssa->uses = NULL;
+
+    uint32_t blockCount = ssa->accesses->order->blockCount;
+    ssa->blocks = (BlockSSA *)calloc(blockCount + 1, sizeof(BlockSSA));
+    for (uint32_t b = 0; b < blockCount; b++) {
+        uint32_t count = ssa->accesses->blocks[b].count;
+        ssa->blocks[b].accessValues = (uint32_t *)malloc(sizeof(uint32_t) * (count + 1));
+        ssa->blocks[b].previousValues = (uint32_t *)malloc(sizeof(uint32_t) * (count + 1));
+    }
+    for (uint32_t v = 0; v < ssa->accesses->variables->count; v++) {
+        addSSAValue(ssa, v, 0, SSA_ENTRY_VALUE, 0, 0);
+    }
+
+    placePhis(ssa);
+    renameVariables(ssa, cfg);
+    buildUseChains(ssa);
+    return ssa;
+}
+
+BlockSSA* getBlockSSA(SSAForm *ssa, BasicBlock *block) {
+    int32_t index = getBlockOrderIndex(ssa->accesses->order, block);
+    return index == -1 ? NULL : &ssa->blocks[index];
+}
+
+void formatSSAValue(SSAForm *ssa, uint32_t value, char *buffer, size_t size) {
+    SSAValue *ssaValue = &ssa->values[value];
+    snprintf(buffer, size, "%s_%u", ssa->accesses->variables->names[ssaValue->variable], ssaValue->version);
+}
+
+static void appendValue(SSAForm *ssa, uint32_t value, char *buffer, size_t size, size_t *length) {
+    char name[128];
+    formatSSAValue(ssa, value, name, sizeof(name));
+    if (*length < size) {
+        *length += snprintf(buffer + *length, size - *length, "%s%s", *length == 0 ? "" : ", ", name);
+    }
+}
+
+void formatSSAPhi(SSAForm *ssa, PhiNode *phi, char *buffer, size_t size) {
+    size_t length = 0;
+    char operands[512] = "";
+    for (uint32_t o = 0; o < phi->operandCount; o++) {
+        appendValue(ssa, phi->operands[o], operands, sizeof(operands), &length);
+    }
+    char name[128];
+    formatSSAValue(ssa, phi->value, name, sizeof(name));
+    snprintf(buffer, size, "%s = phi(%s)", name, operands);
+}
+
+bool formatSSAInstruction(SSAForm *ssa, BasicBlock *block, int instruction, char *buffer, size_t size) {
+    int32_t b = getBlockOrderIndex(ssa->accesses->order, block);
+    buffer[0] = '\0';
+    if (b == -1) {
+        return false;
+    }
+    BlockAccesses *blockAccesses = &ssa->accesses->blocks[b];
+    BlockSSA *blockSSA = &ssa->blocks[b];
+    char uses[512] = "";
+    char defs[512] = "";
+    size_t usesLength = 0;
+    size_t defsLength = 0;
+    for (uint32_t i = 0; i < blockAccesses->count; i++) {
+        VarAccess *access = &blockAccesses->accesses[i];
+        if (access->instruction != (uint32_t)instruction) {
+            continue;
+        }
+        if (access->kind == ACCESS_USE) {
+            appendValue(ssa, blockSSA->accessValues[i], uses, sizeof(uses), &usesLength);
+            continue;
+        }
+        if (access->kind == ACCESS_PARTIAL_DEF) {
+            appendValue(ssa, blockSSA->previousValues[i], uses, sizeof(uses), &usesLength);
+        }
+        appendValue(ssa, blockSSA->accessValues[i], defs, sizeof(defs), &defsLength);
+    }
+    if (usesLength == 0 && defsLength == 0) {
+        return false;
+    }
+    if (defsLength == 0) {
+        snprintf(buffer, size, "uses %s", uses);
+    } else if (usesLength == 0) {
+        snprintf(buffer, size, "defs %s", defs);
+    } else {
+        snprintf(buffer, size, "defs %s; uses %s", defs, uses);
+    }
+    return true;
+}
+
+void printSSA(SSAForm *ssa) {
+    BlockOrder *order = ssa->accesses->order;
+    char line[1024];
+    printf("SSA form (%u values):\n", ssa->valueCount);
+    for (uint32_t b = 0; b < order->blockCount; b++) {
+        BasicBlock *block = order->blocks[b];
+        printf("  BB%d:\n", block->id);
+        for (uint32_t p = 0; p < ssa->blocks[b].phiCount; p++) {
+            formatSSAPhi(ssa, &ssa->blocks[b].phis[p], line, sizeof(line));
+            printf("    %s\n", line);
+        }
+        for (int i = 0; i < block->instructionCount; i++) {
+            if (formatSSAInstruction(ssa, block, i, line, sizeof(line))) {
+                printf("    %d: %s\n", i, line);
+            }
+        }
+    }
+    printf("\n");
+}
+
+void freeSSA(SSAForm *ssa) {
+    if (ssa == NULL) {
+        return;
+    }
+    for (uint32_t b = 0; b < ssa->accesses->order->blockCount; b++) {
+        for (uint32_t p = 0; p < ssa->blocks[b].phiCount; p++) {
+            free(ssa->blocks[b].phis[p].operands);
+        }
+        free(ssa->blocks[b].phis);
+        free(ssa->blocks[b].accessValues);
+        free(ssa->blocks[b].previousValues);
+    }
+    free(ssa->blocks);
+    free(ssa->values);
+    free(ssa->useOffsets);
+    free(ssa->uses);
+    freeDominatorTree(ssa->domTree);
+    freeFunctionAccesses(ssa->accesses);
+    free(ssa);
+}
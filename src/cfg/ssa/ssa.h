@@ -0,0 +1,76 @@
+#pragma once
+
+#include "cfg/cfg.h"
+#include "cfg/dataflow/access.h"
+#include "cfg/dom/dom.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+    SSA_ENTRY_VALUE,           // value on function entry: argument or not yet initialized variable
+    SSA_ACCESS_VALUE,          // created by a write, declaration or partial definition
+    SSA_PHI_VALUE
+} SSAValueKind;
+
+typedef struct SSAValue {
+    uint32_t variable;
+    uint32_t version;          // 0 for entry values, then numbered in dominator tree preorder
+    SSAValueKind kind;
+    uint32_t block;            // BlockOrder index of the defining block, unused for entry values
+    uint32_t index;            // access index in the block or phi index
+} SSAValue;
+
+typedef struct PhiNode {
+    uint32_t variable;
+    uint32_t value;
+    uint32_t *operands;        // one value per predecessor, ordered like the BlockOrder preds of the block
+    uint32_t operandCount;
+} PhiNode;
+
+typedef enum {
+    SSA_USE_ACCESS,            // read, or the old value updated by a partial definition
+    SSA_USE_PHI
+} SSAUseKind;
+
+typedef struct SSAUse {
+    SSAUseKind kind;
+    uint32_t block;
+    uint32_t index;            // access index or phi index
+    uint32_t operand;          // operand position for phi uses
+} SSAUse;
+
+typedef struct BlockSSA {
+    PhiNode *phis;
+    uint32_t phiCount;
+    uint32_t phiCapacity;
+    uint32_t *accessValues;    // per access: value read by uses, value created by definitions
+    uint32_t *previousValues;  // per access: value live right before the access, updated by partial definitions
+} BlockSSA;
+
+// Side table over the CFG, instructions and operation trees are left untouched
+typedef struct SSAForm {
+    FunctionAccesses *accesses;
+    DominatorTree *domTree;
+    BlockSSA *blocks;          // indexed like accesses->order->blocks
+    SSAValue *values;          // first variables->count values are the entry values
+    uint32_t valueCount;
+    uint32_t valueCapacity;
+    uint32_t *useOffsets;      // uses of value v are uses[useOffsets[v] .. useOffsets[v + 1])
+    SSAUse *uses;
+} SSAForm;
+
+SSAForm* buildSSA(CFG *cfg);
+
+BlockSSA* getBlockSSA(SSAForm *ssa, BasicBlock *block);
+
+void formatSSAValue(SSAForm *ssa, uint32_t value, char *buffer, size_t size);
+
+void formatSSAPhi(SSAForm *ssa, PhiNode *phi, char *buffer, size_t size);
+
+// false if the instruction doesn't touch any variable
+bool formatSSAInstruction(SSAForm *ssa, BasicBlock *block, int instruction, char *buffer, size_t size);
+
+void printSSA(SSAForm *ssa);
+
+void freeSSA(SSAForm *ssa);
@@ -0,0 +1,556 @@
+#include "summary.h"
+#include "cfg/cg/scc.h"
+#include "cfg/loops/loops.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// set next to SUMMARY_WRITTEN while evaluating, elements of the array in the variable were written
+#define SUMMARY_ELEMENTS 4
+
+typedef struct SummaryCall {
+    int32_t callee;            // call graph node, CG_NO_NODE for calls through expressions
+    uint32_t depth;            // loop depth of the calling block
+    uint32_t argumentCount;
+    int32_t *arguments;        // variable passed as is at every position, -1 for other expressions
+} SummaryCall;
+
+typedef struct SummaryTask {
+    FunctionInfo *info;        // NULL for callees without a definition
+    uint8_t *localEffects;     // effects of the function's own instructions
+    uint8_t *effects;          // scratch row for an evaluation
+    int32_t *argumentVariables; // argument in declaration order -> variable, -1 if never accessed
+    uint32_t variableCount;    // variables of the function's accesses, one per declaration
+    uint32_t *summaryVariables; // variable -> entry of the summary, declarations sharing a name share it
+    uint32_t *aliases;         // variable -> representative of the variables that may hold the same array
+    SummaryCall *calls;
+    uint32_t callCount;
+    uint32_t callCapacity;
+    bool unboundedDepth;       // a call back into the component sits inside a loop
+} SummaryTask;
+
+typedef struct SummaryContext {
+    CallGraph *cg;
+    CallGraphSCC *scc;
+    SummaryTask *tasks;        // indexed by call graph node
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    uint32_t *queue;           // components whose callees are all done
+    uint32_t head;
+    uint32_t tail;
+    uint32_t *pendingCallees;  // per component, callee components not done yet
+    uint32_t remaining;
+} SummaryContext;
+
+static void addSummaryCall(SummaryContext *ctx, SummaryTask *task, OperationTreeNode *call, uint32_t depth, VariableTable *variables) {
+    if (task->callCount >= task->callCapacity) {
+        task->callCapacity = task->callCapacity == 0 ? 4 : task->callCapacity * 2;
+        task->calls = (SummaryCall *)realloc(task->calls, sizeof(SummaryCall) * task->callCapacity);
+    }
+    SummaryCall *entry = &task->calls[task->callCount++];
+    entry->callee = call->children[0]->childCount == 0 ? findFunction(ctx->cg, call->children[0]->label) : CG_NO_NODE;
+    entry->depth = depth;
+    entry->argumentCount = call->childCount - 1;
+    entry->arguments = (int32_t *)malloc(sizeof(int32_t) * (entry->argumentCount + 1));
+    for (uint32_t i = 0; i < entry->argumentCount; i++) {
+        OperationTreeNode *argument = call->children[i + 1];
+        entry->arguments[i] = strcmp(argument->label, READ) == 0 ? findLeafVariable(variables, argument->children[0]) : -1;
+    }
+}
+
+static void collectSummaryCalls(SummaryContext *ctx, SummaryTask *task, OperationTreeNode *node, uint32_t depth, VariableTable *variables) {
+    if (node == NULL) {
+        return;
+    }
+    // a variable named like the call label is a leaf
+    if (strcmp(node->label, OT_CALL) == 0 && node->childCount >= 1) {
+        addSummaryCall(ctx, task, node, depth, variables);
+    }
+    for (uint32_t i = 0; i < node->childCount; i++) {
+        collectSummaryCalls(ctx, task, node->children[i], depth, variables);
+    }
+}
+
+static uint32_t findAlias(uint32_t *aliases, uint32_t variable) {
+    while (aliases[variable] != variable) {
+        aliases[variable] = aliases[aliases[variable]];
+        variable = aliases[variable];
+    }
+    return variable;
+}
+
+// joins the target with every variable the value reads, an array copied, indexed out of
+// another or returned by a call may be any of them
+static void joinValueAliases(uint32_t *aliases, VariableTable *variables, uint32_t target, OperationTreeNode *value) {
+    if (value == NULL) {
+        return;
+    }
+    OperationTreeNode *leaf = NULL;
+    if (strcmp(value->label, READ) == 0 || (strcmp(value->label, INDEX) == 0 && value->children[0]->childCount == 0)) {
+        leaf = value->children[0];
+    }
+    if (leaf != NULL) {
+        int32_t variable = findLeafVariable(variables, leaf);
+        if (variable != -1) {
+            aliases[findAlias(aliases, (uint32_t)variable)] = findAlias(aliases, target);
+        }
+    }
+    for (uint32_t i = 0; i < value->childCount; i++) {
+        joinValueAliases(aliases, variables, target, value->children[i]);
+    }
+}
+
+static void collectSummaryAliases(uint32_t *aliases, VariableTable *variables, OperationTreeNode *node) {
+    if (node == NULL) {
+        return;
+    }
+    if (strcmp(node->label, WRITE) == 0 && node->children[0]->childCount == 0) {
+        int32_t target = findLeafVariable(variables, node->children[0]);
+        if (target != -1) {
+            joinValueAliases(aliases, variables, (uint32_t)target, node->children[1]);
+        }
+    }
+    for (uint32_t i = 0; i < node->childCount; i++) {
+        collectSummaryAliases(aliases, variables, node->children[i]);
+    }
+}
+
+// the part of the summary that doesn't depend on callees
+static void prepareSummary(SummaryContext *ctx, uint32_t node) {
+    SummaryTask *task = &ctx->tasks[node];
+    CFG *cfg = task->info->cfg;
+    FunctionAccesses *accesses = collectFunctionAccesses(cfg);
+    VariableTable *variables = accesses->variables;
+    uint32_t variableCount = variables->count;
+    task->localEffects = (uint8_t *)calloc(variableCount + 1, sizeof(uint8_t));
+    task->effects = (uint8_t *)malloc(sizeof(uint8_t) * (variableCount + 1));
+
+    FunctionSummary *summary = (FunctionSummary *)malloc(sizeof(FunctionSummary));
+    summary->variables = createVariableTable();
+    summary->effects = (uint8_t *)calloc(variableCount + 1, sizeof(uint8_t));
+    summary->loopDepth = 0;
+    summary->callsOut = false;
+    summary->callsUnknown = false;
+    summary->component = ctx->scc->componentOf[node];
+    summary->passes = 0;
+    summary->purity = PURITY_PURE;
+    task->variableCount = variableCount;
+    task->summaryVariables = (uint32_t *)malloc(sizeof(uint32_t) * (variableCount + 1));
+    for (uint32_t v = 0; v < variableCount; v++) {
+        task->summaryVariables[v] = internVariable(summary->variables, variables->names[v]);
+    }
+    task->aliases = (uint32_t *)malloc(sizeof(uint32_t) * (variableCount + 1));
+    for (uint32_t v = 0; v < variableCount; v++) {
+        task->aliases[v] = v;
+    }
+
+    for (uint32_t b = 0; b < accesses->order->blockCount; b++) {
+        BasicBlock *block = accesses->order->blocks[b];
+        BlockAccesses *blockAccesses = &accesses->blocks[b];
+        for (uint32_t a = 0; a < blockAccesses->count; a++) {
+            VarAccess *access = &blockAccesses->accesses[a];
+            if (access->kind == ACCESS_USE) {
+                task->localEffects[access->variable] |= SUMMARY_READ;
+            } else if (access->kind != ACCESS_PARTIAL_DEF) {
+                task->localEffects[access->variable] |= SUMMARY_WRITTEN;
+            } else if (strcmp(access->node->label, OT_CALL) != 0) {
+                task->localEffects[access->variable] |= SUMMARY_WRITTEN | SUMMARY_ELEMENTS;
+            }
+            // arrays passed to calls get their effects from the callee
+        }
+        uint32_t depth = cfg->loops != NULL ? getLoopDepth(cfg->loops, block) : 0;
+        if (depth > summary->loopDepth) {
+            summary->loopDepth = depth;
+        }
+        for (int i = 0; i < block->instructionCount; i++) {
+            collectSummaryCalls(ctx, task, block->instructions[i].otRoot, depth, variables);
+            collectSummaryAliases(task->aliases, variables, block->instructions[i].otRoot);
+        }
+    }
+    summary->callsOut = task->callCount > 0;
+    summary->callDepth = summary->loopDepth;
+
+    uint32_t argumentCount = 0;
+    for (ArgumentInfo *arg = task->info->arguments; arg != NULL; arg = arg->next) {
+        argumentCount++;
+    }
+    summary->argumentCount = argumentCount;
+    summary->argumentEffects = (uint8_t *)calloc(argumentCount + 1, sizeof(uint8_t));
+    task->argumentVariables = (int32_t *)malloc(sizeof(int32_t) * (argumentCount + 1));
+    // the list is in reverse declaration order
+    uint32_t position = argumentCount;
+    for (ArgumentInfo *arg = task->info->arguments; arg != NULL; arg = arg->next) {
+        task->argumentVariables[--position] = findDeclaredVariable(variables, arg->name, arg->symbol);
+    }
+
+    task->info->summary = summary;
+    freeFunctionAccesses(accesses);
+}
+
+static FunctionSummary* getCalleeSummary(SummaryContext *ctx, SummaryCall *call) {
+    if (call->callee == CG_NO_NODE || ctx->tasks[call->callee].info == NULL) {
+        return NULL;
+    }
+    return ctx->tasks[call->callee].info->summary;
+}
+
+// returns true if the summary changed
+static bool evaluateSummary(SummaryContext *ctx, uint32_t node) {
+    SummaryTask *task = &ctx->tasks[node];
+    FunctionSummary *summary = task->info->summary;
+    uint32_t variableCount = task->variableCount;
+    memcpy(task->effects, task->localEffects, sizeof(uint8_t) * variableCount);
+    bool callsUnknown = false;
+    uint32_t callDepth = summary->loopDepth;
+    for (uint32_t c = 0; c < task->callCount; c++) {
+        SummaryCall *call = &task->calls[c];
+        FunctionSummary *callee = getCalleeSummary(ctx, call);
+        if (callee == NULL) {
+            callsUnknown = true;
+        } else {
+            callsUnknown = callsUnknown || callee->callsUnknown;
+            uint32_t depth = callee->callDepth == SUMMARY_UNBOUNDED_DEPTH ? SUMMARY_UNBOUNDED_DEPTH : call->depth + callee->callDepth;
+            if (depth > callDepth) {
+                callDepth = depth;
+            }
+        }
+        for (uint32_t i = 0; i < call->argumentCount; i++) {
+            if (call->arguments[i] == -1) {
+                continue;
+            }
+            uint8_t effect = callee != NULL && i < callee->argumentCount ? callee->argumentEffects[i] : SUMMARY_READ | SUMMARY_WRITTEN;
+            task->effects[call->arguments[i]] |= effect & SUMMARY_READ;
+            if (effect & SUMMARY_WRITTEN) {
+                task->effects[call->arguments[i]] |= SUMMARY_WRITTEN | SUMMARY_ELEMENTS;
+            }
+        }
+    }
+    if (task->unboundedDepth) {
+        callDepth = SUMMARY_UNBOUNDED_DEPTH;
+    }
+    // element writes through a variable reach every variable that may hold the same array
+    for (uint32_t v = 0; v < variableCount; v++) {
+        if (task->effects[v] & SUMMARY_ELEMENTS) {
+            task->effects[findAlias(task->aliases, v)] |= SUMMARY_ELEMENTS;
+        }
+    }
+    for (uint32_t v = 0; v < variableCount; v++) {
+        if (task->effects[findAlias(task->aliases, v)] & SUMMARY_ELEMENTS) {
+            task->effects[v] |= SUMMARY_WRITTEN | SUMMARY_ELEMENTS;
+        }
+    }
+
+    bool changed = callsUnknown != summary->callsUnknown || callDepth != summary->callDepth;
+    summary->callsUnknown = callsUnknown;
+    summary->callDepth = callDepth;
+    uint8_t *effects = (uint8_t *)calloc(summary->variables->count + 1, sizeof(uint8_t));
+    for (uint32_t v = 0; v < variableCount; v++) {
+        effects[task->summaryVariables[v]] |= task->effects[v] & (SUMMARY_READ | SUMMARY_WRITTEN);
+    }
+    for (uint32_t v = 0; v < summary->variables->count; v++) {
+        changed = changed || effects[v] != summary->effects[v];
+        summary->effects[v] = effects[v];
+    }
+    free(effects);
+    for (uint32_t p = 0; p < summary->argumentCount; p++) {
+        int32_t variable = task->argumentVariables[p];
+        uint8_t effect = 0;
+        if (variable != -1) {
+            effect = (task->effects[variable] & SUMMARY_READ) | (task->effects[variable] & SUMMARY_ELEMENTS ? SUMMARY_WRITTEN : 0);
+        }
+        changed = changed || effect != summary->argumentEffects[p];
+        summary->argumentEffects[p] = effect;
+    }
+    // follows from the fields above, their changes already decide the fixpoint
+    summary->purity = PURITY_PURE;
+    if (callsUnknown) {
+        summary->purity = PURITY_UNKNOWN;
+    } else {
+        for (uint32_t p = 0; p < summary->argumentCount; p++) {
+            if (summary->argumentEffects[p] & SUMMARY_WRITTEN) {
+                summary->purity = PURITY_WRITES_ARGUMENTS;
+            }
+        }
+    }
+    summary->passes++;
+    return changed;
+}
+
+static void summarizeComponent(SummaryContext *ctx, uint32_t component) {
+    CallGraphSCC *scc = ctx->scc;
+    uint32_t first = scc->memberOffsets[component];
+    uint32_t last = scc->memberOffsets[component + 1];
+    for (uint32_t m = first; m < last; m++) {
+        if (ctx->tasks[scc->members[m]].info != NULL) {
+            prepareSummary(ctx, scc->members[m]);
+        }
+    }
+    if (!scc->recursive[component]) {
+        if (ctx->tasks[scc->members[first]].info != NULL) {
+            evaluateSummary(ctx, scc->members[first]);
+        }
+        return;
+    }
+
+    // every call back into the component can repeat, inside a loop the nesting has no bound
+    bool unboundedDepth = false;
+    for (uint32_t m = first; m < last; m++) {
+        SummaryTask *task = &ctx->tasks[scc->members[m]];
+        for (uint32_t c = 0; c < task->callCount; c++) {
+            int32_t callee = task->calls[c].callee;
+            if (callee != CG_NO_NODE && scc->componentOf[callee] == component && task->calls[c].depth > 0) {
+                unboundedDepth = true;
+            }
+        }
+    }
+    for (uint32_t m = first; m < last; m++) {
+        ctx->tasks[scc->members[m]].unboundedDepth = unboundedDepth;
+    }
+    // members start from their own effects and grow until nothing changes
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (uint32_t m = first; m < last; m++) {
+            if (ctx->tasks[scc->members[m]].info != NULL) {
+                changed = evaluateSummary(ctx, scc->members[m]) || changed;
+            }
+        }
+    }
+}
+
+static void* runSummaryWorker(void *argument) {
+    SummaryContext *ctx = (SummaryContext *)argument;
+    pthread_mutex_lock(&ctx->lock);
+    while (true) {
+        while (ctx->head == ctx->tail && ctx->remaining > 0) {
+            pthread_cond_wait(&ctx->ready, &ctx->lock);
+        }
+        if (ctx->remaining == 0) {
+            break;
+        }
+        uint32_t component = ctx->queue[ctx->head++];
+        pthread_mutex_unlock(&ctx->lock);
+
+        summarizeComponent(ctx, component);
+
+        pthread_mutex_lock(&ctx->lock);
+        ctx->remaining--;
+        for (uint32_t e = ctx->scc->predOffsets[component]; e < ctx->scc->predOffsets[component + 1]; e++) {
+            uint32_t caller = ctx->scc->preds[e];
+            if (--ctx->pendingCallees[caller] == 0) {
+                ctx->queue[ctx->tail++] = caller;
+            }
+        }
+        pthread_cond_broadcast(&ctx->ready);
+    }
+    pthread_mutex_unlock(&ctx->lock);
+    return NULL;
+}
+
+static void freeSummaryTask(SummaryTask *task) {
+    for (uint32_t c = 0; c < task->callCount; c++) {
+        free(task->calls[c].arguments);
+    }
+    free(task->calls);
+    free(task->localEffects);
+    free(task->effects);
+    free(task->argumentVariables);
+    free(task->summaryVariables);
+    free(task->aliases);
+}
+
+void computeProgramSummaries(Program *program, uint32_t threadCount) {
+    // a CFG with errors may be incomplete
+    if (program->errors != NULL) {
+        return;
+    }
+    CallGraph *cg = createCallGraph();
+    for (FunctionInfo *func = program->functions; func != NULL; func = func->next) {
+        freeFunctionSummary(func->summary);
+        func->summary = NULL;
+        if (func->cfg != NULL) {
+            addFunctionToCallGraph(cg, func->functionName);
+        }
+    }
+    traverseProgramAndBuildCallGraph(program, cg, false);
+
+    SummaryContext ctx;
+    ctx.cg = cg;
+    ctx.scc = computeCallGraphSCC(cg);
+    uint32_t nodeCount = cg->functionCount;
+    uint32_t componentCount = ctx.scc->componentCount;
+    ctx.tasks = (SummaryTask *)calloc(nodeCount + 1, sizeof(SummaryTask));
+    for (FunctionInfo *func = program->functions; func != NULL; func = func->next) {
+        if (func->cfg != NULL) {
+            ctx.tasks[findFunction(cg, func->functionName)].info = func;
+        }
+    }
+
+    ctx.queue = (uint32_t *)malloc(sizeof(uint32_t) * (componentCount + 1));
+    ctx.pendingCallees = (uint32_t *)malloc(sizeof(uint32_t) * (componentCount + 1));
+    ctx.head = 0;
+    ctx.tail = 0;
+    ctx.remaining = componentCount;
+    for (uint32_t c = 0; c < componentCount; c++) {
+        ctx.pendingCallees[c] = ctx.scc->succOffsets[c + 1] - ctx.scc->succOffsets[c];
+        if (ctx.pendingCallees[c] == 0) {
+            ctx.queue[ctx.tail++] = c;
+        }
+    }
+    pthread_mutex_init(&ctx.lock, NULL);
+    pthread_cond_init(&ctx.ready, NULL);
+
+    if (threadCount == 0) {
+        long processors = sysconf(_SC_NPROCESSORS_ONLN);
+        threadCount = processors > 0 ? (uint32_t)processors : 1;
+    }
+    if (threadCount > componentCount) {
+        threadCount = componentCount > 0 ? componentCount : 1;
+    }
+    // the calling thread is one of the workers
+    pthread_t *threads = (pthread_t *)malloc(sizeof(pthread_t) * threadCount);
+    uint32_t startedCount = 0;
+    for (uint32_t t = 1; t < threadCount; t++) {
+        if (pthread_create(&threads[startedCount], NULL, runSummaryWorker, &ctx) == 0) {
+            startedCount++;
+        }
+    }
+    runSummaryWorker(&ctx);
+    for (uint32_t t = 0; t < startedCount; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    free(threads);
+
+    pthread_cond_destroy(&ctx.ready);
+    pthread_mutex_destroy(&ctx.lock);
+    for (uint32_t n = 0; n < nodeCount; n++) {
+        freeSummaryTask(&ctx.tasks[n]);
+    }
+    free(ctx.tasks);
+    free(ctx.queue);
+    free(ctx.pendingCallees);
+    freeCallGraphSCC(ctx.scc);
+    freeCallGraph(cg);
+}
+
+FunctionSummary* getFunctionSummary(Program *program, const char *functionName) {
+    for (FunctionInfo *func = program->functions; func != NULL; func = func->next) {
+        if (strcmp(func->functionName, functionName) == 0) {
+            return func->summary;
+        }
+    }
+    return NULL;
+}
+
+static uint8_t getVariableEffect(FunctionSummary *summary, const char *name) {
+    int32_t variable = findVariable(summary->variables, name);
+    return variable == -1 ? 0 : summary->effects[variable];
+}
+
+bool summaryReadsVariable(FunctionSummary *summary, const char *name) {
+    return (getVariableEffect(summary, name) & SUMMARY_READ) != 0;
+}
+
+bool summaryWritesVariable(FunctionSummary *summary, const char *name) {
+    return (getVariableEffect(summary, name) & SUMMARY_WRITTEN) != 0;
+}
+
+bool summaryReadsArgument(FunctionSummary *summary, uint32_t argument) {
+    return argument < summary->argumentCount && (summary->argumentEffects[argument] & SUMMARY_READ) != 0;
+}
+
+bool summaryWritesArgument(FunctionSummary *summary, uint32_t argument) {
+    return argument < summary->argumentCount && (summary->argumentEffects[argument] & SUMMARY_WRITTEN) != 0;
+}
+
+FunctionPurity getFunctionPurity(FunctionInfo *func) {
+    return func->summary != NULL ? func->summary->purity : PURITY_UNKNOWN;
+}
+
+FunctionPurity getCallPurity(Program *program, OperationTreeNode *call) {
+    if (call->childCount < 1 || call->children[0]->childCount != 0) {
+        return PURITY_UNKNOWN;
+    }
+    FunctionSummary *summary = getFunctionSummary(program, call->children[0]->label);
+    return summary != NULL ? summary->purity : PURITY_UNKNOWN;
+}
+
+const char* getPurityName(FunctionPurity purity) {
+    switch (purity) {
+        case PURITY_PURE:
+            return "pure";
+        case PURITY_WRITES_ARGUMENTS:
+            return "writes arguments";
+        case PURITY_UNKNOWN:
+            return "unknown";
+    }
+    return "unknown";
+}
+
+static void printVariablesWithEffect(FunctionSummary *summary, uint8_t effect) {
+    for (uint32_t v = 0; v < summary->variables->count; v++) {
+        if (summary->effects[v] & effect) {
+            printf(" %s", summary->variables->names[v]);
+        }
+    }
+    printf("\n");
+}
+
+void printFunctionSummary(FunctionInfo *func) {
+    FunctionSummary *summary = func->summary;
+    if (summary == NULL) {
+        return;
+    }
+    printf("Summary of function %s (component %u, passes: %u):\n", func->functionName, summary->component, summary->passes);
+    printf("  Reads:");
+    printVariablesWithEffect(summary, SUMMARY_READ);
+    printf("  Writes:");
+    printVariablesWithEffect(summary, SUMMARY_WRITTEN);
+    printf("  Arguments:");
+    uint32_t position = summary->argumentCount;
+    const char **names = (const char **)malloc(sizeof(char *) * (position + 1));
+    for (ArgumentInfo *arg = func->arguments; arg != NULL; arg = arg->next) {
+        names[--position] = arg->name;
+    }
+    for (uint32_t p = 0; p < summary->argumentCount; p++) {
+        uint8_t effect = summary->argumentEffects[p];
+        printf(" %s(%s)", names[p], effect == 0 ? "unused" :
+               effect == SUMMARY_READ ? "read" : effect == SUMMARY_WRITTEN ? "written" : "read, written");
+    }
+    printf("\n");
+    free(names);
+    printf("  Calls out: %s, unknown callees: %s\n", summary->callsOut ? "yes" : "no", summary->callsUnknown ? "yes" : "no");
+    if (summary->callDepth == SUMMARY_UNBOUNDED_DEPTH) {
+        printf("  Loop depth: %u, through calls: unbounded\n", summary->loopDepth);
+    } else {
+        printf("  Loop depth: %u, through calls: %u\n", summary->loopDepth, summary->callDepth);
+    }
+}
+
+void freeFunctionSummary(FunctionSummary *summary) {
+    if (summary == NULL) {
+        return;
+    }
+    freeVariableTable(summary->variables);
+    free(summary->effects);
+    free(summary->argumentEffects);
+    free(summary);
+}
+
+void printFunctionPurity(Program *program, FunctionInfo *func) {
+    if (func->summary == NULL) {
+        return;
+    }
+    printf("Purity of function %s: %s\n", func->functionName, getPurityName(func->summary->purity));
+    CallSiteList *calls = func->cfg->callSites;
+    if (calls->stale) {
+        collectCallSites(func->cfg);
+    }
+    for (uint32_t i = 0; i < calls->count; i++) {
+        FunctionSummary *callee = getFunctionSummary(program, calls->sites[i].callee);
+        FunctionPurity purity = callee != NULL ? callee->purity : PURITY_UNKNOWN;
+        printf("  Call of %s at %u:%u: %s\n", calls->sites[i].callee, calls->sites[i].line, calls->sites[i].pos, getPurityName(purity));
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "cfg/cfg.h"
+#include "cfg/dataflow/access.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SUMMARY_READ 1
+#define SUMMARY_WRITTEN 2
+#define SUMMARY_UNBOUNDED_DEPTH UINT32_MAX
+
+// Ordered from best to worst, a function is as pure as the worst effect it or its callees
+// have on the caller. Writes to arrays local to a callee chain stay inside it. A pure
+// function may still read arrays passed in, so reordering it needs those arrays unchanged.
+typedef enum FunctionPurity {
+    PURITY_PURE,               // reads arguments and locals only, writes nothing the caller sees
+    PURITY_WRITES_ARGUMENTS,   // writes elements of arrays passed in
+    PURITY_UNKNOWN,            // reaches a call of a function without a CFG
+} FunctionPurity;
+
+// What a function does to its variables and arguments, callees included. An argument
+// counts as written only if the caller can see it, i.e. elements of an array passed in
+// are written here or by a callee; assigning the parameter itself stays local.
+typedef struct FunctionSummary {
+    VariableTable *variables;  // locals and arguments the function accesses
+    uint8_t *effects;          // per variable, SUMMARY_READ | SUMMARY_WRITTEN
+    uint32_t argumentCount;
+    uint8_t *argumentEffects;  // per argument in declaration order
+    bool callsOut;             // calls some function
+    bool callsUnknown;         // reaches a call of a function without a CFG
+    uint32_t loopDepth;        // deepest loop of the function itself
+    uint32_t callDepth;        // deepest loop nesting through calls, unbounded for recursion inside a loop
+    uint32_t component;        // call graph SCC the summary was computed with
+    uint32_t passes;           // evaluations until the component reached its fixpoint
+    FunctionPurity purity;
+} FunctionSummary;
+
+// Summarizes every function with a CFG bottom-up over the SCCs of the call graph and
+// stores the result in FunctionInfo->summary. Components whose callees are done run in
+// parallel, 0 threads means one per online processor.
+void computeProgramSummaries(Program *program, uint32_t threadCount);
+
+FunctionSummary* getFunctionSummary(Program *program, const char *functionName);
+
+bool summaryReadsVariable(FunctionSummary *summary, const char *name);
+
+bool summaryWritesVariable(FunctionSummary *summary, const char *name);
+
+bool summaryReadsArgument(FunctionSummary *summary, uint32_t argument);
+
+bool summaryWritesArgument(FunctionSummary *summary, uint32_t argument);
+
+// PURITY_UNKNOWN for functions without a summary
+FunctionPurity getFunctionPurity(FunctionInfo *func);
+
+// purity of the callee of a call node, PURITY_UNKNOWN for callees without a summary or calls through expressions
+FunctionPurity getCallPurity(Program *program, OperationTreeNode *call);
+
+const char* getPurityName(FunctionPurity purity);
+
+void printFunctionSummary(FunctionInfo *func);
+
+// the function and each of its call sites
+void printFunctionPurity(Program *program, FunctionInfo *func);
+
+void freeFunctionSummary(FunctionSummary *summary);
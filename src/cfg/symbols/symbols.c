@@ -0,0 +1,429 @@
+#include "symbols.h"
+#include "cfg/hash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int32_t addScope(SymbolTable *table, int32_t parent) {
+    if (table->scopeCount >= table->scopeParentCapacity) {
+        table->scopeParentCapacity = table->scopeParentCapacity == 0 ? INITIAL_CAPACITY : table->scopeParentCapacity * 2;
+        table->scopeParents = (int32_t *)realloc(table->scopeParents, sizeof(int32_t) * table->scopeParentCapacity);
+        table->scopeDepths = (uint32_t *)realloc(table->scopeDepths, sizeof(uint32_t) * table->scopeParentCapacity);
+        table->scopeMarks = (uint32_t *)realloc(table->scopeMarks, sizeof(uint32_t) * table->scopeParentCapacity);
+    }
+    table->scopeParents[table->scopeCount] = parent;
+    table->scopeDepths[table->scopeCount] = parent == -1 ? 0 : table->scopeDepths[parent] + 1;
+    table->scopeMarks[table->scopeCount] = 0;
+    return table->scopeCount++;
+}
+
+SymbolTable* createSymbolTable() {
+    SymbolTable *table = (SymbolTable *)calloc(1, sizeof(SymbolTable));
+    table->names = createVariableTable();
+    table->scope = addScope(table, -1);
+    return table;
+}
+
+void openSymbolScope(SymbolTable *table) {
+    if (table->depth >= table->scopeCapacity) {
+        table->scopeCapacity = table->scopeCapacity == 0 ? INITIAL_CAPACITY : table->scopeCapacity * 2;
+        table->scopeStarts = (uint32_t *)realloc(table->scopeStarts, sizeof(uint32_t) * table->scopeCapacity);
+    }
+    table->scopeStarts[table->depth++] = table->declarationCount;
+    table->scope = addScope(table, table->scope);
+}
+
+void closeSymbolScope(SymbolTable *table) {
+    if (table->depth == 0) {
+        return;
+    }
+    uint32_t start = table->scopeStarts[--table->depth];
+    for (uint32_t d = table->declarationCount; d-- > start;) {
+        table->visible[table->declarations[d].name] = table->declarations[d].shadows;
+    }
+    table->scope = table->scopeParents[table->scope];
+}
+
+static uint32_t internName(SymbolTable *table, const char *name) {
+    uint32_t index = internVariable(table->names, name);
+    if (index >= table->visibleCapacity) {
+        uint32_t capacity = table->visibleCapacity == 0 ? INITIAL_CAPACITY : table->visibleCapacity;
+        while (capacity <= index) {
+            capacity *= 2;
+        }
+        table->visible = (int32_t *)realloc(table->visible, sizeof(int32_t) * capacity);
+        table->latest = (int32_t *)realloc(table->latest, sizeof(int32_t) * capacity);
+        for (uint32_t i = table->visibleCapacity; i < capacity; i++) {
+            table->visible[i] = SYMBOL_UNDECLARED;
+            table->latest[i] = SYMBOL_UNDECLARED;
+        }
+        table->visibleCapacity = capacity;
+    }
+    return index;
+}
+
+uint32_t declareSymbol(SymbolTable *table, const char *name, int block, uint32_t instruction, uint32_t line, uint32_t pos, bool isArgument) {
+    uint32_t nameIndex = internName(table, name);
+    if (table->declarationCount >= table->declarationCapacity) {
+        table->declarationCapacity = table->declarationCapacity == 0 ? INITIAL_CAPACITY : table->declarationCapacity * 2;
+        table->declarations = (SymbolDeclaration *)realloc(table->declarations, sizeof(SymbolDeclaration) * table->declarationCapacity);
+    }
+    uint32_t declaration = table->declarationCount++;
+    SymbolDeclaration *entry = &table->declarations[declaration];
+    entry->name = nameIndex;
+    entry->shadows = table->visible[nameIndex];
+    entry->previous = table->latest[nameIndex];
+    entry->block = block;
+    entry->instruction = instruction;
+    entry->depth = table->depth;
+    entry->scope = table->scope;
+    entry->line = line;
+    entry->pos = pos;
+    entry->isArgument = isArgument;
+    table->visible[nameIndex] = declaration;
+    table->latest[nameIndex] = declaration;
+    return declaration;
+}
+
+int32_t lookupSymbol(SymbolTable *table, const char *name) {
+    int32_t nameIndex = findVariable(table->names, name);
+    return nameIndex == -1 ? SYMBOL_UNDECLARED : table->visible[nameIndex];
+}
+
+// the name leaf gives the position and keeps the declaration, the node is what passes look occurrences up by
+static void addOccurrence(SymbolTable *table, OperationTreeNode *name, SymbolOccurrenceKind kind, OperationTreeNode *node, int block, uint32_t instruction) {
+    uint32_t nameIndex = internName(table, name->label);
+    if (table->occurrenceCount >= table->occurrenceCapacity) {
+        table->occurrenceCapacity = table->occurrenceCapacity == 0 ? INITIAL_CAPACITY : table->occurrenceCapacity * 2;
+        table->occurrences = (SymbolOccurrence *)realloc(table->occurrences, sizeof(SymbolOccurrence) * table->occurrenceCapacity);
+    }
+    SymbolOccurrence *occurrence = &table->occurrences[table->occurrenceCount++];
+    occurrence->declaration = table->visible[nameIndex];
+    occurrence->name = nameIndex;
+    occurrence->kind = kind;
+    occurrence->block = block;
+    occurrence->instruction = instruction;
+    occurrence->scope = table->scope;
+    occurrence->line = name->line;
+    occurrence->pos = name->pos;
+    occurrence->node = node;
+    name->symbol = occurrence->declaration;
+}
+
+// Follows the evaluation order of collectOperationTreeAccesses
+void resolveInstructionSymbols(SymbolTable *table, OperationTreeNode *node, int block, uint32_t instruction) {
+    if (node == NULL) {
+        return;
+    }
+
+    if (strcmp(node->label, READ) == 0) {
+        addOccurrence(table, node->children[0], SYMBOL_USE, node, block, instruction);
+    } else if (strcmp(node->label, LIT_READ) == 0 || strcmp(node->label, WITH_TYPE) == 0) {
+        return;
+    } else if (strcmp(node->label, WRITE) == 0) {
+        OperationTreeNode *target = node->children[0];
+        resolveInstructionSymbols(table, node->children[1], block, instruction);
+        if (target->childCount == 0) {
+            addOccurrence(table, target, SYMBOL_DEF, node, block, instruction);
+        } else if (strcmp(target->label, INDEX) == 0 && target->children[0]->childCount == 0) {
+            for (uint32_t i = 1; i < target->childCount; i++) {
+                resolveInstructionSymbols(table, target->children[i], block, instruction);
+            }
+            addOccurrence(table, target->children[0], SYMBOL_PARTIAL_DEF, node, block, instruction);
+        } else {
+            resolveInstructionSymbols(table, target, block, instruction);
+        }
+    } else if (strcmp(node->label, DECLARE) == 0) {
+        OperationTreeNode *name = node->children[1];
+        if (node->childCount == 3) {
+            resolveInstructionSymbols(table, node->children[2]->children[1], block, instruction);
+        }
+        name->symbol = declareSymbol(table, name->label, block, instruction, name->line, name->pos, false);
+        if (node->childCount == 3) {
+            addOccurrence(table, node->children[2]->children[0], SYMBOL_DEF, node->children[2], block, instruction);
+        }
+    } else if (strcmp(node->label, INDEX) == 0) {
+        if (node->children[0]->childCount == 0) {
+            addOccurrence(table, node->children[0], SYMBOL_USE, node, block, instruction);
+        } else {
+            resolveInstructionSymbols(table, node->children[0], block, instruction);
+        }
+        for (uint32_t i = 1; i < node->childCount; i++) {
+            resolveInstructionSymbols(table, node->children[i], block, instruction);
+        }
+    } else if (strcmp(node->label, OT_CALL) == 0 && node->childCount >= 1) {
+        if (node->children[0]->childCount != 0) {
+            resolveInstructionSymbols(table, node->children[0], block, instruction);
+        }
+        for (uint32_t i = 1; i < node->childCount; i++) {
+            resolveInstructionSymbols(table, node->children[i], block, instruction);
+        }
+        // arrays are passed by reference, so the callee may change any variable passed as is
+        for (uint32_t i = 1; i < node->childCount; i++) {
+            if (strcmp(node->children[i]->label, READ) == 0) {
+                addOccurrence(table, node->children[i]->children[0], SYMBOL_PARTIAL_DEF, node, block, instruction);
+            }
+        }
+    } else {
+        for (uint32_t i = 0; i < node->childCount; i++) {
+            resolveInstructionSymbols(table, node->children[i], block, instruction);
+        }
+    }
+}
+
+void moveSymbolOccurrences(SymbolTable *table, int fromBlock, int toBlock, uint32_t offset) {
+    for (uint32_t i = 0; i < table->occurrenceCount; i++) {
+        if (table->occurrences[i].block == fromBlock) {
+            table->occurrences[i].block = toBlock;
+            table->occurrences[i].instruction += offset;
+        }
+    }
+    for (uint32_t d = 0; d < table->declarationCount; d++) {
+        if (table->declarations[d].block == fromBlock) {
+            table->declarations[d].block = toBlock;
+            table->declarations[d].instruction += offset;
+        }
+    }
+}
+
+// counting sort of the occurrences of one kind group by declaration
+static void buildChains(SymbolTable *table, bool definitions, uint32_t **offsets, uint32_t **entries) {
+    uint32_t declarationCount = table->declarationCount;
+    *offsets = (uint32_t *)calloc(declarationCount + 1, sizeof(uint32_t));
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < table->occurrenceCount; i++) {
+        SymbolOccurrence *occurrence = &table->occurrences[i];
+        if (occurrence->declaration != SYMBOL_UNDECLARED && (occurrence->kind != SYMBOL_USE) == definitions) {
+            (*offsets)[occurrence->declaration + 1]++;
+            count++;
+        }
+    }
+    for (uint32_t d = 0; d < declarationCount; d++) {
+        (*offsets)[d + 1] += (*offsets)[d];
+    }
+    *entries = (uint32_t *)malloc(sizeof(uint32_t) * (count + 1));
+    uint32_t *next = (uint32_t *)malloc(sizeof(uint32_t) * (declarationCount + 1));
+    memcpy(next, *offsets, sizeof(uint32_t) * (declarationCount + 1));
+    for (uint32_t i = 0; i < table->occurrenceCount; i++) {
+        SymbolOccurrence *occurrence = &table->occurrences[i];
+        if (occurrence->declaration != SYMBOL_UNDECLARED && (occurrence->kind != SYMBOL_USE) == definitions) {
+            (*entries)[next[occurrence->declaration]++] = i;
+        }
+    }
+    free(next);
+}
+
+static void buildNodeIndex(SymbolTable *table) {
+    table->nodeSlotCount = INITIAL_CAPACITY * 4;
+    while (table->nodeSlotCount < table->occurrenceCount * 2) {
+        table->nodeSlotCount *= 2;
+    }
+    table->nodes = (OperationTreeNode **)calloc(table->nodeSlotCount, sizeof(OperationTreeNode *));
+    table->nodeOccurrences = (uint32_t *)malloc(sizeof(uint32_t) * table->nodeSlotCount);
+    for (uint32_t i = 0; i < table->occurrenceCount; i++) {
+        OperationTreeNode *node = table->occurrences[i].node;
+        uint32_t slot = hashPointer(node) & (table->nodeSlotCount - 1);
+        while (table->nodes[slot] != NULL && table->nodes[slot] != node) {
+            slot = (slot + 1) & (table->nodeSlotCount - 1);
+        }
+        if (table->nodes[slot] == NULL) {
+            table->nodes[slot] = node;
+            table->nodeOccurrences[slot] = i;
+        }
+    }
+}
+
+// marks the scope and the ones enclosing it, the scopes a name used there may resolve to
+static uint32_t markEnclosingScopes(SymbolTable *table, int32_t scope) {
+    uint32_t mark = ++table->scopeMark;
+    for (int32_t s = scope; s != -1; s = table->scopeParents[s]) {
+        table->scopeMarks[s] = mark;
+    }
+    return mark;
+}
+
+// First declaration of the name in a scope enclosing the occurrence, it comes later in the source
+// since it isn't visible yet. SYMBOL_UNDECLARED if there is none, elsewhere tells if other scopes declare it.
+static int32_t findLaterDeclaration(SymbolTable *table, SymbolOccurrence *occurrence, bool *elsewhere) {
+    *elsewhere = false;
+    int32_t first = SYMBOL_UNDECLARED;
+    uint32_t mark = markEnclosingScopes(table, occurrence->scope);
+    // the chain runs from the last declaration of the name back to the first
+    for (int32_t d = table->latest[occurrence->name]; d != SYMBOL_UNDECLARED; d = table->declarations[d].previous) {
+        if (table->scopeMarks[table->declarations[d].scope] == mark) {
+            first = d;
+        } else {
+            *elsewhere = true;
+        }
+    }
+    return first;
+}
+
+static void reportOutOfScopeUses(SymbolTable *table, Program *program, const char *fileName) {
+    for (uint32_t i = 0; i < table->occurrenceCount; i++) {
+        SymbolOccurrence *occurrence = &table->occurrences[i];
+        if (occurrence->declaration != SYMBOL_UNDECLARED) {
+            continue;
+        }
+        // a variable passed to a call is a use and a partial definition of the same leaf, the use reports it
+        if (occurrence->kind == SYMBOL_PARTIAL_DEF && strcmp(occurrence->node->label, OT_CALL) == 0) {
+            continue;
+        }
+        bool elsewhere;
+        int32_t later = findLaterDeclaration(table, occurrence, &elsewhere);
+        const char *name = table->names->names[occurrence->name];
+        char buffer[1024];
+        if (later != SYMBOL_UNDECLARED) {
+            SymbolDeclaration *declaration = &table->declarations[later];
+            snprintf(buffer, sizeof(buffer),
+                     "Use before declaration warning. Variable %s is used at %s:%d:%d before its declaration at %s:%d:%d",
+                     name, fileName, occurrence->line, occurrence->pos + 1, fileName, declaration->line, declaration->pos + 1);
+        } else if (elsewhere) {
+            // declarations of other scopes are not what the name refers to here, so none is cited
+            snprintf(buffer, sizeof(buffer),
+                     "Scope warning. Variable %s at %s:%d:%d is declared only in another scope",
+                     name, fileName, occurrence->line, occurrence->pos + 1);
+        } else {
+            snprintf(buffer, sizeof(buffer),
+                     "Undeclared variable warning. Variable %s at %s:%d:%d is not declared",
+                     name, fileName, occurrence->line, occurrence->pos + 1);
+        }
+        addProgramWarning(program, createProgramWarningInfo(buffer));
+    }
+}
+
+void finishSymbolTable(SymbolTable *table, Program *program, const char *fileName) {
+    while (table->depth > 0) {
+        closeSymbolScope(table);
+    }
+    buildChains(table, true, &table->defOffsets, &table->defs);
+    buildChains(table, false, &table->useOffsets, &table->uses);
+    table->chainedCount = table->declarationCount;
+    buildNodeIndex(table);
+    reportOutOfScopeUses(table, program, fileName);
+}
+
+int32_t findNodeOccurrence(SymbolTable *table, OperationTreeNode *node) {
+    if (table->nodes == NULL) {
+        return -1;
+    }
+    uint32_t slot = hashPointer(node) & (table->nodeSlotCount - 1);
+    while (table->nodes[slot] != NULL) {
+        if (table->nodes[slot] == node) {
+            return table->nodeOccurrences[slot];
+        }
+        slot = (slot + 1) & (table->nodeSlotCount - 1);
+    }
+    return -1;
+}
+
+bool isSymbolVisible(SymbolTable *table, const char *name, int32_t declaration, int32_t scope) {
+    if (scope < 0 || (uint32_t)scope >= table->scopeCount) {
+        return false;
+    }
+    int32_t nameIndex = findVariable(table->names, name);
+    if (nameIndex == -1) {
+        return declaration == SYMBOL_UNDECLARED;
+    }
+    // leaves of another function's table, e.g. an inlined one that wasn't appended
+    if (declaration != SYMBOL_UNDECLARED && ((uint32_t)declaration >= table->declarationCount ||
+        table->declarations[declaration].name != (uint32_t)nameIndex || table->declarations[declaration].scope < 0)) {
+        return false;
+    }
+    uint32_t mark = markEnclosingScopes(table, scope);
+    if (declaration != SYMBOL_UNDECLARED && table->scopeMarks[table->declarations[declaration].scope] != mark) {
+        return false;
+    }
+    // any other declaration of the name between the scope and the declaration's may hide it
+    for (int32_t d = table->latest[nameIndex]; d != SYMBOL_UNDECLARED; d = table->declarations[d].previous) {
+        SymbolDeclaration *other = &table->declarations[d];
+        if (d == declaration || other->scope < 0 || table->scopeMarks[other->scope] != mark) {
+            continue;
+        }
+        if (declaration == SYMBOL_UNDECLARED ||
+            table->scopeDepths[other->scope] >= table->scopeDepths[table->declarations[declaration].scope]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t appendSymbolTable(SymbolTable *table, SymbolTable *other, const char *prefix, int32_t parent, uint32_t *scopeBase) {
+    *scopeBase = table->scopeCount;
+    for (uint32_t s = 1; s < other->scopeCount; s++) {
+        int32_t otherParent = other->scopeParents[s];
+        addScope(table, otherParent <= 0 ? parent : otherParent - 1 + (int32_t)*scopeBase);
+    }
+    uint32_t offset = table->declarationCount;
+    char buffer[256];
+    for (uint32_t d = 0; d < other->declarationCount; d++) {
+        SymbolDeclaration *declaration = &other->declarations[d];
+        const char *name = other->names->names[declaration->name];
+        if (prefix != NULL) {
+            snprintf(buffer, sizeof(buffer), "%s.%s", prefix, name);
+            name = buffer;
+        }
+        uint32_t nameIndex = internName(table, name);
+        if (table->declarationCount >= table->declarationCapacity) {
+            table->declarationCapacity = table->declarationCapacity == 0 ? INITIAL_CAPACITY : table->declarationCapacity * 2;
+            table->declarations = (SymbolDeclaration *)realloc(table->declarations, sizeof(SymbolDeclaration) * table->declarationCapacity);
+        }
+        uint32_t appended = table->declarationCount++;
+        SymbolDeclaration *entry = &table->declarations[appended];
+        *entry = *declaration;
+        entry->name = nameIndex;
+        entry->shadows = declaration->shadows == SYMBOL_UNDECLARED ? SYMBOL_UNDECLARED : declaration->shadows + (int32_t)offset;
+        entry->previous = table->latest[nameIndex];
+        entry->scope = declaration->scope == 0 ? parent : declaration->scope - 1 + (int32_t)*scopeBase;
+        table->latest[nameIndex] = appended;
+    }
+    return offset;
+}
+
+static void printOccurrences(SymbolTable *table, uint32_t *offsets, uint32_t *entries, uint32_t declaration) {
+    for (uint32_t e = offsets[declaration]; e < offsets[declaration + 1]; e++) {
+        SymbolOccurrence *occurrence = &table->occurrences[entries[e]];
+        printf(" %u:%u", occurrence->line, occurrence->pos + 1);
+    }
+    printf("\n");
+}
+
+void printSymbolTable(SymbolTable *table) {
+    if (table->defOffsets == NULL) {
+        return;
+    }
+    for (uint32_t d = 0; d < table->chainedCount; d++) {
+        SymbolDeclaration *declaration = &table->declarations[d];
+        printf("  %s #%u at %u:%u, %s", table->names->names[declaration->name], d, declaration->line, declaration->pos + 1,
+               declaration->isArgument ? "argument" : "local");
+        if (declaration->shadows != SYMBOL_UNDECLARED) {
+            printf(", shadows #%d", declaration->shadows);
+        }
+        printf("\n    Defs:");
+        printOccurrences(table, table->defOffsets, table->defs, d);
+        printf("    Uses:");
+        printOccurrences(table, table->useOffsets, table->uses, d);
+    }
+}
+
+void freeSymbolTable(SymbolTable *table) {
+    if (table == NULL) {
+        return;
+    }
+    freeVariableTable(table->names);
+    free(table->visible);
+    free(table->latest);
+    free(table->scopeStarts);
+    free(table->scopeParents);
+    free(table->scopeDepths);
+    free(table->scopeMarks);
+    free(table->declarations);
+    free(table->occurrences);
+    free(table->defOffsets);
+    free(table->defs);
+    free(table->useOffsets);
+    free(table->uses);
+    free(table->nodes);
+    free(table->nodeOccurrences);
+    free(table);
+}
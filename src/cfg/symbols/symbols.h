@@ -0,0 +1,113 @@
+#pragma once
+
+#include "cfg/cfg.h"
+#include "cfg/dataflow/access.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SYMBOL_UNDECLARED -1
+
+typedef enum {
+    SYMBOL_USE,                // read of the variable or of one of its elements
+    SYMBOL_DEF,                // write to the whole variable, initializers included
+    SYMBOL_PARTIAL_DEF         // element write or array passed to a call
+} SymbolOccurrenceKind;
+
+typedef struct SymbolDeclaration {
+    uint32_t name;             // index in the name table
+    int32_t shadows;           // declaration of the same name it hides, SYMBOL_UNDECLARED if none
+    int32_t previous;          // earlier declaration of the same name in any scope, SYMBOL_UNDECLARED if none
+    int block;                 // id of the declaring block, -1 for arguments
+    uint32_t instruction;
+    uint32_t depth;            // scope nesting, 0 for arguments
+    int32_t scope;             // scope the declaration belongs to
+    uint32_t line;
+    uint32_t pos;
+    bool isArgument;
+} SymbolDeclaration;
+
+typedef struct SymbolOccurrence {
+    int32_t declaration;       // use-def link, SYMBOL_UNDECLARED if no declaration is in scope
+    uint32_t name;
+    SymbolOccurrenceKind kind;
+    int block;
+    uint32_t instruction;
+    int32_t scope;             // innermost scope open at the occurrence
+    uint32_t line;
+    uint32_t pos;
+    OperationTreeNode *node;   // read, write, index or call node, valid until a pass rewrites the trees
+} SymbolOccurrence;
+
+// Declarations and variable occurrences of one function, resolved while parseBlock descends
+// into nested blocks. Every name keeps its innermost visible declaration, so resolving an
+// occurrence is one hash lookup. A declaration becomes visible after its initializer.
+// Scopes form a tree rooted at the scope of the arguments, instructions keep the scope they
+// were written in so passes can check a declaration is still visible where they move a name.
+typedef struct SymbolTable {
+    VariableTable *names;
+    int32_t *visible;          // per name, innermost declaration in scope while the CFG is built
+    int32_t *latest;           // per name, its last declaration, the head of the previous links
+    uint32_t visibleCapacity;
+    uint32_t *scopeStarts;     // declaration count when each open scope began
+    uint32_t depth;
+    uint32_t scopeCapacity;
+    int32_t *scopeParents;     // per scope, the enclosing one, -1 for the root
+    uint32_t *scopeDepths;
+    uint32_t *scopeMarks;      // scratch marks of the scopes enclosing a queried one
+    uint32_t scopeMark;
+    uint32_t scopeCount;
+    uint32_t scopeParentCapacity;
+    int32_t scope;             // innermost open scope while the CFG is built
+    SymbolDeclaration *declarations;
+    uint32_t declarationCount;
+    uint32_t declarationCapacity;
+    SymbolOccurrence *occurrences; // in evaluation order within each instruction
+    uint32_t occurrenceCount;
+    uint32_t occurrenceCapacity;
+    uint32_t *defOffsets;      // def-use: definitions of declaration d are defs[defOffsets[d] .. defOffsets[d + 1])
+    uint32_t *defs;
+    uint32_t *useOffsets;      // uses, same layout
+    uint32_t *uses;
+    uint32_t chainedCount;     // declarations the def-use arrays cover, passes may append more
+    OperationTreeNode **nodes; // node -> occurrence, open addressing, built by finishSymbolTable
+    uint32_t *nodeOccurrences;
+    uint32_t nodeSlotCount;
+} SymbolTable;
+
+SymbolTable* createSymbolTable();
+
+void openSymbolScope(SymbolTable *table);
+
+// the declarations of the scope stop being visible, shadowed ones become visible again
+void closeSymbolScope(SymbolTable *table);
+
+uint32_t declareSymbol(SymbolTable *table, const char *name, int block, uint32_t instruction, uint32_t line, uint32_t pos, bool isArgument);
+
+// innermost visible declaration, SYMBOL_UNDECLARED if there is none
+int32_t lookupSymbol(SymbolTable *table, const char *name);
+
+// records the declarations and occurrences of the instruction in evaluation order and stores
+// the declaration every variable leaf resolves to in the leaf
+void resolveInstructionSymbols(SymbolTable *table, OperationTreeNode *root, int block, uint32_t instruction);
+
+// occurrences of a block merged into another one follow its instructions
+void moveSymbolOccurrences(SymbolTable *table, int fromBlock, int toBlock, uint32_t offset);
+
+// builds the def-use arrays and the node index, warns once per name leaf about variables used where no declaration is in scope
+void finishSymbolTable(SymbolTable *table, Program *program, const char *fileName);
+
+// occurrence of a read, write, index or call node, -1 if the node has none
+int32_t findNodeOccurrence(SymbolTable *table, OperationTreeNode *node);
+
+// true if the name resolves to the declaration in the scope, SYMBOL_UNDECLARED asks whether
+// no declaration of the name hides an outer one; an unknown scope (-1) sees nothing
+bool isSymbolVisible(SymbolTable *table, const char *name, int32_t declaration, int32_t scope);
+
+// Appends the scopes and declarations of another function, e.g. one inlined into this one.
+// Names get the prefix unless it's NULL, the other root scope is merged into parent and its
+// scope s > 0 becomes s - 1 + *scopeBase. Returns the offset added to its declaration ids.
+uint32_t appendSymbolTable(SymbolTable *table, SymbolTable *other, const char *prefix, int32_t parent, uint32_t *scopeBase);
+
+void printSymbolTable(SymbolTable *table);
+
+void freeSymbolTable(SymbolTable *table);
@@ -9,12 +9,53 @@
 #include "dotUtils/dotUtils.h"
 #include "cfg/cfg.h"
 #include "cfg/cg/cg.h"
+#include "cfg/cg/scc.h"
+#include "cfg/cg/reach.h"
+#include "cfg/dataflow/liveness.h"
+#include "cfg/dataflow/reachingDefs.h"
+#include "cfg/opt/fold.h"
+#include "cfg/opt/inline.h"
+#include "cfg/opt/specialize.h"
+#include "cfg/opt/jumpThreading.h"
+#include "cfg/opt/strength.h"
+#include "cfg/opt/sccp.h"
+#include "cfg/opt/copyProp.h"
+#include "cfg/opt/licm.h"
+#include "cfg/opt/dse.h"
+#include "cfg/opt/valueNumbering.h"
+#include "cfg/summary/summary.h"
+#include "cfg/symbols/symbols.h"
 
 struct arguments {
     char **input_files;
     char *output_dir;
     int debug;
     int ot;
+    int dom;
+    int postDom;
+    int dataflow;
+    int ssa;
+    int loops;
+    int inlining;
+    int specialize;
+    int fold;
+    int noStrength;
+    int sccp;
+    int jumps;
+    int copies;
+    int licm;
+    int dse;
+    int valueNumbering;
+    int rewrite;
+    int scc;
+    char *roots;
+    int summaries;
+    int threads;
+    int purity;
+    int reachIndex;
+    char *reaches;
+    char *loadReach;
+    int symbols;
     int input_file_count;
 };
 
@@ -22,6 +63,31 @@ static struct argp_option options[] = {
     { "debug",  'd', 0,       0, "Enable debug output" },
     { "output", 'o', "DIR",   0, "Output directory name" },
     { "operation tree", 't', 0,   0, "Draw operation tree in dot with CFG" },
+    { "dominators", 'D', 0,   0, "Draw dominator tree in dot with CFG" },
+    { "post-dominators", 'P', 0,   0, "Draw post-dominator tree in dot with CFG" },
+    { "inline", 'i', 0,   0, "Inline small non-recursive functions into their callers" },
+    { "specialize", 'z', 0,   0, "Copy functions for calls with constant arguments they branch on and print what was copied" },
+    { "fold", 'f', 0,   0, "Fold constant expressions before writing dot" },
+    { "no-strength-reduction", 'R', 0,   0, "Keep multiplications and divisions by constants when folding" },
+    { "sccp", 'p', 0,   0, "Propagate constants and prune branches that are never taken" },
+    { "jump-threading", 'j', 0,   0, "Fold branches decided by a dominating branch and bypass empty blocks" },
+    { "copies", 'c', 0,   0, "Propagate copies across basic blocks" },
+    { "licm", 'm', 0,   0, "Move loop invariant assignments into loop preheaders" },
+    { "dse", 'e', 0,   0, "Remove assignments to variables that are never read afterwards" },
+    { "value-numbering", 'v', 0,   0, "Print redundant expressions found by value numbering" },
+    { "rewrite", 'r', 0,   0, "Replace redundant expressions with reads of the variables holding them" },
+    { "loops", 'L', 0,   0, "Mark loop headers, nesting depth and exits in dot" },
+    { "ssa", 'S', 0,   0, "Annotate dot with SSA phi nodes and value versions" },
+    { "dataflow", 'l', 0,   0, "Print liveness and reaching definitions of every function" },
+    { "scc", 'C', 0,   0, "Draw recursive components of the call graph as clusters in cg.dot" },
+    { "roots", 'E', "NAMES",   0, "Build CFGs only for functions reachable from these comma separated entry points" },
+    { "summaries", 's', 0,   0, "Print what every function and its callees read, write and call" },
+    { "threads", 'T', "N",   0, "Threads used for summaries, one per processor by default" },
+    { "purity", 'U', 0,   0, "Print whether every function and call is pure and color calls by purity in dot" },
+    { "reach-index", 'X', 0,   0, "Save the transitive closure of the call graph to cg.reach" },
+    { "reaches", 'Q', "F,G",   0, "Print whether F calls G through any chain of calls and every function reaching G" },
+    { "load-reach", 'Y', "FILE",   0, "Answer --reaches from a saved cg.reach instead of the call graph" },
+    { "symbols", 'y', 0,   0, "Print the declarations of every function with their definitions and uses" },
     { 0 }
 };
 
@@ -35,6 +101,81 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state) {
         case 't':
             arguments->ot = 1;
             break;
+        case 'D':
+            arguments->dom = 1;
+            break;
+        case 'P':
+            arguments->postDom = 1;
+            break;
+        case 'i':
+            arguments->inlining = 1;
+            break;
+        case 'z':
+            arguments->specialize = 1;
+            break;
+        case 'f':
+            arguments->fold = 1;
+            break;
+        case 'R':
+            arguments->noStrength = 1;
+            break;
+        case 'p':
+            arguments->sccp = 1;
+            break;
+        case 'j':
+            arguments->jumps = 1;
+            break;
+        case 'c':
+            arguments->copies = 1;
+            break;
+        case 'm':
+            arguments->licm = 1;
+            break;
+        case 'e':
+            arguments->dse = 1;
+            break;
+        case 'v':
+            arguments->valueNumbering = 1;
+            break;
+        case 'r':
+            arguments->rewrite = 1;
+            break;
+        case 'L':
+            arguments->loops = 1;
+            break;
+        case 'S':
+            arguments->ssa = 1;
+            break;
+        case 'l':
+            arguments->dataflow = 1;
+            break;
+        case 'C':
+            arguments->scc = 1;
+            break;
+        case 'E':
+            arguments->roots = arg;
+            break;
+        case 's':
+            arguments->summaries = 1;
+            break;
+        case 'T':
+            arguments->threads = atoi(arg);
+            break;
+        case 'U':
+            arguments->purity = 1;
+            break;
+        case 'X':
+            arguments->reachIndex = 1;
+            break;
+        case 'Q':
+            arguments->reaches = arg;
+            break;
+        case 'y':
+            arguments->symbols = 1;
+            break;
+        case 'Y':
+            arguments->loadReach = arg;
+            break;
         case 'o':
             arguments->output_dir = arg;
             break;
@@ -147,12 +288,58 @@ char* getDirectory(const char* path) {
     }
 }
 
+// query is "caller,callee"
+void printReachQuery(ReachabilityIndex *index, const char *query) {
+    const char *comma = strchr(query, ',');
+    if (comma == NULL) {
+        fprintf(stderr, "Error: --reaches expects two function names separated by a comma\n");
+        return;
+    }
+    char *caller = strndup(query, comma - query);
+    const char *callee = comma + 1;
+    printf("%s %s %s\n", caller, canReach(index, caller, callee) ? "reaches" : "does not reach", callee);
+    uint32_t callerCount;
+    uint32_t *callers = getTransitiveCallers(index, callee, &callerCount);
+    printf("Functions reaching %s:", callee);
+    for (uint32_t i = 0; i < callerCount; i++) {
+        printf(" %s", index->names[callers[i]]);
+    }
+    printf("\n");
+    free(callers);
+    free(caller);
+}
+
 int main(int argc, char *argv[]) {
 
     struct arguments arguments;
 
     arguments.debug = 0;
     arguments.ot = 0;
+    arguments.dom = 0;
+    arguments.postDom = 0;
+    arguments.dataflow = 0;
+    arguments.ssa = 0;
+    arguments.loops = 0;
+    arguments.inlining = 0;
+    arguments.specialize = 0;
+    arguments.fold = 0;
+    arguments.noStrength = 0;
+    arguments.sccp = 0;
+    arguments.jumps = 0;
+    arguments.copies = 0;
+    arguments.licm = 0;
+    arguments.dse = 0;
+    arguments.valueNumbering = 0;
+    arguments.rewrite = 0;
+    arguments.scc = 0;
+    arguments.roots = NULL;
+    arguments.summaries = 0;
+    arguments.threads = 0;
+    arguments.purity = 0;
+    arguments.reachIndex = 0;
+    arguments.reaches = NULL;
+    arguments.loadReach = NULL;
+    arguments.symbols = 0;
     arguments.output_dir = NULL;
     arguments.input_files = NULL;
     arguments.input_file_count = 0;
@@ -183,7 +370,165 @@ int main(int argc, char *argv[]) {
         files.result[i] = result;
     }
 
-    Program* prog = buildProgram(&files, arguments.debug);
+    Program* prog;
+    char *rootNames = NULL;
+    const char **roots = NULL;
+    if (arguments.roots != NULL) {
+        rootNames = strdup(arguments.roots);
+        uint32_t rootCount = 0;
+        for (char *name = strtok(rootNames, ","); name != NULL; name = strtok(NULL, ",")) {
+            roots = realloc(roots, sizeof(char*) * (rootCount + 1));
+            roots[rootCount++] = name;
+        }
+        prog = buildProgramFromRoots(&files, roots, rootCount, arguments.debug);
+    } else {
+        prog = buildProgram(&files, arguments.debug);
+    }
+
+    if (arguments.symbols) {
+        FunctionInfo *func = prog->functions;
+        while (func != NULL) {
+            if (func->cfg != NULL) {
+                printf("Symbols of function %s:\n", func->functionName);
+                printSymbolTable(func->cfg->symbols);
+            }
+            func = func->next;
+        }
+    }
+
+    if (arguments.inlining) {
+        uint32_t inlinedCount = inlineProgramCalls(prog);
+        if (arguments.debug) {
+            printf("Inlined %u calls\n", inlinedCount);
+        }
+    }
+
+    if (arguments.specialize) {
+        SpecializationReport *report = specializeProgramCalls(prog);
+        printSpecializationReport(report);
+        freeSpecializationReport(report);
+    }
+
+    if (arguments.fold) {
+        uint32_t foldedCount = foldProgramConstants(prog);
+        if (arguments.debug) {
+            printf("Folded %u constant expressions\n", foldedCount);
+        }
+        if (!arguments.noStrength) {
+            uint32_t reducedCount = reduceProgramStrength(prog);
+            if (arguments.debug) {
+                printf("Reduced %u multiplications and divisions\n", reducedCount);
+            }
+        }
+    }
+
+    if (arguments.sccp) {
+        FunctionInfo *func = prog->functions;
+        while (func != NULL) {
+            if (func->cfg != NULL) {
+                SCCPResult *result = runSCCP(func->cfg);
+                if (result != NULL) {
+                    if (arguments.debug) {
+                        printf("Function %s:\n", func->functionName);
+                        printSCCP(result);
+                    }
+                    uint32_t removedEdgeCount;
+                    uint32_t removedBlockCount = pruneDeadBranches(func->cfg, result, &removedEdgeCount);
+                    if (arguments.debug) {
+                        printf("Pruned %u blocks and %u edges in %s\n", removedBlockCount, removedEdgeCount, func->functionName);
+                    }
+                    freeSCCPResult(result);
+                }
+            }
+            func = func->next;
+        }
+    }
+
+    if (arguments.jumps) {
+        FunctionInfo *func = prog->functions;
+        while (func != NULL) {
+            if (func->cfg != NULL) {
+                JumpThreadingStats stats;
+                threadJumps(func->cfg, &stats);
+                if (arguments.debug) {
+                    printJumpThreadingStats(func->functionName, &stats);
+                }
+            }
+            func = func->next;
+        }
+    }
+
+    if (arguments.copies) {
+        FunctionInfo *func = prog->functions;
+        while (func != NULL) {
+            uint32_t rewrittenCount = propagateCopies(func->cfg);
+            if (arguments.debug) {
+                printf("Propagated %u copies in %s\n", rewrittenCount, func->functionName);
+            }
+            func = func->next;
+        }
+    }
+
+    if (arguments.licm) {
+        FunctionInfo *func = prog->functions;
+        while (func != NULL) {
+            uint32_t preheaderCount;
+            uint32_t movedCount = hoistLoopInvariants(func->cfg, &preheaderCount);
+            if (arguments.debug) {
+                printf("Moved %u loop invariant instructions into %u preheaders in %s\n", movedCount, preheaderCount, func->functionName);
+            }
+            func = func->next;
+        }
+    }
+
+    if (arguments.dse) {
+        FunctionInfo *func = prog->functions;
+        while (func != NULL) {
+            if (func->cfg != NULL) {
+                DeadStoreStats stats;
+                eliminateDeadStores(func->cfg, &stats);
+                printDeadStoreStats(func->functionName, &stats);
+            }
+            func = func->next;
+        }
+    }
+
+    if (arguments.valueNumbering || arguments.rewrite) {
+        FunctionInfo *func = prog->functions;
+        while (func != NULL) {
+            if (func->cfg != NULL) {
+                ValueNumbering *numbering = numberValues(func->cfg, true);
+                if (numbering != NULL) {
+                    if (arguments.valueNumbering) {
+                        printf("Function %s:\n", func->functionName);
+                        printRedundancies(numbering);
+                    }
+                    if (arguments.rewrite) {
+                        uint32_t rewrittenCount = rewriteRedundancies(numbering);
+                        if (arguments.debug) {
+                            printf("Rewrote %u redundant expressions in %s\n", rewrittenCount, func->functionName);
+                        }
+                    }
+                    freeValueNumbering(numbering);
+                }
+            }
+            func = func->next;
+        }
+    }
+
+    if (arguments.summaries || arguments.purity) {
+        computeProgramSummaries(prog, arguments.threads > 0 ? (uint32_t)arguments.threads : 0);
+        FunctionInfo *func = prog->functions;
+        while (func != NULL) {
+            if (arguments.summaries) {
+                printFunctionSummary(func);
+            }
+            if (arguments.purity) {
+                printFunctionPurity(prog, func);
+            }
+            func = func->next;
+        }
+    }
 
     if (prog->errors != NULL) {
         printf("Errors:\n");
@@ -203,47 +548,109 @@ int main(int argc, char *argv[]) {
       }
     }
 
+    if (arguments.dataflow) {
+        FunctionInfo *func = prog->functions;
+        while (func != NULL) {
+            if (func->cfg != NULL) {
+                printf("Function %s:\n", func->functionName);
+                FunctionAccesses *accesses = collectFunctionAccesses(func->cfg);
+                DataflowResult *liveness = computeLiveness(accesses);
+                printLiveness(accesses, liveness);
+                ReachingDefinitions *definitions = computeReachingDefinitions(accesses);
+                printReachingDefinitions(definitions);
+                freeReachingDefinitions(definitions);
+                freeDataflowResult(liveness);
+                freeFunctionAccesses(accesses);
+            }
+            func = func->next;
+        }
+    }
+
+    CFGDotOptions dotOptions;
+    dotOptions.drawOt = arguments.ot;
+    dotOptions.drawDominators = arguments.dom;
+    dotOptions.drawPostDominators = arguments.postDom;
+    dotOptions.drawSsa = arguments.ssa;
+    dotOptions.drawLoops = arguments.loops;
+    dotOptions.drawPurity = arguments.purity && prog->errors == NULL;
+    dotOptions.program = prog;
+
     FunctionInfo *func = prog->functions;
     const char *mainFileName = NULL;
     while (func != NULL) {
       if (strcmp(func->functionName, "main") == 0) {
         mainFileName = func->fileName;
       }
-      char *outputFilePath = getOutputFileName(func->fileName, func->functionName, "dot", arguments.output_dir);
-      writeCFGToDotFile(func->cfg, outputFilePath, arguments.ot);
+      // functions not reached from the roots have no CFG to write
+      if (arguments.roots == NULL || func->cfg != NULL) {
+        char *outputFilePath = getOutputFileName(func->fileName, func->functionName, "dot", arguments.output_dir);
+        writeCFGToDotFile(func->cfg, outputFilePath, &dotOptions);
+        free(outputFilePath);
+      }
       func = func->next;
-      free(outputFilePath);
     }
 
     if (mainFileName == NULL) {
         fprintf(stderr, "Error: main function is not defined\n");
     }
 
+    ReachabilityIndex *reachIndex = NULL;
+    bool buildReach = arguments.reachIndex || (arguments.reaches != NULL && arguments.loadReach == NULL);
     if (prog->errors == NULL && (mainFileName != NULL || arguments.output_dir != NULL)) {
-        CallGraph *graph = (CallGraph *)malloc(sizeof(CallGraph));
-        graph->functions = NULL;
+        CallGraph *graph = createCallGraph();
 
         traverseProgramAndBuildCallGraph(prog, graph, arguments.debug);
-        char* dir;
-        char* path;
+        CallGraphSCC *scc = NULL;
+        if (arguments.scc || buildReach) {
+            scc = computeCallGraphSCC(graph);
+            if (arguments.debug) {
+                printCallGraphSCC(graph, scc);
+            }
+        }
+        if (buildReach) {
+            reachIndex = buildReachabilityIndex(graph, scc);
+        }
+        char* dir = NULL;
+        char* path = NULL;
+        char* reachPath = NULL;
         if (arguments.output_dir != NULL) {
-            dir = arguments.output_dir;
-            path = concat(dir, "/cg.dot");
-            writeCallGraphToDot(graph, path);
-            free(path);
+            path = concat(arguments.output_dir, "/cg.dot");
+            reachPath = concat(arguments.output_dir, "/cg.reach");
         } else if (mainFileName != NULL) {
             dir = getDirectory(mainFileName);
             path = concat(dir, "/cg.dot");
-            writeCallGraphToDot(graph, path);
-            free(path);
-            free(dir);
+            reachPath = concat(dir, "/cg.reach");
         } else {
             fprintf(stderr, "Error: can't save CG to dot file because main function and output directory are not defined\n");
         }
+        if (path != NULL && arguments.scc) {
+            writeCallGraphSCCToDot(graph, scc, path);
+        } else if (path != NULL) {
+            writeCallGraphToDot(graph, path);
+        }
+        if (reachPath != NULL && arguments.reachIndex) {
+            saveReachabilityIndex(reachIndex, reachPath);
+        }
+        free(path);
+        free(reachPath);
+        free(dir);
 
+        freeCallGraphSCC(scc);
         freeCallGraph(graph);
     }
 
+    if (arguments.loadReach != NULL) {
+        freeReachabilityIndex(reachIndex);
+        reachIndex = loadReachabilityIndex(arguments.loadReach);
+        if (reachIndex == NULL) {
+            fprintf(stderr, "Error: can't load reachability index %s\n", arguments.loadReach);
+        }
+    }
+    if (arguments.reaches != NULL && reachIndex != NULL) {
+        printReachQuery(reachIndex, arguments.reaches);
+    }
+    freeReachabilityIndex(reachIndex);
+
     freeProgram(prog);
 
     for (uint32_t i = 0; i < files.filesCount; i++) {
@@ -252,5 +659,7 @@ int main(int argc, char *argv[]) {
     }
     free(arguments.input_files);
     free(files.result);
+    free(roots);
+    free(rootNames);
     return 0;
 }